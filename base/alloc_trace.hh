@@ -0,0 +1,770 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/alloc_trace.hh`
+
+This file consists of policies <<alloc_trace_policy>>, class <<alloc_registry>>
+and class <<alloc_snapshot>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_ALLOC_TRACE_HH
+#define HACTAR_ALLOC_TRACE_HH
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[alloc_trace_policy]] `alloc_trace_policy`
+
+Type `alloc_trace_policy` is the allocation tracing policy of `const_ptr`, 
+`mutable_ptr` and `const_queue`, which is `alloc_trace_on` if macro 
+`HACTAR_ALLOC_TRACE` is defined, e.g. by `configure --enable-alloc-trace`, or 
+`alloc_trace_off` otherwise. The policy must be the same in all translation 
+units of a program.
+
+The smart pointers call `alloc_trace` for every object allocated and freed, 
+and for every reference retained and released. With `alloc_trace_on`, the 
+events are counted for the pointed type into counters of the calling thread 
+without locks. With `alloc_trace_off`, all calls are empty and no code is 
+generated for them.
+
+An object passed to `mutable_ptr` by pointer is counted as allocated there, so 
+it should be a new object. Bytes of an object are `sizeof` the type of the 
+pointer, and bytes of a `const_queue` include its reference count.
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct alloc_trace_off
+{
+static const bool enabled = false;
+};
+
+struct alloc_trace_on
+{
+static const bool enabled = true;
+};
+
+#ifdef HACTAR_ALLOC_TRACE
+typedef alloc_trace_on alloc_trace_policy;
+#else
+typedef alloc_trace_off alloc_trace_policy;
+#endif
+
+enum alloc_event
+{
+	alloc_allocate,
+	alloc_free,
+	alloc_retain,
+	alloc_release
+};
+
+struct alloc_counters
+{
+std::atomic<uint64_t> allocations;
+std::atomic<uint64_t> frees;
+std::atomic<uint64_t> bytes;
+std::atomic<uint64_t> freed_bytes;
+std::atomic<uint64_t> retains;
+std::atomic<uint64_t> releases;
+std::atomic<int64_t> live_bytes;
+std::atomic<int64_t> peak_bytes;
+};
+
+struct alloc_totals
+{
+uint64_t allocations;
+uint64_t frees;
+uint64_t bytes;
+uint64_t freed_bytes;
+uint64_t retains;
+uint64_t releases;
+int64_t live;
+int64_t live_bytes;
+int64_t peak_bytes;
+};
+
+class alloc_thread;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[alloc_registry]] class `alloc_registry`
+
+Class `alloc_registry` keeps the names of all traced types, and the counters 
+of every type in every thread. Counters of exited threads, and events after a 
+thread has released its counters, are merged into the registry. Method 
+`collect` adds up the counters of a type in all threads.
+
+Peak bytes are the most bytes of a type ever live in one thread, as counted by 
+that thread, and the largest of them is collected. An object freed by another 
+thread than the one allocating it lowers the live bytes of the freeing thread 
+only.
+
+There is one registry in a program, returned by `instance`, which is never 
+destroyed so that objects freed at exit are still counted.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class alloc_registry
+{
+pthread_mutex_t _mutex;
+char** _names;
+alloc_totals** _retired;
+unsigned int _size;
+alloc_thread* _threads;
+
+public:
+static alloc_registry&
+instance()
+{
+	alignas(alloc_registry) static char storage1[sizeof(alloc_registry)];
+	static alloc_registry* registry1 = new (storage1) alloc_registry();
+
+	return *registry1;
+}
+
+unsigned int type(const char* name1);
+
+const char*
+name(unsigned int type1)
+{
+	pthread_mutex_lock(&_mutex);
+	const char* name1 = type1 < _size ? _names[type1] : "";
+	pthread_mutex_unlock(&_mutex);
+
+	return name1;
+}
+
+unsigned int
+size()
+{
+	pthread_mutex_lock(&_mutex);
+	unsigned int size1 = _size;
+	pthread_mutex_unlock(&_mutex);
+
+	return size1;
+}
+
+bool collect(unsigned int type1, alloc_totals* totals1);
+
+void
+record(unsigned int type1, alloc_event event1, uint64_t bytes1)
+{
+	pthread_mutex_lock(&_mutex);
+	if (type1 < _size && _retired[type1]) {
+		alloc_totals* totals1 = _retired[type1];
+		switch (event1) {
+		case alloc_allocate:
+			totals1->allocations++;
+			totals1->bytes += bytes1;
+			totals1->live_bytes += bytes1;
+			if (totals1->live_bytes > totals1->peak_bytes) {
+				totals1->peak_bytes = totals1->live_bytes;
+			}
+
+			break;
+		case alloc_free:
+			totals1->frees++;
+			totals1->freed_bytes += bytes1;
+			totals1->live_bytes -= bytes1;
+			break;
+		case alloc_retain:
+			totals1->retains++;
+			break;
+		case alloc_release:
+			totals1->releases++;
+			break;
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+}
+
+private:
+friend class alloc_thread;
+
+alloc_registry()
+	: _names(NULL)
+	, _retired(NULL)
+	, _size(0)
+	, _threads(NULL)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+alloc_registry(const alloc_registry&);
+
+alloc_registry&
+operator=(const alloc_registry&);
+
+static void
+merge(alloc_totals* totals1, const alloc_counters* counters1)
+{
+	totals1->allocations += counters1->allocations.load(
+		std::memory_order_relaxed);
+	totals1->frees += counters1->frees.load(std::memory_order_relaxed);
+	totals1->bytes += counters1->bytes.load(std::memory_order_relaxed);
+	totals1->freed_bytes += counters1->freed_bytes.load(
+		std::memory_order_relaxed);
+	totals1->retains += counters1->retains.load(std::memory_order_relaxed);
+	totals1->releases += counters1->releases.load(std::memory_order_relaxed);
+	totals1->live_bytes += counters1->live_bytes.load(
+		std::memory_order_relaxed);
+	int64_t peak1 = counters1->peak_bytes.load(std::memory_order_relaxed);
+	totals1->peak_bytes = totals1->peak_bytes > peak1 ? totals1->peak_bytes :
+		peak1;
+}
+
+};
+
+inline thread_local alloc_thread* alloc_current;
+
+inline thread_local bool alloc_exited;
+
+class alloc_thread
+{
+alloc_counters** _types;
+unsigned int _size;
+alloc_thread* _next;
+
+public:
+alloc_thread()
+	: _types(NULL)
+	, _size(0)
+	, _next(NULL)
+{
+	alloc_registry& registry1 = alloc_registry::instance();
+	pthread_mutex_lock(&registry1._mutex);
+	_next = registry1._threads;
+	registry1._threads = this;
+	pthread_mutex_unlock(&registry1._mutex);
+}
+
+~alloc_thread()
+{
+	alloc_registry& registry1 = alloc_registry::instance();
+	pthread_mutex_lock(&registry1._mutex);
+	for (alloc_thread** thread1 = &registry1._threads; *thread1;
+		thread1 = &(*thread1)->_next) {
+		if (*thread1 == this) {
+			*thread1 = _next;
+			break;
+		}
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		if (_types[i] && registry1._retired[i]) {
+			alloc_registry::merge(registry1._retired[i], _types[i]);
+		}
+
+		free(_types[i]);
+	}
+
+	pthread_mutex_unlock(&registry1._mutex);
+	free(_types);
+	alloc_current = NULL;
+	alloc_exited = true;
+}
+
+static void
+record(unsigned int type1, alloc_event event1, uint64_t bytes1)
+{
+	alloc_counters* counters1 = counters(type1);
+	if (!counters1) {
+		alloc_registry::instance().record(type1, event1, bytes1);
+		return;
+	}
+
+	switch (event1) {
+	case alloc_allocate: {
+		add(counters1->allocations, 1);
+		add(counters1->bytes, bytes1);
+		int64_t live1 = counters1->live_bytes.load(std::memory_order_relaxed) +
+			bytes1;
+		counters1->live_bytes.store(live1, std::memory_order_relaxed);
+		if (live1 > counters1->peak_bytes.load(std::memory_order_relaxed)) {
+			counters1->peak_bytes.store(live1, std::memory_order_relaxed);
+		}
+
+		break;
+	}
+	case alloc_free:
+		add(counters1->frees, 1);
+		add(counters1->freed_bytes, bytes1);
+		counters1->live_bytes.store(counters1->live_bytes.load(
+			std::memory_order_relaxed) - bytes1, std::memory_order_relaxed);
+		break;
+	case alloc_retain:
+		add(counters1->retains, 1);
+		break;
+	case alloc_release:
+		add(counters1->releases, 1);
+		break;
+	}
+}
+
+private:
+friend class alloc_registry;
+
+alloc_thread(const alloc_thread&);
+
+alloc_thread&
+operator=(const alloc_thread&);
+
+static void
+add(std::atomic<uint64_t>& counter1, uint64_t value1)
+{
+	counter1.store(counter1.load(std::memory_order_relaxed) + value1,
+		std::memory_order_relaxed);
+}
+
+static alloc_counters*
+counters(unsigned int type1)
+{
+	alloc_thread* thread1 = alloc_current;
+	if (!thread1) {
+		if (alloc_exited) {
+			return NULL;
+		}
+
+		static thread_local alloc_thread thread2;
+		thread1 = &thread2;
+		alloc_current = thread1;
+	}
+
+	if (type1 < thread1->_size && thread1->_types[type1]) {
+		return thread1->_types[type1];
+	}
+
+	return thread1->add(type1);
+}
+
+alloc_counters*
+add(unsigned int type1)
+{
+	alloc_registry& registry1 = alloc_registry::instance();
+	alloc_counters* counters1 = NULL;
+	pthread_mutex_lock(&registry1._mutex);
+	if (type1 >= _size && type1 < registry1._size) {
+		alloc_counters** types1 = (alloc_counters**) realloc(_types,
+			registry1._size * sizeof(alloc_counters*));
+		if (types1) {
+			memset(types1 + _size, 0, (registry1._size - _size) *
+				sizeof(alloc_counters*));
+			_types = types1;
+			_size = registry1._size;
+		}
+	}
+
+	if (type1 < _size) {
+		_types[type1] = (alloc_counters*) calloc(1, sizeof(alloc_counters));
+		counters1 = _types[type1];
+	}
+
+	pthread_mutex_unlock(&registry1._mutex);
+
+	return counters1;
+}
+
+};
+
+inline unsigned int
+alloc_registry::type(const char* name1)
+{
+	pthread_mutex_lock(&_mutex);
+	unsigned int i = 0;
+	while (i < _size && strcmp(_names[i], name1) != 0) {
+		i++;
+	}
+
+	if (i == _size) {
+		char** names1 = (char**) realloc(_names, (_size + 1) * sizeof(char*));
+		if (names1) {
+			_names = names1;
+		}
+
+		alloc_totals** retired1 = (alloc_totals**) realloc(_retired,
+			(_size + 1) * sizeof(alloc_totals*));
+		if (retired1) {
+			_retired = retired1;
+		}
+
+		char* name2 = names1 && retired1 ? strdup(name1) : NULL;
+		if (name2) {
+			_names[_size] = name2;
+			_retired[_size] = (alloc_totals*) calloc(1, sizeof(alloc_totals));
+			_size++;
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	return i;
+}
+
+inline bool
+alloc_registry::collect(unsigned int type1, alloc_totals* totals1)
+{
+	memset(totals1, 0, sizeof(alloc_totals));
+	pthread_mutex_lock(&_mutex);
+	if (type1 >= _size) {
+		pthread_mutex_unlock(&_mutex);
+		return false;
+	}
+
+	if (_retired[type1]) {
+		*totals1 = *_retired[type1];
+	}
+
+	for (alloc_thread* thread1 = _threads; thread1; thread1 = thread1->_next) {
+		if (type1 < thread1->_size && thread1->_types[type1]) {
+			merge(totals1, thread1->_types[type1]);
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+	totals1->live = totals1->allocations - totals1->frees;
+
+	return true;
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[alloc_type]] class template `alloc_type`
+
+Class template `alloc_type` registers type `T` into the registry by its name 
+the first time `id` is called, and returns the same id for it afterwards. The 
+name is read from the signature of the function as written by the compiler, so 
+no RTTI is needed.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T>
+class alloc_type
+{
+public:
+static unsigned int
+id()
+{
+	static const unsigned int id1 = alloc_registry::instance().type(name());
+
+	return id1;
+}
+
+private:
+static const char*
+name()
+{
+	static char name1[256];
+	const char* signature = __PRETTY_FUNCTION__;
+	const char* begin = strstr(signature, "T = ");
+	if (!begin) {
+		return signature;
+	}
+
+	begin += 4;
+	unsigned int depth = 0;
+	unsigned int size1 = 0;
+	while (begin[size1] && size1 + 1 < sizeof(name1)) {
+		char c = begin[size1];
+		if (depth == 0 && (c == ']' || c == ';')) {
+			break;
+		}
+
+		depth += c == '<' || c == '(' || c == '[';
+		depth -= c == '>' || c == ')' || c == ']';
+		size1++;
+	}
+
+	memcpy(name1, begin, size1);
+	name1[size1] = '\0';
+
+	return name1;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[alloc_hook]] class template `alloc_hook`
+
+Class template `alloc_hook` is called by the smart pointers with the pointed 
+type, and `alloc_trace` is the hook of `alloc_trace_policy`.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class POLICY>
+class alloc_hook
+{
+public:
+template<class T>
+static void
+allocate(size_t)
+{
+}
+
+template<class T>
+static void
+deallocate(size_t)
+{
+}
+
+template<class T>
+static void
+retain()
+{
+}
+
+template<class T>
+static void
+release()
+{
+}
+
+};
+
+template<>
+class alloc_hook<alloc_trace_on>
+{
+public:
+template<class T>
+static void
+allocate(size_t bytes1)
+{
+	alloc_thread::record(alloc_type<T>::id(), alloc_allocate, bytes1);
+}
+
+template<class T>
+static void
+deallocate(size_t bytes1)
+{
+	alloc_thread::record(alloc_type<T>::id(), alloc_free, bytes1);
+}
+
+template<class T>
+static void
+retain()
+{
+	alloc_thread::record(alloc_type<T>::id(), alloc_retain, 0);
+}
+
+template<class T>
+static void
+release()
+{
+	alloc_thread::record(alloc_type<T>::id(), alloc_release, 0);
+}
+
+};
+
+typedef alloc_hook<alloc_trace_policy> alloc_trace;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[alloc_snapshot]] class `alloc_snapshot`
+
+Class `alloc_snapshot` collects the totals of all traced types when it is 
+constructed. Method `get` returns the totals of a type, and method `diff` 
+returns what happened to a type since an earlier snapshot, where `peak_bytes` 
+is still the peak of the later snapshot. Method `dump` writes the totals, or 
+the differences since `since1`, of all types as text, skipping types without 
+events.
+
+Class `alloc_scope` takes a snapshot when it is constructed, and its `get` and 
+`dump` tell what happened since then. With `alloc_trace_off`, all totals are 
+zero.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+alloc_scope scope;
+f(input);
+alloc_totals totals = scope.get<T>(); // objects of T allocated by f
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class alloc_snapshot
+{
+alloc_totals* _totals;
+unsigned int _size;
+
+public:
+alloc_snapshot()
+	: _totals(NULL)
+	, _size(0)
+{
+	alloc_registry& registry1 = alloc_registry::instance();
+	unsigned int size1 = registry1.size();
+	_totals = (alloc_totals*) malloc((size1 ? size1 : 1) *
+		sizeof(alloc_totals));
+	if (!_totals) {
+		return;
+	}
+
+	while (_size < size1 && registry1.collect(_size, _totals + _size)) {
+		_size++;
+	}
+}
+
+~alloc_snapshot()
+{
+	free(_totals);
+}
+
+bool
+valid() const
+{
+	return _totals;
+}
+
+unsigned int
+size() const
+{
+	return _size;
+}
+
+alloc_totals
+get(unsigned int type1) const
+{
+	alloc_totals totals1;
+	if (type1 < _size) {
+		totals1 = _totals[type1];
+	} else {
+		memset(&totals1, 0, sizeof(alloc_totals));
+	}
+
+	return totals1;
+}
+
+template<class T>
+alloc_totals
+get() const
+{
+	return get(alloc_type<T>::id());
+}
+
+alloc_totals
+diff(const alloc_snapshot& since1, unsigned int type1) const
+{
+	alloc_totals totals1 = get(type1);
+	alloc_totals totals2 = since1.get(type1);
+	totals1.allocations -= totals2.allocations;
+	totals1.frees -= totals2.frees;
+	totals1.bytes -= totals2.bytes;
+	totals1.freed_bytes -= totals2.freed_bytes;
+	totals1.retains -= totals2.retains;
+	totals1.releases -= totals2.releases;
+	totals1.live -= totals2.live;
+	totals1.live_bytes -= totals2.live_bytes;
+
+	return totals1;
+}
+
+template<class T>
+alloc_totals
+diff(const alloc_snapshot& since1) const
+{
+	return diff(since1, alloc_type<T>::id());
+}
+
+bool
+dump(FILE* out1, const alloc_snapshot* since1 = NULL) const
+{
+	alloc_registry& registry1 = alloc_registry::instance();
+	fprintf(out1, "type\tallocations\tfrees\tlive\tbytes\tlive_bytes\t"
+		"peak_bytes\tretains\treleases\n");
+	for (unsigned int i = 0; i < _size; i++) {
+		alloc_totals totals1 = since1 ? diff(*since1, i) : get(i);
+		if (!totals1.allocations && !totals1.frees && !totals1.retains &&
+			!totals1.releases) {
+			continue;
+		}
+
+		fprintf(out1, "%s\t%llu\t%llu\t%lld\t%llu\t%lld\t%lld\t%llu\t%llu\n",
+			registry1.name(i), (unsigned long long) totals1.allocations,
+			(unsigned long long) totals1.frees, (long long) totals1.live,
+			(unsigned long long) totals1.bytes,
+			(long long) totals1.live_bytes, (long long) totals1.peak_bytes,
+			(unsigned long long) totals1.retains,
+			(unsigned long long) totals1.releases);
+	}
+
+	return !ferror(out1);
+}
+
+private:
+alloc_snapshot(const alloc_snapshot&);
+
+alloc_snapshot&
+operator=(const alloc_snapshot&);
+
+};
+
+class alloc_scope
+{
+alloc_snapshot _begin;
+
+public:
+alloc_scope()
+{
+}
+
+alloc_totals
+get(unsigned int type1) const
+{
+	alloc_snapshot end1;
+
+	return end1.diff(_begin, type1);
+}
+
+template<class T>
+alloc_totals
+get() const
+{
+	return get(alloc_type<T>::id());
+}
+
+bool
+dump(FILE* out1) const
+{
+	alloc_snapshot end1;
+
+	return end1.dump(out1, &_begin);
+}
+
+private:
+alloc_scope(const alloc_scope&);
+
+alloc_scope&
+operator=(const alloc_scope&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -1,250 +1,1115 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/base_test.cc`
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#include "base_test.h"
-
-#include "hactar.hh"
-#include <iostream>
-
-namespace hactar {
-
-class calc
-{
-volatile size_t _rc;
-double _value;
-double _mvalue;
-
-public:
-calc()
-	: _rc(0)
-	, _value(0)
-	, _mvalue(0)
-{
-}
-
-~calc()
-{
-}
-
-bool
-retain()
-{
-	return ++_rc;
-}
-
-bool
-release()
-{
-	return --_rc;
-}
-
-double
-value() const
-{
-	return _value;
-}
-
-void
-set_value(const double& in1)
-{
-	_value = in1;
-}
-
-double
-mvalue() const
-{
-	return _mvalue;
-}
-
-void
-set_mvalue(const double& min1)
-{
-	_mvalue = min1;
-}
-
-private:
-calc(const calc&);
-
-calc& operator=(const calc&);
-
-};
-
-template<>
-const_ptr<calc>
-unit(const double& in1)
-{
-	mutable_ptr<calc> mutable_ptr1;
-	mutable_ptr1->set_value(in1);
-
-	return mutable_ptr1.build();
-}
-
-template<class TAG>
-const_ptr<calc>
-operator&(const const_ptr<calc>& const_ptr1, 
-	const action<double, double, TAG>& f1)
-{
-	if (const_ptr1.get() == NULL) {
-		return const_ptr1;
-	}
-
-	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
-
-	if (const_ptr2.get() == NULL) {
-		return const_ptr2;
-	}
-
-	mutable_ptr<calc> (const_ptr2)->set_mvalue(const_ptr1->mvalue());
-	std::cout << const_ptr2->value() << "\t" << const_ptr2->mvalue() <<
-		std::endl;
-
-	return const_ptr2;
-}
-
-template<class TAG>
-struct mplus_tag { };
-
-template<class TAG>
-class action<double, double, mplus_tag<TAG> >
-{
-action<double, double, TAG> _f;
-
-public:
-action(action<double, double, TAG> f1)
-	: _f(f1)
-{
-}
-
-double
-operator()(const double& in1) const
-{
-	return _f(in1);
-}
-
-};
-
-template<class TAG>
-action<double, double, mplus_tag<TAG> >
-mplus(action<double, double, TAG> f1)
-{
-	return action<double, double, mplus_tag<TAG> > (f1);
-}
-
-template<class TAG>
-const_ptr<calc>
-operator&(const const_ptr<calc>& const_ptr1,
-	const action<double, double, mplus_tag<TAG> >& f1)
-{
-	if (const_ptr1.get() == NULL) {
-		return const_ptr1;
-	}
-
-	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
-
-	if (const_ptr2.get() == NULL) {
-		return const_ptr2;
-	}
-
-	mutable_ptr<calc> (const_ptr2)->set_mvalue(const_ptr1->mvalue() +
-		const_ptr2->value());
-	std::cout << const_ptr2->value() << "\t" << const_ptr2->mvalue() <<
-		std::endl;
-
-	return const_ptr2;
-}
-
-struct mclean_tag { };
-
-template<>
-class action<double, double, mclean_tag>
-{
-public:
-action()
-{
-}
-
-double
-operator()(const double& in1) const
-{
-	return in1;
-}
-
-};
-
-action<double, double, mclean_tag>
-mclean()
-{
-	return action<double, double, mclean_tag> ();
-}
-
-template<>
-const_ptr<calc>
-operator&(const const_ptr<calc>& const_ptr1,
-	const action<double, double, mclean_tag>& f1)
-{
-	if (const_ptr1.get() == NULL) {
-		return const_ptr1;
-	}
-	
-	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
-	
-	if (const_ptr2.get() == NULL) {
-		return const_ptr2;
-	}
-	
-	std::cout << const_ptr2->value() << "\t" << const_ptr2->mvalue() <<
-		std::endl;
-
-	return const_ptr2;
-}
-
-double
-add(const double& x, double y)
-{
-	return x + y;
-}
-
-double
-multiply(const double& x, double y)
-{
-	return x * y;
-}
-
-}
-
-int
-hactar::base_test(int argc, const char* argv[])
-{
-	unit<calc> (3.14) &
-	(wrap(multiply, 2.0) | wrap(add, 2.0)) & (wrap(add, 10.0) * 4) &
-	(wrap(add, 2.5) & wrap(multiply, 1.1) & wrap(add, 2.2)) &
-	mplus(wrap(multiply, 2.4)) & mclean();
-	
-	return 0;
-}
-
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/base_test.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "base_test.h"
+
+#include "const_map.hh"
+#include "const_table.hh"
+#include "incremental.hh"
+#include "hactar.hh"
+#include "trace.hh"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <iostream>
+#include <type_traits>
+#include <vector>
+
+namespace hactar {
+
+class calc
+{
+volatile size_t _rc;
+double _value;
+double _mvalue;
+
+public:
+calc()
+	: _rc(0)
+	, _value(0)
+	, _mvalue(0)
+{
+}
+
+~calc()
+{
+}
+
+bool
+retain()
+{
+	return ++_rc;
+}
+
+bool
+release()
+{
+	return --_rc;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+void
+set_value(const double& in1)
+{
+	_value = in1;
+}
+
+double
+mvalue() const
+{
+	return _mvalue;
+}
+
+void
+set_mvalue(const double& min1)
+{
+	_mvalue = min1;
+}
+
+private:
+calc(const calc&);
+
+calc& operator=(const calc&);
+
+};
+
+template<>
+const_ptr<calc>
+unit(const double& in1)
+{
+	mutable_ptr<calc> mutable_ptr1;
+	mutable_ptr1->set_value(in1);
+
+	return mutable_ptr1.build();
+}
+
+static trace_sink* steps = NULL;
+static uint32_t step_events[3];
+
+void
+trace_step(unsigned int i, const const_ptr<calc>& const_ptr1)
+{
+	if (steps) {
+		steps->write(step_events[i], const_ptr1->value(), const_ptr1->mvalue());
+	}
+}
+
+template<class TAG>
+const_ptr<calc>
+operator&(const const_ptr<calc>& const_ptr1, 
+	const action<double, double, TAG>& f1)
+{
+	if (const_ptr1.get() == NULL) {
+		return const_ptr1;
+	}
+
+	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
+
+	if (const_ptr2.get() == NULL) {
+		return const_ptr2;
+	}
+
+	mutable_ptr<calc> (const_ptr2)->set_mvalue(const_ptr1->mvalue());
+	trace_step(0, const_ptr2);
+
+	return const_ptr2;
+}
+
+template<class TAG>
+struct mplus_tag { };
+
+template<class TAG>
+class action<double, double, mplus_tag<TAG> >
+{
+action<double, double, TAG> _f;
+
+public:
+action(action<double, double, TAG> f1)
+	: _f(f1)
+{
+}
+
+double
+operator()(const double& in1) const
+{
+	return _f(in1);
+}
+
+};
+
+template<class TAG>
+action<double, double, mplus_tag<TAG> >
+mplus(action<double, double, TAG> f1)
+{
+	return action<double, double, mplus_tag<TAG> > (f1);
+}
+
+template<class TAG>
+const_ptr<calc>
+operator&(const const_ptr<calc>& const_ptr1,
+	const action<double, double, mplus_tag<TAG> >& f1)
+{
+	if (const_ptr1.get() == NULL) {
+		return const_ptr1;
+	}
+
+	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
+
+	if (const_ptr2.get() == NULL) {
+		return const_ptr2;
+	}
+
+	mutable_ptr<calc> (const_ptr2)->set_mvalue(const_ptr1->mvalue() +
+		const_ptr2->value());
+	trace_step(1, const_ptr2);
+
+	return const_ptr2;
+}
+
+struct mclean_tag { };
+
+template<>
+class action<double, double, mclean_tag>
+{
+public:
+action()
+{
+}
+
+double
+operator()(const double& in1) const
+{
+	return in1;
+}
+
+};
+
+action<double, double, mclean_tag>
+mclean()
+{
+	return action<double, double, mclean_tag> ();
+}
+
+template<>
+const_ptr<calc>
+operator&(const const_ptr<calc>& const_ptr1,
+	const action<double, double, mclean_tag>& f1)
+{
+	if (const_ptr1.get() == NULL) {
+		return const_ptr1;
+	}
+	
+	const_ptr<calc> const_ptr2(unit<calc> (f1(const_ptr1->value())));
+	
+	if (const_ptr2.get() == NULL) {
+		return const_ptr2;
+	}
+	
+	trace_step(2, const_ptr2);
+
+	return const_ptr2;
+}
+
+constexpr double
+add(const double& x, double y)
+{
+	return x + y;
+}
+
+constexpr double
+multiply(const double& x, double y)
+{
+	return x * y;
+}
+
+double
+add_int(const double& x, int y)
+{
+	return x + y;
+}
+
+int
+wrap_test()
+{
+	double y = 1.1;
+	auto scale = [y](const double& x) { return x * y; };
+	auto twice = [](const double& x) { return x * 2.0; };
+
+	double out1 = (wrap(add, 2.5) & wrap(multiply, 1.1) &
+		wrap(multiply, 1.1) & wrap(multiply, 2.0))(3.14);
+	double out2 = (wrap<&add>(2.5) & wrap<double>(scale) &
+		wrap<double>(scale) & wrap<double>(twice))(3.14);
+	std::cout << out1 << "\t" << out2 << std::endl;
+
+	if (out1 != out2 || sizeof(wrap<double>(twice)) != 1) {
+		return 1;
+	}
+
+	return 0;
+}
+
+class table
+{
+std::vector<double> _values;
+
+public:
+static int copies;
+
+table(const size_t& size1)
+	: _values(size1)
+{
+	for (size_t i = 0; i < size1; i++) {
+		_values[i] = i * 0.5;
+	}
+}
+
+table(const table& table1)
+	: _values(table1._values)
+{
+	copies++;
+}
+
+table(table&&) = default;
+
+double
+at(const double& x) const
+{
+	return _values[(size_t) x % _values.size()];
+}
+
+};
+
+int table::copies = 0;
+
+double
+lookup(const double& x, const table& table1, const double& y)
+{
+	return table1.at(x) + y;
+}
+
+int
+wrapn_test()
+{
+	table table1(1024);
+	int copies = table::copies;
+
+	action<double, double, wrapn_action_tag<table, double> > f =
+		wrap(lookup, std::move(table1), 1.0);
+	action<double, double, wrapsn_action_tag<table, double> > g =
+		wrap_shared(lookup, table(1024), 2.0);
+
+	int built = table::copies;
+	double out = (g & g & g)(f(3.0));
+	std::cout << out << std::endl;
+
+	if (!g.valid() || out != 3.5 || built != copies ||
+		table::copies != built) {
+		return 1;
+	}
+
+	return 0;
+}
+
+void
+shift(std::vector<double>& values, double y)
+{
+	for (size_t i = 0; i < values.size(); i++) {
+		values[i] += y;
+	}
+}
+
+void
+scale(std::vector<double>& values, const double& y)
+{
+	for (size_t i = 0; i < values.size(); i++) {
+		values[i] *= y;
+	}
+}
+
+int
+inplace_test()
+{
+	std::vector<double> values(4, 1.0);
+	const double* data = values.data();
+	auto halve = [](std::vector<double>& values1) { scale(values1, 0.5); };
+
+	(wrap(shift, 1.0) & wrap(scale, 2.0) & wrap(scale, 2.0))(values);
+	std::vector<double> out = ((wrap<&shift>(1.0) &
+		wrap<std::vector<double>&>(halve)) * 3)(std::move(values));
+	std::cout << out[0] << std::endl;
+
+	if (out[0] != 1.875 || out.data() != data) {
+		return 1;
+	}
+
+	return 0;
+}
+
+constexpr double
+subtract(const double& x, const double& y)
+{
+	return x - y;
+}
+
+static int multiplies = 0;
+
+double
+count_multiply(const double& x, double y)
+{
+	multiplies++;
+
+	return x * y;
+}
+
+int
+fork_test()
+{
+	double out = (wrap(add, 1.0) &
+		fork(wrap(multiply, 2.0), wrap(add, 2.0)) &
+		zip(wrap(add, 1.0), wrap(multiply, 3.0)) & join(subtract))(3.14);
+	std::cout << out << std::endl;
+
+	double x = 3.14 + 1.0;
+	if (out != (x * 2.0 + 1.0) - ((x + 2.0) * 3.0)) {
+		return 1;
+	}
+
+	auto f = fork(wrap(count_multiply, 2.0) & wrap(add, 1.0) & wrap(add, 2.0),
+		wrap(count_multiply, 2.0) & wrap(add, 1.0) & wrap(add, 3.0));
+	auto g = fork(wrap(count_multiply, 2.0) & wrap(add, 1.0),
+		wrap(count_multiply, 2.0) & mclean());
+	auto h = fork(wrap(count_multiply, 2.0) & wrap(add, 1.0),
+		wrap(count_multiply, 3.0) & wrap(add, 1.0));
+	multiplies = 0;
+	duo<double, double> out1 = f(1.0);
+	duo<double, double> out2 = g(1.0);
+	duo<double, double> out3 = h(1.0);
+	std::cout << f.shared() << "\t" << g.shared() << "\t" << h.shared() <<
+		"\t" << multiplies << std::endl;
+	if (f.shared() != 2 || g.shared() != 1 || h.shared() != 0 ||
+		multiplies != 4 || out1.first != 5.0 || out1.second != 6.0 ||
+		out2.first != 3.0 || out2.second != 2.0 || out3.first != 3.0 ||
+		out3.second != 4.0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+constexpr bool
+below(const double& x, double y)
+{
+	return x < y;
+}
+
+int
+profile_test()
+{
+	auto f = profiled("profile_test", wrap(add, 1.0) &
+		profiled("profile_test.loop", wrap(multiply, 2.0) *
+			loop(3, wrap(below, 100.0))));
+	auto g = profiled("profile_test.offer", offer(wrap(add, 1.0),
+		wrap(below, 10.0), 1) | offer(wrap(add, 2.0), wrap(below, 100.0), 2));
+	double out = f(1.0) + f(1.0) + g(5.0) + g(50.0) + g(5.0);
+	std::cout << out << std::endl;
+	if (out != 2 * 16.0 + 6.0 + 52.0 + 6.0) {
+		return 1;
+	}
+
+	if constexpr (!profile_policy::enabled) {
+		return std::is_same<decltype(g), decltype(offer(wrap(add, 1.0),
+			wrap(below, 10.0), 1) | offer(wrap(add, 2.0), wrap(below, 100.0),
+			2))>::value ? 0 : 1;
+	}
+
+	profile_registry& registry1 = profile_registry::instance();
+	profile_totals totals1;
+	profile_totals totals2;
+	profile_totals totals3;
+	registry1.collect(registry1.stage("profile_test"), &totals1);
+	registry1.collect(registry1.stage("profile_test.loop"), &totals2);
+	registry1.collect(registry1.stage("profile_test.offer"), &totals3);
+	registry1.dump(stdout);
+	if (totals1.calls != 2 || totals1.step_calls[0] != 2 ||
+		totals1.step_calls[1] != 2 || totals1.iterations != 0 ||
+		totals2.calls != 2 || totals2.iterations != 6 ||
+		totals3.calls != 3 || totals3.branches[0] != 2 ||
+		totals3.branches[1] != 1) {
+		return 1;
+	}
+
+	auto h = profiled("profile_test.\"quoted\\", wrap(add, 1.0));
+	registry1.sample(2);
+	for (int i = 0; i < 4; i++) {
+		f(1.0);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		h(1.0);
+	}
+
+	for (int i = 0; i < 4; i++) {
+		g(50.0);
+	}
+
+	registry1.sample(0);
+	f(1.0);
+
+	FILE* timeline = tmpfile();
+	if (!timeline || !registry1.export_timeline(timeline)) {
+		return 1;
+	}
+
+	char line[256];
+	unsigned int stages = 0;
+	unsigned int iterations = 0;
+	unsigned int branches = 0;
+	unsigned int quoted = 0;
+	rewind(timeline);
+	while (fgets(line, sizeof(line), timeline)) {
+		stages += strstr(line, "\"name\": \"profile_test\"") != NULL;
+		iterations += strstr(line, "\"args\": {\"iteration\": 2}") != NULL;
+		branches += strstr(line, "\"args\": {\"branch\": 1}") != NULL;
+		quoted += strstr(line,
+			"\"name\": \"profile_test.\\\"quoted\\\\\"") != NULL;
+	}
+
+	fclose(timeline);
+	std::cout << stages << "\t" << iterations << "\t" << branches << "\t" <<
+		quoted << std::endl;
+	if (stages != 2 || iterations != 2 || branches != 2 || quoted != 2) {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+void*
+alloc_chain(void* out1)
+{
+	const_ptr<calc> const_ptr1 = unit<calc> (1.0) & wrap(add, 1.0) &
+		wrap(add, 2.0);
+	*(double*) out1 = const_ptr1->value();
+
+	return NULL;
+}
+
+int
+alloc_trace_test()
+{
+	alloc_scope scope1;
+	double out = 0;
+	alloc_chain(&out);
+	pthread_t thread1;
+	if (pthread_create(&thread1, NULL, alloc_chain, &out) != 0) {
+		return 1;
+	}
+
+	pthread_join(thread1, NULL);
+	{
+		const_queue<double> queue1(1.0);
+		const_queue<double> queue2(queue1, 2.0);
+		const_queue<double> queue3(queue2);
+		out += queue3[1];
+	}
+
+	alloc_totals totals1 = scope1.get<calc>();
+	alloc_totals totals2 = scope1.get<const_queue<double> >();
+	scope1.dump(stdout);
+	if (out != 6.0) {
+		return 1;
+	}
+
+	if constexpr (!alloc_trace_policy::enabled) {
+		return totals1.allocations || totals2.allocations ? 1 : 0;
+	}
+
+	if (totals1.allocations != 6 || totals1.frees != 6 || totals1.live != 0 ||
+		totals1.bytes != 6 * sizeof(calc) || totals1.live_bytes != 0 ||
+		totals1.peak_bytes < (int64_t) (2 * sizeof(calc)) ||
+		totals1.retains != totals1.releases || totals1.retains < 6 ||
+		totals2.allocations != 2 || totals2.frees != 2 ||
+		totals2.retains != 3 || totals2.releases != 3 ||
+		totals2.live_bytes != 0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+
+struct colliding_hash
+{
+size_t
+operator()(int key1) const
+{
+	return key1 % 7 * 0x0842108421084210ULL;
+}
+
+};
+
+template<class H>
+int
+const_map_test(unsigned int size1)
+{
+	std::vector<double> values(size1, -1.0);
+	std::vector<const_map<int, double, H> > versions(1);
+	std::vector<const_map<int, double, H> > snapshots;
+	std::vector<std::vector<double> > expected;
+	mutable_map<int, double, H> mutable_map1;
+	uint64_t random = 1;
+	for (unsigned int i = 0; i < 20 * size1; i++) {
+		random = random * 6364136223846793005ULL + 1442695040888963407ULL;
+		int key = (random >> 33) % size1;
+		if ((random >> 20) % 3 == 0) {
+			versions.push_back(versions.back().erase(key));
+			if (!mutable_map1.erase(key)) {
+				return 1;
+			}
+
+			values[key] = -1.0;
+		}
+		else {
+			versions.push_back(versions.back().set(key, i));
+			if (!mutable_map1.set(key, i)) {
+				return 1;
+			}
+
+			values[key] = i;
+		}
+
+		if (!versions.back().valid()) {
+			return 1;
+		}
+
+		if (i % size1 == 0) {
+			snapshots.push_back(mutable_map1.build());
+			snapshots.push_back(versions.back());
+			expected.push_back(values);
+			expected.push_back(values);
+		}
+	}
+
+	const_map<int, double, H> map1 = mutable_map1.build();
+	const_map<int, double, H> map2 = map1.set(size1, 1.0).erase(0);
+	snapshots.push_back(map1);
+	snapshots.push_back(versions.back());
+	expected.push_back(values);
+	expected.push_back(values);
+	for (unsigned int i = 0; i < snapshots.size(); i++) {
+		size_t size2 = 0;
+		for (unsigned int j = 0; j < size1; j++) {
+			const double* value = snapshots[i].find(j);
+			if (value ? *value != expected[i][j] : expected[i][j] != -1.0) {
+				return 1;
+			}
+
+			size2 += value != NULL;
+		}
+
+		double sum1 = 0;
+		double sum2 = 0;
+		snapshots[i].visit([&](const int& key, const double& value) {
+				sum1 += key * value;
+			});
+		for (unsigned int j = 0; j < size1; j++) {
+			sum2 += expected[i][j] != -1.0 ? j * expected[i][j] : 0.0;
+		}
+
+		if (size2 != snapshots[i].size() || sum1 != sum2) {
+			return 1;
+		}
+	}
+
+	if (!map2.valid() || map2.size() != map1.size() + 1 - (values[0] != -1.0) ||
+		map2.find(0) || !map2.find(size1) || map1.find(size1)) {
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+const_map_test()
+{
+	const_map<int, double> map1;
+	const_map<int, double> map2 = map1.set(1, 2.0);
+	if (map1.size() != 0 || map2.size() != 1 || *map2.find(1) != 2.0 ||
+		map2.erase(1).size() != 0 || map2.erase(2).size() != 1) {
+		return 1;
+	}
+
+	alloc_scope scope1;
+	mutable_map<int, double> mutable_map1(map2);
+	for (int i = 0; i < 1000; i++) {
+		mutable_map1.set(i, i * 2.0);
+	}
+
+	alloc_totals totals1 = scope1.get<const_map_node<int, double> >();
+	const_map<int, double> map3 = mutable_map1.build();
+	std::cout << map3.size() << "\t" << totals1.allocations << std::endl;
+	if (map3.size() != 1000 || *map3.find(999) != 1998.0 ||
+		*map2.find(1) != 2.0 || (alloc_trace_policy::enabled &&
+		totals1.allocations > 250)) {
+		return 1;
+	}
+
+	return const_map_test<std::hash<int> >(2000) |
+		const_map_test<colliding_hash>(200);
+}
+
+
+int
+const_table_test()
+{
+	const_queue<double> values = const_queue<double>::build(1000,
+		[](double* ptr) {
+			for (unsigned int i = 0; i < 1000; i++) {
+				new (ptr + i) double(i);
+			}
+		});
+	const_queue<double> mvalues = const_queue<double>::build(1000,
+		[](double* ptr) {
+			for (unsigned int i = 0; i < 1000; i++) {
+				new (ptr + i) double(-1.0 * i);
+			}
+		});
+	unsigned int rows[4] = { 5, 999, 5, 1000 };
+	const_table<double, double> table1(values, mvalues);
+	const_table<double, double> table2 = table1.bind<0>(wrap(add, 1.0));
+	const_table<double, double> table3 = table2.bind<1>(wrap(multiply, 2.0),
+		span<unsigned int>(rows, 4));
+	const_table<double, double> table4(values, const_queue<double>(1.0));
+	std::cout << table3.column<0>()[5] << "\t" << table3.column<1>()[5] <<
+		std::endl;
+	if (!table3.valid() || table3.size() != 1000 || table4.valid() ||
+		table2.column<1>().data() != mvalues.data() ||
+		table3.column<0>().data() != table2.column<0>().data() ||
+		table1.column<0>()[5] != 5.0 || table2.column<0>()[5] != 6.0 ||
+		table3.column<1>()[5] != -10.0 || table3.column<1>()[6] != -6.0 ||
+		table3.column<1>()[999] != -1998.0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+outcome<calc>
+operator&(const const_ptr<calc>& const_ptr1,
+	const action<bool, double, wrap1_action_tag<double> >& f1)
+{
+	if (!f1(const_ptr1->value())) {
+		return fail<calc>(42);
+	}
+
+	return const_ptr1;
+}
+
+double
+double_below(const double& x, int y)
+{
+	multiplies++;
+
+	return x * 2 < y ? x * 2 : -1.0;
+}
+
+outcome<calc>
+operator&(const const_ptr<calc>& const_ptr1,
+	const action<double, double, wrap1_action_tag<int> >& f1)
+{
+	double value1 = f1(const_ptr1->value());
+	if (value1 < 0) {
+		return fail<calc>(43);
+	}
+
+	return unit<calc> (value1);
+}
+
+int
+outcome_test()
+{
+	multiplies = 0;
+	outcome<calc> out1 = outcome<calc>(unit<calc> (1.0)) &
+		wrap(count_multiply, 2.0) & wrap(below, 10.0) &
+		wrap(count_multiply, 2.0) & wrap(below, 5.0) &
+		wrap(count_multiply, 2.0) & wrap(count_multiply, 2.0);
+	int multiplies1 = multiplies;
+	outcome<calc> out2 = outcome<calc>(unit<calc> (3.0)) &
+		wrap(count_multiply, 2.0) & wrap(below, 10.0) &
+		wrap(count_multiply, 2.0) & wrap(below, 5.0) &
+		wrap(count_multiply, 2.0) & wrap(count_multiply, 2.0);
+	int multiplies2 = multiplies - multiplies1;
+	outcome<calc> out3 = outcome<calc>(mutable_ptr<calc> (
+			(calc*) NULL).build()) & wrap(count_multiply, 2.0);
+	std::cout << out1.state()->value() << "\t" << out2.error() << "\t" <<
+		out2.stage() << std::endl;
+	if (out1.error() != outcome_ok || out1.stage() != 6 ||
+		out1.state()->value() != 16.0 || multiplies1 != 4 ||
+		out2.error() != 42 || out2.stage() != 3 || out2.state().get() ||
+		multiplies2 != 2 || out3.error() != outcome_empty ||
+		out3.stage() != 0 || multiplies != 6) {
+		return 1;
+	}
+
+	auto f = wrap(count_multiply, 2.0) & wrap(double_below, 100) &
+		wrap(double_below, 100) & wrap(double_below, 100) &
+		wrap(double_below, 100);
+	multiplies = 0;
+	outcome<calc> out4 = outcome<calc>(unit<calc> (1.0)) & f;
+	outcome<calc> out5 = outcome<calc>(unit<calc> (10.0)) & f;
+	outcome<calc> out6 = outcome<calc>(unit<calc> (1.0)) &
+		wrap(count_multiply, 2.0) & f;
+	outcome<calc> out7 = out2 & f;
+	std::cout << out4.state()->value() << "\t" << out5.error() << "\t" <<
+		out5.stage() << std::endl;
+	if (out4.error() != outcome_ok || out4.stage() != 5 ||
+		out4.state()->value() != 32.0 || out5.error() != 43 ||
+		out5.stage() != 3 || out5.state().get() || out6.stage() != 6 ||
+		out6.state()->value() != 64.0 || out7.error() != 42 ||
+		out7.stage() != 3 || multiplies != 15) {
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+constant_test()
+{
+	constexpr auto twice = [](const double& x) { return x * 2.0; };
+	constexpr auto f = constant(wrap(add, 1.0)) & wrap(multiply, 2.0) * 8;
+	constexpr auto g = constant(wrap<&add>(1.0)) & wrap<double>(twice) &
+		wrap(subtract, 0.5) & wrap(add, 10.0) * loop(10, wrap(below, 100.0));
+	static_assert(f(0.0) == 256.0, "constant action with loop");
+	static_assert(g(1.0) == 103.5, "constant action with filtered loop");
+
+	double x = 0.0;
+	double out1 = f(x);
+	double out2 = (wrap(add, 1.0) & wrap(multiply, 2.0) * 8)(x);
+	std::cout << out1 << "\t" << g(1.0) << std::endl;
+	if (out1 != out2 || g(2.0) != 105.5) {
+		return 1;
+	}
+
+	return 0;
+}
+
+typedef complex_action_tag<double, wrap1_action_tag<double>,
+	wrap1_action_tag<double> > chain_tag;
+typedef offer_action_tag<interned_action_tag<chain_tag>, null_action_tag,
+	interned_action_tag<wrap1_action_tag<double> > > branch_tag;
+typedef offer_action_tag<branch_tag, branch_tag,
+	interned_action_tag<wrap1_action_tag<double> > > branches_tag;
+
+action<double, double, branch_tag>
+interned_branch(intern_table* table1, unsigned int i)
+{
+	double y = i % 4;
+	return offer(intern(table1, wrap(add, y) & wrap(add, 1.0)),
+		intern(table1, wrap(below, 10.0 * (y + 1))), (int) (4 - y));
+}
+
+action<double, double, branches_tag>
+interned_branches(intern_table* table1, unsigned int begin1,
+	unsigned int size1)
+{
+	if (size1 == 2) {
+		return interned_branch(table1, begin1) |
+			interned_branch(table1, begin1 + 1);
+	}
+
+	return interned_branches(table1, begin1, size1 / 2) |
+		interned_branches(table1, begin1 + size1 / 2, size1 / 2);
+}
+
+class cells
+{
+std::atomic<size_t> _rc;
+double _values[4];
+
+public:
+cells()
+	: _rc(0)
+{
+	for (unsigned int i = 0; i < 4; i++) {
+		_values[i] = 0;
+	}
+}
+
+bool
+retain()
+{
+	_rc.fetch_add(1, std::memory_order_relaxed);
+
+	return true;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1, std::memory_order_acq_rel) != 1;
+}
+
+double
+get(unsigned int i) const
+{
+	incremental_read(i);
+
+	return _values[i];
+}
+
+void
+set(unsigned int i, double value1)
+{
+	incremental_write(i);
+	_values[i] = value1;
+}
+
+uint64_t
+diff(const cells& cells1) const
+{
+	uint64_t fields = 0;
+	for (unsigned int i = 0; i < 4; i++) {
+		fields |= (uint64_t) (_values[i] != cells1._values[i]) << i;
+	}
+
+	return fields;
+}
+
+void
+assign(const cells& cells1, uint64_t fields1)
+{
+	for (unsigned int i = 0; i < 4; i++) {
+		if (fields1 & (1ULL << i)) {
+			_values[i] = cells1._values[i];
+		}
+	}
+}
+
+private:
+cells(const cells&);
+
+cells& operator=(const cells&);
+
+};
+
+template<class TAG>
+struct cell_tag { };
+
+template<class TAG>
+class action<double, double, cell_tag<TAG> >
+{
+action<double, double, TAG> _f;
+unsigned int _from;
+unsigned int _to;
+
+public:
+action(unsigned int from1, unsigned int to1,
+	const action<double, double, TAG>& f1)
+	: _f(f1)
+	, _from(from1)
+	, _to(to1)
+{
+}
+
+unsigned int
+from() const
+{
+	return _from;
+}
+
+unsigned int
+to() const
+{
+	return _to;
+}
+
+double
+operator()(const double& in1) const
+{
+	return _f(in1);
+}
+
+};
+
+template<class TAG>
+action<double, double, cell_tag<TAG> >
+cell(unsigned int from1, unsigned int to1, const action<double, double, TAG>& f1)
+{
+	return action<double, double, cell_tag<TAG> > (from1, to1, f1);
+}
+
+template<class TAG>
+const_ptr<cells>
+operator&(const const_ptr<cells>& const_ptr1,
+	const action<double, double, cell_tag<TAG> >& f1)
+{
+	mutable_ptr<cells> mutable_ptr1;
+	mutable_ptr1->assign(*const_ptr1.get(), ~0ULL);
+	mutable_ptr1->set(f1.to(), f1(const_ptr1->get(f1.from())));
+
+	return mutable_ptr1.build();
+}
+
+const_ptr<cells>
+make_cells(double x0, double x1, double x2, double x3)
+{
+	mutable_ptr<cells> mutable_ptr1;
+	mutable_ptr1->set(0, x0);
+	mutable_ptr1->set(1, x1);
+	mutable_ptr1->set(2, x2);
+	mutable_ptr1->set(3, x3);
+
+	return mutable_ptr1.build();
+}
+
+int
+incremental_test()
+{
+	auto f = cell(0, 2, wrap(add, 1.0)) & cell(1, 3, wrap(multiply, 2.0)) &
+		cell(2, 2, wrap(multiply, 10.0)) & cell(3, 3, wrap(add, 0.5));
+	incremental_chain<cells, decltype(f)> chain1(f);
+	const_ptr<cells> out1 = chain1(make_cells(1.0, 2.0, 0.0, 0.0));
+	const_ptr<cells> out2 = chain1(make_cells(1.0, 3.0, 0.0, 0.0));
+	uint64_t evaluated = chain1.evaluated();
+	const_ptr<cells> out3 = chain1(make_cells(5.0, 3.0, 7.0, 7.0));
+	const_ptr<cells> out4 = chain1(make_cells(5.0, 3.0, 7.0, 7.0));
+	const_ptr<cells> out5 = make_cells(5.0, 3.0, 60.0, 6.5);
+	std::cout << out3->get(2) << "\t" << out3->get(3) << "\t" <<
+		chain1.evaluated() << "\t" << chain1.reused() << std::endl;
+	if (!chain1.valid() || out1->get(2) != 20.0 || out1->get(3) != 4.5 ||
+		out2->get(2) != 20.0 || out2->get(3) != 6.5 || evaluated != 6 ||
+		out3->diff(*out5.get()) != 0 || out4.get() != out3.get() ||
+		chain1.evaluated() != 8 || chain1.reused() != 8) {
+		return 1;
+	}
+
+	chain1.reset();
+	if (chain1(make_cells(1.0, 2.0, 0.0, 0.0))->diff(*out1.get()) != 0 ||
+		chain1.evaluated() != 12) {
+		return 1;
+	}
+
+	return 0;
+}
+
+int
+intern_test()
+{
+	intern_table table1;
+	action<double, double, branches_tag> f = interned_branches(&table1, 0, 64);
+	auto g = intern(&table1, wrap(add, 1.0));
+	auto h = intern(&table1, wrap(add, 1.0));
+	auto k = intern(&table1, wrap(multiply, 1.0));
+	std::cout << table1.size() << "\t" << table1.hits() << "\t" <<
+		table1.bytes() << "\t" << f(5.0) << "\t" << f(15.0) << std::endl;
+	if (!g.valid() || &g.get() != &h.get() || (void*) &g.get() ==
+		(void*) &k.get() || g(1.0) != 2.0 || table1.size() != 10 ||
+		table1.hits() != 121 || f(5.0) != 9.0 || f(15.0) != 19.0 ||
+		f(100.0) != 100.0) {
+		return 1;
+	}
+
+	typedef action<double, double, wrap1_action_tag<int> > padded;
+	alignas(padded) unsigned char bytes1[sizeof(padded)];
+	alignas(padded) unsigned char bytes2[sizeof(padded)];
+	memset(bytes1, 0x00, sizeof(bytes1));
+	memset(bytes2, 0xff, sizeof(bytes2));
+	const padded* x1 = new (bytes1) padded(wrap(add_int, 1));
+	const padded* x2 = new (bytes2) padded(wrap(add_int, 1));
+	intern_table table2;
+	auto m = intern(&table2, *x1);
+	auto n = intern(&table2, *x2);
+	if (!same_action(*x1, *x2) || same_action(*x1, wrap(add_int, 2)) ||
+		&m.get() != &n.get() || table2.size() != 1 || table2.hits() != 1) {
+		return 1;
+	}
+
+	return 0;
+}
+
+}
+
+int
+hactar::base_test(int argc, const char* argv[])
+{
+	int result = 0;
+
+	{
+		trace_sink sink1("base_test.trace");
+		steps = &sink1;
+		step_events[0] = sink1.event("bind");
+		step_events[1] = sink1.event("mplus");
+		step_events[2] = sink1.event("mclean");
+
+		unit<calc> (3.14) &
+		(wrap(multiply, 2.0) | wrap(add, 2.0)) & (wrap(add, 10.0) * 4) &
+		(wrap(add, 2.5) & wrap(multiply, 1.1) & wrap(add, 2.2)) &
+		mplus(wrap(multiply, 2.4)) & mclean();
+
+		steps = NULL;
+		if (!sink1.valid() || sink1.dropped() > 0) {
+			result = 1;
+		}
+	}
+
+	FILE* file = fopen("base_test.trace", "rb");
+	if (!file || trace_decode(file, stdout) != 0) {
+		result = 1;
+	}
+
+	if (file) {
+		fclose(file);
+	}
+
+	remove("base_test.trace");
+	fflush(stdout);
+
+	result |= wrap_test();
+	result |= wrapn_test();
+	result |= inplace_test();
+	result |= fork_test();
+	result |= profile_test();
+	result |= alloc_trace_test();
+	result |= const_map_test();
+	result |= const_table_test();
+	result |= intern_test();
+	result |= incremental_test();
+	result |= outcome_test();
+	result |= constant_test();
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
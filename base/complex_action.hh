@@ -1,118 +1,309 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or altertantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/complex_action.hh`
-
-This file consists of class template <<action with complex_action_tag>>.
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#ifndef HACTAR_COMPLEX_ACTION_HH
-#define HACTAR_COMPLEX_ACTION_HH
-
-#include "action.hh"
-#include "const_queue.hh"
-
-namespace hactar {
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[action with complex_action_tag]] action with complex_action_tag
-
-Complex actions are used for composition of actions. A complex action can be 
-constructed by two composable actions with `operator&`. A complex action can 
-also be constructed by another complex action and an extra action `OUT -> OUT` 
-to reduce templated class code bloat.
-
-Below is an example:
-
---------------------------------------------------------------------------------
-double add(const double& x, double y) { return x + y; }
-
-wrap(add, 10.0) & wrap(add, 5.0); // => composite action
---------------------------------------------------------------------------------
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class OUTIN, class TAG1, class TAG2>
-struct complex_action_tag { };
-
-template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
-class action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
-{
-action<OUTIN, IN, TAG1> _f;
-action<OUT, OUTIN, TAG2> _g;
-
-const_queue<action<OUT, OUT, TAG2> > _hlist;
-
-public:
-action(const action<OUTIN, IN, TAG1>& f1, const action<OUT, OUTIN, TAG2>& g1)
-	: _f(f1)
-	, _g(g1)
-{
-}
-
-action(const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& action1,
-	const action<OUT, OUT, TAG2>& h1)
-	: _f(action1._f)
-	, _g(action1._g)
-	, _hlist(action1._hlist, h1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	OUT out = _g(_f(in1));
-
-	for (int i = 0; i < _hlist.size(); i++) {
-		action<OUT, OUT, TAG2> hi = _hlist[i];
-		out = hi(out);
-	}
-
-	return out;
-}
-
-};
-
-template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
-action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
-operator&(const action<OUTIN, IN, TAG1>& f1, 
-	const action<OUT, OUTIN, TAG2>& g1)
-{
-	return action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> > (f1,
-		g1);
-}
-
-template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
-action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
-operator&(
-	const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& action1,
-	const action<OUT, OUT, TAG2>& h1)
-{
-	return action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> > (
-		action1, h1);
-}
-
-}
-
-#endif
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or altertantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/complex_action.hh`
+
+This file consists of class template <<action with complex_action_tag>> and 
+<<in-place action with complex_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_COMPLEX_ACTION_HH
+#define HACTAR_COMPLEX_ACTION_HH
+
+#include "action.hh"
+#include "const_queue.hh"
+#include "profile_action.hh"
+
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with complex_action_tag]] action with complex_action_tag
+
+Complex actions are used for composition of actions. A complex action can be 
+constructed by two composable actions with `operator&`. A complex action can 
+also be constructed by another complex action and an extra action `OUT -> OUT` 
+to reduce templated class code bloat.
+
+Methods `first`, `second` and `rest` return the composed actions in order, so 
+that they could be scheduled separately. Method `finish` evaluates the actions 
+after the first on a result of the first, and method `resume` evaluates the 
+actions of `rest` from the `i1`-th on. Evaluated directly by a profiled 
+action, a complex action records the time of every composed action as a step.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+wrap(add, 10.0) & wrap(add, 5.0); // => composite action
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUTIN, class TAG1, class TAG2>
+struct complex_action_tag { };
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+class action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
+{
+action<OUTIN, IN, TAG1> _f;
+action<OUT, OUTIN, TAG2> _g;
+
+const_queue<action<OUT, OUT, TAG2> > _hlist;
+
+public:
+action(const action<OUTIN, IN, TAG1>& f1, const action<OUT, OUTIN, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+action(const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& action1,
+	const action<OUT, OUT, TAG2>& h1)
+	: _f(action1._f)
+	, _g(action1._g)
+	, _hlist(action1._hlist, h1)
+{
+}
+
+const action<OUTIN, IN, TAG1>&
+first() const
+{
+	return _f;
+}
+
+const action<OUT, OUTIN, TAG2>&
+second() const
+{
+	return _g;
+}
+
+const const_queue<action<OUT, OUT, TAG2> >&
+rest() const
+{
+	return _hlist;
+}
+
+OUT
+finish(const OUTIN& outin1) const
+{
+	return resume(0, _g(outin1));
+}
+
+OUT
+resume(unsigned int i1, const OUT& out1) const
+{
+	OUT out = out1;
+	for (unsigned int i = i1; i < _hlist.size(); i++) {
+		out = _hlist[i](out);
+	}
+
+	return out;
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+	v1(_hlist);
+}
+
+OUT
+operator()(const IN& in1) const
+{
+	if constexpr (profile_policy::enabled) {
+		profile_frame<profile_policy> frame1("complex");
+		if (frame1.active()) {
+			return profile(frame1, in1);
+		}
+	}
+
+	OUT out = _g(_f(in1));
+
+	for (unsigned int i = 0; i < _hlist.size(); i++) {
+		out = _hlist[i](out);
+	}
+
+	return out;
+}
+
+private:
+OUT
+profile(const profile_frame<profile_policy>& frame1, const IN& in1) const
+{
+	uint64_t time = profile_now();
+	OUTIN outin = _f(in1);
+	time = frame1.step(0, time);
+	OUT out = _g(outin);
+	time = frame1.step(1, time);
+
+	for (unsigned int i = 0; i < _hlist.size(); i++) {
+		out = _hlist[i](out);
+		time = frame1.step(i + 2, time);
+	}
+
+	return out;
+}
+
+};
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
+operator&(const action<OUTIN, IN, TAG1>& f1, 
+	const action<OUT, OUTIN, TAG2>& g1)
+{
+	return action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> > (f1,
+		g1);
+}
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >
+operator&(
+	const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& action1,
+	const action<OUT, OUT, TAG2>& h1)
+{
+	return action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> > (
+		action1, h1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[in-place action with complex_action_tag]] in-place action with complex_action_tag
+
+In-place complex actions are used for composition of in-place actions 
+`action<void, IN&, TAG>`. All actions are applied one after another to the 
+same argument, so the argument is never copied. An rvalue argument is moved 
+into the complex action, mutated and returned.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+void scale(image& x, double y);
+
+(wrap(scale, 2.0) & wrap(scale, 0.5))(img); // => img is mutated in place
+image img2 = (wrap(scale, 2.0) & wrap(scale, 0.5))(load()); // => moved
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class IN, class TAG1, class TAG2>
+class action<void, IN&, complex_action_tag<void, TAG1, TAG2> >
+{
+action<void, IN&, TAG1> _f;
+action<void, IN&, TAG2> _g;
+
+const_queue<action<void, IN&, TAG2> > _hlist;
+
+public:
+action(const action<void, IN&, TAG1>& f1, const action<void, IN&, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+action(const action<void, IN&, complex_action_tag<void, TAG1, TAG2> >& action1,
+	const action<void, IN&, TAG2>& h1)
+	: _f(action1._f)
+	, _g(action1._g)
+	, _hlist(action1._hlist, h1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+	v1(_hlist);
+}
+
+void
+operator()(IN& in1) const
+{
+	if constexpr (profile_policy::enabled) {
+		profile_frame<profile_policy> frame1("complex");
+		if (frame1.active()) {
+			profile(frame1, in1);
+			return;
+		}
+	}
+
+	_f(in1);
+	_g(in1);
+
+	for (unsigned int i = 0; i < _hlist.size(); i++) {
+		_hlist[i](in1);
+	}
+}
+
+IN
+operator()(IN&& in1) const
+{
+	(*this)(in1);
+
+	return std::move(in1);
+}
+
+private:
+void
+profile(const profile_frame<profile_policy>& frame1, IN& in1) const
+{
+	uint64_t time = profile_now();
+	_f(in1);
+	time = frame1.step(0, time);
+	_g(in1);
+	time = frame1.step(1, time);
+
+	for (unsigned int i = 0; i < _hlist.size(); i++) {
+		_hlist[i](in1);
+		time = frame1.step(i + 2, time);
+	}
+}
+
+};
+
+template<class IN, class TAG1, class TAG2>
+action<void, IN&, complex_action_tag<void, TAG1, TAG2> >
+operator&(const action<void, IN&, TAG1>& f1, const action<void, IN&, TAG2>& g1)
+{
+	return action<void, IN&, complex_action_tag<void, TAG1, TAG2> > (f1, g1);
+}
+
+template<class IN, class TAG1, class TAG2>
+action<void, IN&, complex_action_tag<void, TAG1, TAG2> >
+operator&(
+	const action<void, IN&, complex_action_tag<void, TAG1, TAG2> >& action1,
+	const action<void, IN&, TAG2>& h1)
+{
+	return action<void, IN&, complex_action_tag<void, TAG1, TAG2> > (
+		action1, h1);
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
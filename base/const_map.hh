@@ -0,0 +1,854 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/const_map.hh`
+
+This file consists of class template <<const_map>> and class template 
+<<mutable_map>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CONST_MAP_HH
+#define HACTAR_CONST_MAP_HH
+
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <functional>
+#include <new>
+
+namespace hactar {
+
+template<class K, class V>
+struct const_map_entry
+{
+K key;
+V value;
+
+const_map_entry(const K& key1, const V& value1)
+	: key(key1)
+	, value(value1)
+{
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[const_map_node]] class template `const_map_node`
+
+Class template `const_map_node` is a node of a hash array mapped trie, with a 
+reference count for `const_ptr`. A node is allocated in one block of `bytes` 
+with its entries from the front and its children at the back, and `datamap` 
+and `nodemap` tell which of the 32 slots of the node hold an entry or a child. 
+Nodes below the last bits of hashes keep colliding entries in a list instead.
+
+Nodes allocated by transient maps have room between entries and children, so 
+that entries and children could be inserted and removed in place.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class K, class V>
+class const_map_node
+{
+std::atomic<unsigned int> _rc;
+
+public:
+typedef const_map_entry<K, V> entry;
+typedef const_ptr<const_map_node<K, V> > node_ptr;
+
+uint32_t datamap;
+uint32_t nodemap;
+unsigned int entries;
+unsigned int children;
+size_t bytes;
+
+static const_map_node*
+allocate(unsigned int entries1, unsigned int children1, size_t room1 = 0)
+{
+	size_t bytes1 = (entries_offset() + entries1 * sizeof(entry) + room1 +
+		alignof(node_ptr) - 1) / alignof(node_ptr) * alignof(node_ptr) +
+		children1 * sizeof(node_ptr);
+	void* ptr = malloc(bytes1);
+	if (!ptr) {
+		return NULL;
+	}
+
+	return new (ptr) const_map_node(entries1, children1, bytes1);
+}
+
+static void
+operator delete(void* ptr1)
+{
+	free(ptr1);
+}
+
+~const_map_node()
+{
+	for (unsigned int i = 0; i < entries; i++) {
+		entry_at(i).~entry();
+	}
+
+	for (unsigned int i = 0; i < children; i++) {
+		child_at(i).~node_ptr();
+	}
+}
+
+bool
+retain()
+{
+	_rc.fetch_add(1, std::memory_order_relaxed);
+
+	return true;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1, std::memory_order_acq_rel) != 1;
+}
+
+bool
+unique() const
+{
+	return _rc.load(std::memory_order_acquire) == 1;
+}
+
+size_t
+room() const
+{
+	return bytes - children * sizeof(node_ptr) - entries_offset() -
+		entries * sizeof(entry);
+}
+
+const entry&
+entry_at(unsigned int i) const
+{
+	return ((const entry*) ((const char*) this + entries_offset()))[i];
+}
+
+entry&
+entry_at(unsigned int i)
+{
+	return ((entry*) ((char*) this + entries_offset()))[i];
+}
+
+const node_ptr&
+child_at(unsigned int i) const
+{
+	return ((const node_ptr*) ((const char*) this + bytes))[(int) i -
+		(int) children];
+}
+
+node_ptr&
+child_at(unsigned int i)
+{
+	return ((node_ptr*) ((char*) this + bytes))[(int) i - (int) children];
+}
+
+void
+set_entry(unsigned int i, const K& key1, const V& value1)
+{
+	new (&entry_at(i)) entry(key1, value1);
+}
+
+void
+set_child(unsigned int i, const node_ptr& child1)
+{
+	new (&child_at(i)) node_ptr(child1);
+}
+
+void
+replace_entry(unsigned int i, const K& key1, const V& value1)
+{
+	entry_at(i).~entry();
+	set_entry(i, key1, value1);
+}
+
+void
+replace_child(unsigned int i, const node_ptr& child1)
+{
+	node_ptr child2(child1);
+	child_at(i).~node_ptr();
+	set_child(i, child2);
+}
+
+void
+insert_entry(unsigned int i, const K& key1, const V& value1)
+{
+	for (unsigned int j = entries; j > i; j--) {
+		new (&entry_at(j)) entry(entry_at(j - 1));
+		entry_at(j - 1).~entry();
+	}
+
+	set_entry(i, key1, value1);
+	entries++;
+}
+
+void
+erase_entry(unsigned int i)
+{
+	entry_at(i).~entry();
+	for (unsigned int j = i + 1; j < entries; j++) {
+		new (&entry_at(j - 1)) entry(entry_at(j));
+		entry_at(j).~entry();
+	}
+
+	entries--;
+}
+
+void
+insert_child(unsigned int i, const node_ptr& child1)
+{
+	node_ptr child2(child1);
+	children++;
+	for (unsigned int j = 0; j < i; j++) {
+		new (&child_at(j)) node_ptr(child_at(j + 1));
+		child_at(j + 1).~node_ptr();
+	}
+
+	set_child(i, child2);
+}
+
+void
+erase_child(unsigned int i)
+{
+	child_at(i).~node_ptr();
+	for (unsigned int j = i; j > 0; j--) {
+		new (&child_at(j)) node_ptr(child_at(j - 1));
+		child_at(j - 1).~node_ptr();
+	}
+
+	children--;
+}
+
+private:
+const_map_node(unsigned int entries1, unsigned int children1, size_t bytes1)
+	: _rc(0)
+	, datamap(0)
+	, nodemap(0)
+	, entries(entries1)
+	, children(children1)
+	, bytes(bytes1)
+{
+}
+
+static size_t
+entries_offset()
+{
+	return (sizeof(const_map_node) + alignof(entry) - 1) / alignof(entry) *
+		alignof(entry);
+}
+
+const_map_node(const const_map_node&);
+
+const_map_node&
+operator=(const const_map_node&);
+
+};
+
+template<class K, class V, class H>
+class mutable_map;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[const_map]] class template `const_map`
+
+Class template `const_map` is a persistent hash map from `K` to `V`, built as 
+a hash array mapped trie of `const_ptr` nodes. `K` must be comparable by `==` 
+and hashed by `H`, and `K` and `V` must be copy constructible value types, 
+which are not required to be assignable.
+
+Method `set` returns a new map with a key set to a value, and method `erase` 
+returns a new map without a key, both in O(log n) by copying only the nodes on 
+the path to the key, and sharing all other nodes with the map. Method `find` 
+returns a pointer to the value of a key, or NULL if the key is not in the 
+map, and method `visit` calls `f1(key, value)` for all entries. A map returned 
+by `set` or `erase` is invalid if memory could not be allocated.
+
+Class template `mutable_map` is a transient map for a batch of updates. It 
+updates nodes which are only reachable through itself in place, and copies 
+nodes shared with other maps once, so that a batch of `n` updates allocates 
+far less than `n` paths. Method `build` returns its content as a `const_map`, 
+which is shared with the transient until the transient updates it again.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+const_map<int, double> map1;
+const_map<int, double> map2 = map1.set(1, 2.0); // map1 is still empty
+
+mutable_map<int, double> mutable_map1(map2);
+for (int i = 0; i < 1000; i++) {
+	mutable_map1.set(i, i * 2.0);
+}
+
+const_map<int, double> map3 = mutable_map1.build(); // *map3.find(999) == 1998.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class K, class V, class H = std::hash<K> >
+class const_map
+{
+typedef const_map_node<K, V> node;
+typedef const_ptr<node> node_ptr;
+typedef const_map_entry<K, V> entry;
+
+node_ptr _root;
+size_t _size;
+bool _valid;
+
+public:
+const_map()
+	: _root(mutable_ptr<node>((node*) NULL).build())
+	, _size(0)
+	, _valid(true)
+{
+}
+
+const_map(const const_map<K, V, H>& map1)
+	: _root(map1._root)
+	, _size(map1._size)
+	, _valid(map1._valid)
+{
+}
+
+bool
+valid() const
+{
+	return _valid;
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+const V*
+find(const K& key1) const
+{
+	return find(_root, H()(key1), key1);
+}
+
+const_map<K, V, H>
+set(const K& key1, const V& value1) const
+{
+	bool added1 = false;
+	node_ptr root1 = set(_root, false, false, H()(key1), 0, key1, value1,
+		&added1);
+
+	return const_map<K, V, H>(root1, _size + added1, root1.get() != NULL);
+}
+
+const_map<K, V, H>
+erase(const K& key1) const
+{
+	if (!find(key1)) {
+		return *this;
+	}
+
+	if (_size == 1) {
+		return const_map<K, V, H>();
+	}
+
+	node_ptr root1 = erase(_root, false, false, H()(key1), 0, key1);
+
+	return const_map<K, V, H>(root1, _size - 1, root1.get() != NULL);
+}
+
+template<class F>
+void
+visit(const F& f1) const
+{
+	visit(_root.get(), f1);
+}
+
+private:
+friend class mutable_map<K, V, H>;
+
+const_map(const node_ptr& root1, size_t size1, bool valid1)
+	: _root(valid1 ? root1 : mutable_ptr<node>((node*) NULL).build())
+	, _size(valid1 ? size1 : 0)
+	, _valid(valid1)
+{
+}
+
+const_map<K, V, H>& operator=(const const_map<K, V, H>&);
+
+static unsigned int
+index(uint32_t map1, uint32_t bit1)
+{
+	return __builtin_popcount(map1 & (bit1 - 1));
+}
+
+static node_ptr
+make(node* node1)
+{
+	return mutable_ptr<node>(node1).build();
+}
+
+static const V*
+find(const node_ptr& root1, size_t hash1, const K& key1)
+{
+	const node* node1 = root1.get();
+	for (unsigned int shift1 = 0; node1; shift1 += 5) {
+		if (shift1 >= 64) {
+			for (unsigned int i = 0; i < node1->entries; i++) {
+				if (node1->entry_at(i).key == key1) {
+					return &node1->entry_at(i).value;
+				}
+			}
+
+			return NULL;
+		}
+
+		uint32_t bit1 = 1u << ((hash1 >> shift1) & 31);
+		if (node1->datamap & bit1) {
+			const entry& entry1 = node1->entry_at(index(node1->datamap, bit1));
+
+			return entry1.key == key1 ? &entry1.value : NULL;
+		}
+
+		if (!(node1->nodemap & bit1)) {
+			return NULL;
+		}
+
+		node1 = node1->child_at(index(node1->nodemap, bit1)).get();
+	}
+
+	return NULL;
+}
+
+static node*
+edit(const node_ptr& node_ptr1)
+{
+	return const_cast<node*>(node_ptr1.get());
+}
+
+static size_t
+room(bool transient1, unsigned int items1)
+{
+	if (!transient1 || items1 >= 32) {
+		return 0;
+	}
+
+	unsigned int room1 = items1 < 2 ? 2 : items1;
+	room1 = items1 + room1 > 32 ? 32 - items1 : room1;
+
+	return room1 * (sizeof(entry) > sizeof(node_ptr) ? sizeof(entry) :
+		sizeof(node_ptr));
+}
+
+static node_ptr
+rebuild(const node* node1, bool transient1, uint32_t datamap1,
+	uint32_t nodemap1, int erase_entry1, int insert_entry1, const K* key1,
+	const V* value1, int erase_child1, int insert_child1,
+	const node_ptr* child1)
+{
+	unsigned int entries1 = node1->entries - (erase_entry1 >= 0) +
+		(insert_entry1 >= 0);
+	unsigned int children1 = node1->children - (erase_child1 >= 0) +
+		(insert_child1 >= 0);
+	node* node2 = node::allocate(entries1, children1, room(transient1,
+		entries1 + children1));
+	if (!node2) {
+		return make(NULL);
+	}
+
+	node2->datamap = datamap1;
+	node2->nodemap = nodemap1;
+	for (unsigned int i = 0, j = 0; j < node2->entries; i++) {
+		if ((int) j == insert_entry1) {
+			node2->set_entry(j++, *key1, *value1);
+		}
+
+		if ((int) i != erase_entry1 && i < node1->entries) {
+			node2->set_entry(j++, node1->entry_at(i).key,
+				node1->entry_at(i).value);
+		}
+	}
+
+	for (unsigned int i = 0, j = 0; j < node2->children; i++) {
+		if ((int) j == insert_child1) {
+			node2->set_child(j++, *child1);
+		}
+
+		if ((int) i != erase_child1 && i < node1->children) {
+			node2->set_child(j++, node1->child_at(i));
+		}
+	}
+
+	return make(node2);
+}
+
+static node_ptr
+merge(bool transient1, const entry& entry1, size_t hash1, const K& key2,
+	const V& value2, size_t hash2, unsigned int shift1)
+{
+	if (shift1 >= 64) {
+		node* node1 = node::allocate(2, 0, room(transient1, 2));
+		if (node1) {
+			node1->set_entry(0, entry1.key, entry1.value);
+			node1->set_entry(1, key2, value2);
+		}
+
+		return make(node1);
+	}
+
+	uint32_t bit1 = 1u << ((hash1 >> shift1) & 31);
+	uint32_t bit2 = 1u << ((hash2 >> shift1) & 31);
+	if (bit1 == bit2) {
+		node_ptr child1 = merge(transient1, entry1, hash1, key2, value2, hash2,
+			shift1 + 5);
+		node* node1 = child1.get() ? node::allocate(0, 1, room(transient1,
+			1)) : NULL;
+		if (node1) {
+			node1->nodemap = bit1;
+			node1->set_child(0, child1);
+		}
+
+		return make(node1);
+	}
+
+	node* node1 = node::allocate(2, 0, room(transient1, 2));
+	if (node1) {
+		node1->datamap = bit1 | bit2;
+		node1->set_entry(bit1 < bit2 ? 0 : 1, entry1.key, entry1.value);
+		node1->set_entry(bit1 < bit2 ? 1 : 0, key2, value2);
+	}
+
+	return make(node1);
+}
+
+static node_ptr
+set(const node_ptr& node_ptr1, bool transient1, bool unique1, size_t hash1,
+	unsigned int shift1, const K& key1, const V& value1, bool* added1)
+{
+	const node* node1 = node_ptr1.get();
+	if (!node1) {
+		*added1 = true;
+		node* node2 = node::allocate(1, 0, room(transient1, 1));
+		if (node2) {
+			node2->datamap = 1u << (hash1 & 31);
+			node2->set_entry(0, key1, value1);
+		}
+
+		return make(node2);
+	}
+
+	unique1 = unique1 && node1->unique();
+	if (shift1 >= 64) {
+		for (unsigned int i = 0; i < node1->entries; i++) {
+			if (node1->entry_at(i).key == key1) {
+				if (unique1) {
+					edit(node_ptr1)->replace_entry(i, key1, value1);
+					return node_ptr1;
+				}
+
+				return rebuild(node1, transient1, 0, 0, i, i, &key1, &value1,
+					-1, -1, NULL);
+			}
+		}
+
+		*added1 = true;
+		if (unique1 && node1->room() >= sizeof(entry)) {
+			edit(node_ptr1)->insert_entry(node1->entries, key1, value1);
+			return node_ptr1;
+		}
+
+		return rebuild(node1, transient1, 0, 0, -1, node1->entries, &key1,
+			&value1, -1, -1, NULL);
+	}
+
+	uint32_t bit1 = 1u << ((hash1 >> shift1) & 31);
+	if (node1->datamap & bit1) {
+		unsigned int i = index(node1->datamap, bit1);
+		const entry& entry2 = node1->entry_at(i);
+		if (entry2.key == key1) {
+			if (unique1) {
+				edit(node_ptr1)->replace_entry(i, key1, value1);
+				return node_ptr1;
+			}
+
+			return rebuild(node1, transient1, node1->datamap, node1->nodemap,
+				i, i, &key1, &value1, -1, -1, NULL);
+		}
+
+		*added1 = true;
+		node_ptr child1 = merge(transient1, entry2, H()(entry2.key), key1,
+			value1, hash1, shift1 + 5);
+		if (!child1.get()) {
+			return child1;
+		}
+
+		unsigned int j = index(node1->nodemap | bit1, bit1);
+		if (unique1 && node1->room() + sizeof(entry) >= sizeof(node_ptr)) {
+			node* node2 = edit(node_ptr1);
+			node2->erase_entry(i);
+			node2->insert_child(j, child1);
+			node2->datamap &= ~bit1;
+			node2->nodemap |= bit1;
+			return node_ptr1;
+		}
+
+		return rebuild(node1, transient1, node1->datamap & ~bit1,
+			node1->nodemap | bit1, i, -1, NULL, NULL, -1, j, &child1);
+	}
+
+	if (node1->nodemap & bit1) {
+		unsigned int i = index(node1->nodemap, bit1);
+		const node_ptr& child1 = node1->child_at(i);
+		node_ptr child2 = set(child1, transient1, unique1, hash1, shift1 + 5,
+			key1, value1, added1);
+		if (!child2.get() || child2 == child1) {
+			return child2.get() ? node_ptr1 : child2;
+		}
+
+		if (unique1) {
+			edit(node_ptr1)->replace_child(i, child2);
+			return node_ptr1;
+		}
+
+		return rebuild(node1, transient1, node1->datamap, node1->nodemap, -1,
+			-1, NULL, NULL, i, i, &child2);
+	}
+
+	*added1 = true;
+	unsigned int j = index(node1->datamap | bit1, bit1);
+	if (unique1 && node1->room() >= sizeof(entry)) {
+		node* node2 = edit(node_ptr1);
+		node2->insert_entry(j, key1, value1);
+		node2->datamap |= bit1;
+		return node_ptr1;
+	}
+
+	return rebuild(node1, transient1, node1->datamap | bit1, node1->nodemap,
+		-1, j, &key1, &value1, -1, -1, NULL);
+}
+
+static node_ptr
+erase(const node_ptr& node_ptr1, bool transient1, bool unique1,
+	size_t hash1, unsigned int shift1, const K& key1)
+{
+	const node* node1 = node_ptr1.get();
+	unique1 = unique1 && node1->unique();
+	if (shift1 >= 64) {
+		for (unsigned int i = 0; i < node1->entries; i++) {
+			if (!(node1->entry_at(i).key == key1)) {
+				continue;
+			}
+
+			if (unique1) {
+				edit(node_ptr1)->erase_entry(i);
+				return node_ptr1;
+			}
+
+			return rebuild(node1, transient1, 0, 0, i, -1, NULL, NULL, -1, -1,
+				NULL);
+		}
+
+		return node_ptr1;
+	}
+
+	uint32_t bit1 = 1u << ((hash1 >> shift1) & 31);
+	if (node1->datamap & bit1) {
+		unsigned int i = index(node1->datamap, bit1);
+		if (!(node1->entry_at(i).key == key1)) {
+			return node_ptr1;
+		}
+
+		if (unique1) {
+			node* node2 = edit(node_ptr1);
+			node2->erase_entry(i);
+			node2->datamap &= ~bit1;
+			return node_ptr1;
+		}
+
+		return rebuild(node1, transient1, node1->datamap & ~bit1,
+			node1->nodemap, i, -1, NULL, NULL, -1, -1, NULL);
+	}
+
+	if (!(node1->nodemap & bit1)) {
+		return node_ptr1;
+	}
+
+	unsigned int i = index(node1->nodemap, bit1);
+	const node_ptr& child1 = node1->child_at(i);
+	node_ptr child2 = erase(child1, transient1, unique1, hash1, shift1 + 5,
+		key1);
+	if (!child2.get()) {
+		return child2;
+	}
+
+	if (child2->entries == 1 && child2->children == 0) {
+		unsigned int j = index(node1->datamap | bit1, bit1);
+		const entry& entry1 = child2->entry_at(0);
+		if (unique1 && node1->room() + sizeof(node_ptr) >= sizeof(entry)) {
+			node* node2 = edit(node_ptr1);
+			node2->erase_child(i);
+			node2->insert_entry(j, entry1.key, entry1.value);
+			node2->datamap |= bit1;
+			node2->nodemap &= ~bit1;
+			return node_ptr1;
+		}
+
+		return rebuild(node1, transient1, node1->datamap | bit1,
+			node1->nodemap & ~bit1, -1, j, &entry1.key, &entry1.value, i, -1,
+			NULL);
+	}
+
+	if (child2 == child1) {
+		return node_ptr1;
+	}
+
+	if (unique1) {
+		edit(node_ptr1)->replace_child(i, child2);
+		return node_ptr1;
+	}
+
+	return rebuild(node1, transient1, node1->datamap, node1->nodemap, -1, -1,
+		NULL, NULL, i, i, &child2);
+}
+
+template<class F>
+static void
+visit(const node* node1, const F& f1)
+{
+	if (!node1) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < node1->entries; i++) {
+		f1(node1->entry_at(i).key, node1->entry_at(i).value);
+	}
+
+	for (unsigned int i = 0; i < node1->children; i++) {
+		visit(node1->child_at(i).get(), f1);
+	}
+}
+
+};
+
+template<class K, class V, class H = std::hash<K> >
+class mutable_map
+{
+typedef const_map_node<K, V> node;
+typedef const_ptr<node> node_ptr;
+
+node_ptr _root;
+size_t _size;
+
+public:
+mutable_map()
+	: _root(mutable_ptr<node>((node*) NULL).build())
+	, _size(0)
+{
+}
+
+explicit
+mutable_map(const const_map<K, V, H>& map1)
+	: _root(map1._root)
+	, _size(map1._size)
+{
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+const V*
+find(const K& key1) const
+{
+	return const_map<K, V, H>::find(_root, H()(key1), key1);
+}
+
+bool
+set(const K& key1, const V& value1)
+{
+	bool added1 = false;
+	node_ptr root1 = const_map<K, V, H>::set(_root, true, true, H()(key1), 0,
+		key1, value1, &added1);
+	if (!root1.get()) {
+		return false;
+	}
+
+	reset(root1);
+	_size += added1;
+
+	return true;
+}
+
+bool
+erase(const K& key1)
+{
+	if (!find(key1)) {
+		return true;
+	}
+
+	node_ptr root1 = _size == 1 ? mutable_ptr<node>((node*) NULL).build() :
+		const_map<K, V, H>::erase(_root, true, true, H()(key1), 0, key1);
+	if (_size > 1 && !root1.get()) {
+		return false;
+	}
+
+	reset(root1);
+	_size--;
+
+	return true;
+}
+
+const_map<K, V, H>
+build() const
+{
+	return const_map<K, V, H>(_root, _size, true);
+}
+
+private:
+mutable_map(const mutable_map<K, V, H>&);
+
+mutable_map<K, V, H>& operator=(const mutable_map<K, V, H>&);
+
+void
+reset(const node_ptr& root1)
+{
+	if (root1 == _root) {
+		return;
+	}
+
+	node_ptr root2(root1);
+	_root.~node_ptr();
+	new (&_root) node_ptr(root2);
+}
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
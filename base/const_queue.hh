@@ -1,138 +1,233 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or altertantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/const_queue.hh`
-
-This file consists of class template <<const_queue>>.
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#ifndef HACTAR_CONST_QUEUE_HH
-#define HACTAR_CONST_QUEUE_HH
-
-#include <memory>
-
-namespace hactar {
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[const_queue]] class template `const_queue`
-
-class template `const_queue` is a queue with const modifier.
-
-`X` in `const_queue<X>` must be a value type without RAII tricks.
-
-As its name suggests, `const_queue` could only be initialized by merging other 
-`const_queue`s, or assigning other `const_ptr` with an extra value, or just a 
-value, and no modifications to it is allowed.
-
-For simple readonly copy cases, namely 'shadow copy's, it would not release the 
-memory. Otherwise, `const_queue` would release memory automatically.
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class X>
-class const_queue
-{
-unsigned int _size;
-X* _ptr;
-bool _is_shadow;
-
-public:
-const_queue()
-	: _size(0)
-	, _ptr(NULL)
-	, _is_shadow(false)
-{
-}
-
-const_queue(const X& x1)
-	: _size(1)
-	, _ptr((X*) malloc(sizeof(X)))
-	, _is_shadow(false)
-{
-	*_ptr = x1;
-}
-
-const_queue(const const_queue<X>& array1, const X& x1)
-	: _size(array1.size() + 1)
-	, _ptr((X*) malloc(_size * sizeof(X)))
-	, _is_shadow(false)
-{
-	for (unsigned int i = 0; i < array1.size(); i++) {
-		_ptr[i] = array1[i];
-	}
-
-	_ptr[array1.size()] = x1;
-}
-
-const_queue(const const_queue<X>& array1, const const_queue<X>& array2)
-	: _size(array1.size() + array2.size())
-	, _ptr((X*) malloc(_size * sizeof(X)))
-	, _is_shadow(false)
-{
-	for (unsigned int i = 0; i < array1.size(); i++) {
-		_ptr[i] = array1[i];
-	}
-
-	for (unsigned int i = 0; i < array2.size(); i++) {
-		_ptr[array1.size() + i] = array2[i];
-	}
-}
-
-const_queue(const const_queue<X>& array1)
-	: _size(array1._size)
-	, _ptr(array1._ptr)
-	, _is_shadow(true)
-{
-}
-
-~const_queue()
-{
-	if (_ptr && !_is_shadow) {
-		free(_ptr);
-		_ptr = NULL;
-	}
-}
-
-unsigned int
-size() const
-{
-	return _size;
-}
-
-const X&
-operator[](const unsigned int i) const
-{
-	return _ptr[i];
-}
-
-private:
-const_queue<X>& operator=(const const_queue<X>&);
-
-bool operator==(const const_queue<X>&);
-
-};
-
-}
-
-#endif
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or altertantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/const_queue.hh`
+
+This file consists of class template <<const_queue>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CONST_QUEUE_HH
+#define HACTAR_CONST_QUEUE_HH
+
+#include "alloc_trace.hh"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[const_queue]] class template `const_queue`
+
+class template `const_queue` is a queue with const modifier.
+
+`X` in `const_queue<X>` must be a copy constructible value type. Values are 
+copy constructed into the queue, so `X` is not required to be assignable.
+
+As its name suggests, `const_queue` could only be initialized by merging other 
+`const_queue`s, or assigning other `const_ptr` with an extra value, or just a 
+value, and no modifications to it is allowed.
+
+Copies of a `const_queue` share the same memory with a reference count, so 
+copying is O(1). The memory and the values are released with the last copy.
+
+Function `build` makes a queue of `size1` values constructed in place by 
+`f1(ptr)`, which must construct all the values at `ptr`. It returns an empty 
+queue if memory could not be allocated.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X>
+class const_queue
+{
+unsigned int _size;
+X* _ptr;
+
+public:
+const_queue()
+	: _size(0)
+	, _ptr(NULL)
+{
+}
+
+const_queue(const X& x1)
+	: _size(1)
+	, _ptr(allocate(_size))
+{
+	if (!_ptr) {
+		_size = 0;
+		return;
+	}
+
+	new (_ptr) X(x1);
+}
+
+const_queue(const const_queue<X>& array1, const X& x1)
+	: _size(array1.size() + 1)
+	, _ptr(allocate(_size))
+{
+	if (!_ptr) {
+		_size = 0;
+		return;
+	}
+
+	for (unsigned int i = 0; i < array1.size(); i++) {
+		new (_ptr + i) X(array1[i]);
+	}
+
+	new (_ptr + array1.size()) X(x1);
+}
+
+const_queue(const const_queue<X>& array1, const const_queue<X>& array2)
+	: _size(array1.size() + array2.size())
+	, _ptr(allocate(_size))
+{
+	if (!_ptr) {
+		_size = 0;
+		return;
+	}
+
+	for (unsigned int i = 0; i < array1.size(); i++) {
+		new (_ptr + i) X(array1[i]);
+	}
+
+	for (unsigned int i = 0; i < array2.size(); i++) {
+		new (_ptr + array1.size() + i) X(array2[i]);
+	}
+}
+
+const_queue(const const_queue<X>& array1)
+	: _size(array1._size)
+	, _ptr(array1._ptr)
+{
+	if (_ptr) {
+		count(_ptr)->fetch_add(1, std::memory_order_relaxed);
+		alloc_trace::retain<const_queue<X> >();
+	}
+}
+
+~const_queue()
+{
+	if (!_ptr) {
+		return;
+	}
+
+	alloc_trace::release<const_queue<X> >();
+	if (count(_ptr)->fetch_sub(1, std::memory_order_acq_rel) != 1) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		_ptr[i].~X();
+	}
+
+	count(_ptr)->~atomic();
+	alloc_trace::deallocate<const_queue<X> >(header_size() + _size *
+		sizeof(X));
+	free((char*) _ptr - header_size());
+	_ptr = NULL;
+}
+
+template<class F>
+static const_queue<X>
+build(unsigned int size1, const F& f1)
+{
+	const_queue<X> queue1;
+	queue1._ptr = allocate(size1);
+	if (!queue1._ptr) {
+		return queue1;
+	}
+
+	f1(queue1._ptr);
+	queue1._size = size1;
+
+	return queue1;
+}
+
+unsigned int
+size() const
+{
+	return _size;
+}
+
+const X*
+data() const
+{
+	return _ptr;
+}
+
+const X&
+operator[](const unsigned int i) const
+{
+	return _ptr[i];
+}
+
+private:
+typedef std::atomic<unsigned int> counter;
+
+static size_t
+header_size()
+{
+	return (sizeof(counter) + alignof(X) - 1) / alignof(X) * alignof(X);
+}
+
+static counter*
+count(X* ptr1)
+{
+	return (counter*) ((char*) ptr1 - header_size());
+}
+
+static X*
+allocate(unsigned int size1)
+{
+	if (size1 == 0) {
+		return NULL;
+	}
+
+	char* ptr = (char*) malloc(header_size() + size1 * sizeof(X));
+	if (!ptr) {
+		return NULL;
+	}
+
+	X* ptr1 = (X*) (ptr + header_size());
+	new (count(ptr1)) counter(1);
+	alloc_trace::allocate<const_queue<X> >(header_size() + size1 *
+		sizeof(X));
+	alloc_trace::retain<const_queue<X> >();
+
+	return ptr1;
+}
+
+const_queue<X>& operator=(const const_queue<X>&);
+
+bool operator==(const const_queue<X>&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
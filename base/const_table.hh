@@ -0,0 +1,237 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/const_table.hh`
+
+This file consists of class template <<const_table>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CONST_TABLE_HH
+#define HACTAR_CONST_TABLE_HH
+
+#include "action.hh"
+#include "const_queue.hh"
+
+#include <stdlib.h>
+
+#include <new>
+#include <tuple>
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[const_table]] class template `const_table`
+
+Class template `const_table` is a collection of immutable states stored as 
+columns, where the `I`-th field of all states is kept in a `const_queue` of 
+type `X_I`. Copies of a table and tables derived from it share the columns 
+they have not changed, so every column is copied on write on its own.
+
+Method `bind<I>` returns a table with an action applied to the `I`-th field 
+of every state, in one pass over the column, which the compiler could 
+vectorize for simple actions. The other columns are shared. With a collection 
+of rows, such as a `const_queue<unsigned int>` or a `span<unsigned int>`, the 
+column is copied and the action is only applied to the fields of those rows. 
+Rows are gathered in the order given, with the fields of rows 
+`prefetch_distance` ahead prefetched. The action is applied to the field in 
+the table, so a row given twice is updated once, and rows out of range are 
+ignored.
+
+A table is invalid if its columns have different sizes, or memory could not 
+be allocated for a column.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+const_table<double, double> table1(values, mvalues); // two const_queue
+const_table<double, double> table2 = table1.bind<0>(wrap(add, 1.0));
+// table2.column<0>()[i] == values[i] + 1.0, column<1> is shared with table1
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class... X>
+class const_table
+{
+std::tuple<const_queue<X>...> _columns;
+unsigned int _size;
+bool _valid;
+
+public:
+template<unsigned int I>
+using type = typename std::tuple_element<I, std::tuple<X...> >::type;
+
+enum
+{
+	prefetch_distance = 16
+};
+
+const_table()
+	: _size(0)
+	, _valid(true)
+{
+}
+
+explicit
+const_table(const const_queue<X>&... columns1)
+	: _columns(columns1...)
+	, _size(std::get<0>(_columns).size())
+	, _valid(((columns1.size() == _size) && ...))
+{
+}
+
+const_table(const const_table<X...>& table1)
+	: _columns(table1._columns)
+	, _size(table1._size)
+	, _valid(table1._valid)
+{
+}
+
+bool
+valid() const
+{
+	return _valid;
+}
+
+unsigned int
+size() const
+{
+	return _size;
+}
+
+template<unsigned int I>
+const const_queue<type<I> >&
+column() const
+{
+	return std::get<I>(_columns);
+}
+
+template<unsigned int I, class TAG>
+const_table<X...>
+bind(const action<type<I>, type<I>, TAG>& f1) const
+{
+	if (!_valid) {
+		return *this;
+	}
+
+	const type<I>* in1 = column<I>().data();
+	const_queue<type<I> > column1 = const_queue<type<I> >::build(_size,
+		[&](type<I>* out1) {
+			transform(f1, in1, out1, _size);
+		});
+
+	return replace<I>(column1, std::index_sequence_for<X...>());
+}
+
+template<unsigned int I, class TAG, class C>
+const_table<X...>
+bind(const action<type<I>, type<I>, TAG>& f1, const C& rows1) const
+{
+	if (!_valid) {
+		return *this;
+	}
+
+	const type<I>* in1 = column<I>().data();
+	const_queue<type<I> > column1 = const_queue<type<I> >::build(_size,
+		[&](type<I>* out1) {
+			for (unsigned int i = 0; i < _size; i++) {
+				new (out1 + i) type<I>(in1[i]);
+			}
+
+			gather(f1, in1, out1, _size, rows1);
+		});
+
+	return replace<I>(column1, std::index_sequence_for<X...>());
+}
+
+private:
+const_table<X...>& operator=(const const_table<X...>&);
+
+template<class T, class TAG>
+static void
+transform(const action<T, T, TAG>& f1, const T* __restrict in1,
+	T* __restrict out1, unsigned int size1)
+{
+	for (unsigned int i = 0; i < size1; i++) {
+		new (out1 + i) T(f1(in1[i]));
+	}
+}
+
+template<class T, class TAG, class C>
+static void
+gather(const action<T, T, TAG>& f1, const T* in1, T* out1,
+	unsigned int size1, const C& rows1)
+{
+	unsigned int size2 = rows1.size();
+	for (unsigned int i = 0; i < size2; i++) {
+		if (i + prefetch_distance < size2) {
+			unsigned int row1 = rows1[i + prefetch_distance];
+			if (row1 < size1) {
+				__builtin_prefetch(in1 + row1, 0);
+				__builtin_prefetch(out1 + row1, 1);
+			}
+		}
+
+		unsigned int row2 = rows1[i];
+		if (row2 < size1) {
+			T value1(f1(in1[row2]));
+			out1[row2].~T();
+			new (out1 + row2) T(value1);
+		}
+	}
+}
+
+template<unsigned int I, unsigned int J, class T>
+const const_queue<type<J> >&
+pick(const const_queue<T>& column1) const
+{
+	if constexpr (I == J) {
+		return column1;
+	}
+	else {
+		return std::get<J>(_columns);
+	}
+}
+
+template<unsigned int I, class T, size_t... J>
+const_table<X...>
+replace(const const_queue<T>& column1, std::index_sequence<J...>) const
+{
+	if (_size && !column1.size()) {
+		const_table<X...> table1;
+		table1._valid = false;
+		return table1;
+	}
+
+	return const_table<X...>(pick<I, J>(column1)...);
+}
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
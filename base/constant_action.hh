@@ -0,0 +1,139 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/constant_action.hh`
+
+This file consists of function <<constant>> and 
+<<action with constant_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CONSTANT_ACTION_HH
+#define HACTAR_CONSTANT_ACTION_HH
+
+#include "action.hh"
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with constant_action_tag]] action with constant_action_tag
+
+Constant actions are used for composition of actions in constant expressions. 
+A complex action keeps the actions after the second in a `const_queue`, which 
+is allocated and released at runtime, so it could not be a constant. A 
+constant action keeps every composed action by value instead, nesting one 
+composition in another for every action appended by `operator&`, so that it 
+could be evaluated at compile time if all the composed actions could be.
+
+Function wrap actions, static wrap actions, functor wrap actions of constexpr 
+lambdas and variadic wrap actions are constexpr, as well as loop actions of 
+them, which skip profiling in constant expressions. Constant actions are 
+evaluated directly, without recording steps in a profiled action.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUTIN, class TAG1, class TAG2>
+struct constant_action_tag { };
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+class action<OUT, IN, constant_action_tag<OUTIN, TAG1, TAG2> >
+{
+action<OUTIN, IN, TAG1> _f;
+action<OUT, OUTIN, TAG2> _g;
+
+public:
+constexpr
+action(const action<OUTIN, IN, TAG1>& f1, const action<OUT, OUTIN, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+constexpr const action<OUTIN, IN, TAG1>&
+first() const
+{
+	return _f;
+}
+
+constexpr const action<OUT, OUTIN, TAG2>&
+second() const
+{
+	return _g;
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return _g(_f(in1));
+}
+
+};
+
+template<class OUT, class IN, class OUTIN, class X, class TAG1, class TAG2,
+	class TAG3>
+constexpr action<OUT, IN, constant_action_tag<OUTIN, constant_action_tag<X,
+	TAG1, TAG2>, TAG3> >
+operator&(const action<OUTIN, IN, constant_action_tag<X, TAG1, TAG2> >& f1,
+	const action<OUT, OUTIN, TAG3>& g1)
+{
+	return action<OUT, IN, constant_action_tag<OUTIN, constant_action_tag<X,
+		TAG1, TAG2>, TAG3> > (f1, g1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[constant]] function `constant`
+
+Function `constant` makes a constant action of an action `IN -> OUT`, to which 
+other actions are composed with `operator&` into constant actions.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+constexpr double add(const double& x, double y) { return x + y; }
+constexpr double twice(const double& x) { return x * 2.0; }
+
+constexpr double t = (constant(wrap(add, 1.0)) & wrap(twice) * 8)(0.0);
+static_assert(t == 256.0); // => evaluated at compile time
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT, class IN, class TAG>
+constexpr action<OUT, IN, constant_action_tag<OUT, TAG, null_action_tag> >
+constant(const action<OUT, IN, TAG>& f1)
+{
+	return action<OUT, IN, constant_action_tag<OUT, TAG, null_action_tag> > (
+		f1, action<OUT, OUT> ());
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
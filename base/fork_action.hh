@@ -0,0 +1,343 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or altertantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/fork_action.hh`
+
+This file consists of class template <<duo>>, <<action with fork_action_tag>>, 
+<<fork action with shared prefix>>, <<action with zip_action_tag>> and 
+<<action with join_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_FORK_ACTION_HH
+#define HACTAR_FORK_ACTION_HH
+
+#include "action.hh"
+#include "complex_action.hh"
+#include "intern_action.hh"
+
+#include <type_traits>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[duo]] class template `duo`
+
+Class template `duo` is a pair of values passed between forked actions. `duo` 
+is an aggregate, so that results of actions are constructed in place without 
+being copied or moved.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X1, class X2>
+struct duo
+{
+X1 first;
+X2 second;
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with fork_action_tag]] action with fork_action_tag
+
+A fork action runs two actions on the same input, and returns both results in 
+a `duo`. A fork action is constructed by two actions with function `fork`.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+fork(wrap(add, 10.0), wrap(add, 5.0))(1.0); // => { 11.0, 6.0 }
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG1, class TAG2>
+struct fork_action_tag { };
+
+template<class OUT1, class OUT2, class IN, class TAG1, class TAG2>
+class action<duo<OUT1, OUT2>, IN, fork_action_tag<TAG1, TAG2> >
+{
+action<OUT1, IN, TAG1> _f;
+action<OUT2, IN, TAG2> _g;
+
+public:
+action(const action<OUT1, IN, TAG1>& f1, const action<OUT2, IN, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+}
+
+duo<OUT1, OUT2>
+operator()(const IN& in1) const
+{
+	return duo<OUT1, OUT2> { _f(in1), _g(in1) };
+}
+
+};
+
+template<class OUT1, class OUT2, class IN, class TAG1, class TAG2>
+action<duo<OUT1, OUT2>, IN, fork_action_tag<TAG1, TAG2> >
+fork(const action<OUT1, IN, TAG1>& f1, const action<OUT2, IN, TAG2>& g1)
+{
+	return action<duo<OUT1, OUT2>, IN, fork_action_tag<TAG1, TAG2> > (f1,
+		g1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[fork action with shared prefix]] fork action with shared prefix
+
+A fork action of two complex actions beginning with the same stage evaluates 
+the stage once, and runs both remainders on its result. Stages are compared 
+by <<same_action>> when the fork action is constructed, so stages are shared if 
+they are interned by the same <<intern_table>>, or built of the same function 
+pointers and bound arguments. If both complex actions are of the same type, 
+the longest common prefix of their stages is shared, which is a DAG of the 
+stages with one fork point. Method `shared` returns the number of shared 
+stages.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+auto f = fork(wrap(slow, 1.0) & wrap(add, 10.0), wrap(slow, 1.0) &
+	wrap(add, 5.0)); // => f.shared() == 1
+f(1.0); // => slow is evaluated once
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT1, class OUT2, class IN, class OUTIN, class TAG1, class TAG2,
+	class TAG3>
+class action<duo<OUT1, OUT2>, IN, fork_action_tag<
+		complex_action_tag<OUTIN, TAG1, TAG2>,
+		complex_action_tag<OUTIN, TAG1, TAG3> > >
+{
+typedef action<OUT1, IN, complex_action_tag<OUTIN, TAG1, TAG2> > F;
+typedef action<OUT2, IN, complex_action_tag<OUTIN, TAG1, TAG3> > G;
+
+F _f;
+G _g;
+unsigned int _shared;
+
+public:
+action(const F& f1, const G& g1)
+	: _f(f1)
+	, _g(g1)
+	, _shared(prefix(f1, g1))
+{
+}
+
+unsigned int
+shared() const
+{
+	return _shared;
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+	v1(_shared);
+}
+
+duo<OUT1, OUT2>
+operator()(const IN& in1) const
+{
+	if (_shared == 0) {
+		return duo<OUT1, OUT2> { _f(in1), _g(in1) };
+	}
+
+	OUTIN outin = _f.first()(in1);
+	if constexpr (std::is_same<F, G>::value) {
+		if (_shared > 1) {
+			OUT1 out = _f.second()(outin);
+			unsigned int i = 0;
+			for (; i + 2 < _shared; i++) {
+				out = _f.rest()[i](out);
+			}
+
+			return duo<OUT1, OUT2> { _f.resume(i, out), _g.resume(i, out) };
+		}
+	}
+
+	return duo<OUT1, OUT2> { _f.finish(outin), _g.finish(outin) };
+}
+
+private:
+static unsigned int
+prefix(const F& f1, const G& g1)
+{
+	if (!same_action(f1.first(), g1.first())) {
+		return 0;
+	}
+
+	if constexpr (std::is_same<F, G>::value) {
+		if (!same_action(f1.second(), g1.second())) {
+			return 1;
+		}
+
+		unsigned int i = 0;
+		while (i < f1.rest().size() && i < g1.rest().size() &&
+			same_action(f1.rest()[i], g1.rest()[i])) {
+			i++;
+		}
+
+		return i + 2;
+	}
+
+	return 1;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with zip_action_tag]] action with zip_action_tag
+
+A zip action runs two actions on the two values of a `duo` respectively, and 
+returns both results in a `duo`. A zip action is constructed by two actions 
+with function `zip`. Values of the input `duo` are passed by reference.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+zip(wrap(add, 10.0), wrap(add, 5.0))(duo<double, double> { 1.0, 2.0 });
+// => { 11.0, 7.0 }
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG1, class TAG2>
+struct zip_action_tag { };
+
+template<class OUT1, class OUT2, class IN1, class IN2, class TAG1, class TAG2>
+class action<duo<OUT1, OUT2>, duo<IN1, IN2>, zip_action_tag<TAG1, TAG2> >
+{
+action<OUT1, IN1, TAG1> _f;
+action<OUT2, IN2, TAG2> _g;
+
+public:
+action(const action<OUT1, IN1, TAG1>& f1, const action<OUT2, IN2, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_g);
+}
+
+duo<OUT1, OUT2>
+operator()(const duo<IN1, IN2>& in1) const
+{
+	return duo<OUT1, OUT2> { _f(in1.first), _g(in1.second) };
+}
+
+};
+
+template<class OUT1, class OUT2, class IN1, class IN2, class TAG1, class TAG2>
+action<duo<OUT1, OUT2>, duo<IN1, IN2>, zip_action_tag<TAG1, TAG2> >
+zip(const action<OUT1, IN1, TAG1>& f1, const action<OUT2, IN2, TAG2>& g1)
+{
+	return action<duo<OUT1, OUT2>, duo<IN1, IN2>,
+		zip_action_tag<TAG1, TAG2> > (f1, g1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with join_action_tag]] action with join_action_tag
+
+A join action feeds the two values of a `duo` to a binary function, and 
+returns its result. A join action is constructed by the binary function with 
+function `join`. Values of the input `duo` are passed by reference.
+
+Fork actions, zip actions and join actions could be composed with other 
+actions by `operator&`.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+double subtract(const double& x, const double& y) { return x - y; }
+
+(fork(wrap(add, 10.0), wrap(add, 5.0)) & join(subtract))(1.0); // => 5.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct join_action_tag { };
+
+template<class OUT, class IN1, class IN2>
+class action<OUT, duo<IN1, IN2>, join_action_tag>
+{
+typedef OUT (* F)(const IN1&, const IN2&);
+
+F _f;
+
+public:
+action(F f1)
+	: _f(f1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+}
+
+OUT
+operator()(const duo<IN1, IN2>& in1) const
+{
+	return _f(in1.first, in1.second);
+}
+
+};
+
+template<class OUT, class IN1, class IN2>
+action<OUT, duo<IN1, IN2>, join_action_tag>
+join(OUT (* f1)(const IN1&, const IN2&))
+{
+	return action<OUT, duo<IN1, IN2>, join_action_tag> (f1);
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
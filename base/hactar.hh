@@ -1,76 +1,314 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or substantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/hactar.hh`
-
-This file consists of function <<unit>> and operator& (<<bind>>).
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#ifndef HACTAR_HH
-#define HACTAR_HH
-
-#include "const_ptr.hh"
-#include "mutable_ptr.hh"
-#include "action.hh"
-#include "wrap_action.hh"
-#include "complex_action.hh"
-#include "offer_action.hh"
-#include "loop_action.hh"
-
-namespace hactar {
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[unit]] function `unit`
-
-Function `unit` is a function to be overloaded for converting value of type `X` 
-into a `const_ptr` of type `T`.
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class T, class X>
-const_ptr<T>
-unit(const X& x)
-{
-	return mutable_ptr<T> ()->build();
-}
-
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[bind]] `operator&`
-
-Operator>> is a function template to be overloaded for adding side-effects to 
-an action to a `const_ptr`. Actions are kept pure since all side-effects are 
-in overloading and specilizing this function template.
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class T, class TAG, class OUT, class IN>
-const_ptr<T>
-operator&(const const_ptr<T>& const_ptr1, const action<TAG, OUT, IN>& f1)
-{
-	return const_ptr1;
-}
-
-}
-
-#endif
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/hactar.hh`
+
+This file consists of function <<unit>>, operator& (<<bind>>) and class 
+template <<outcome>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_HH
+#define HACTAR_HH
+
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+#include "action.hh"
+#include "profile_action.hh"
+#include "wrap_action.hh"
+#include "complex_action.hh"
+#include "constant_action.hh"
+#include "offer_action.hh"
+#include "loop_action.hh"
+#include "fork_action.hh"
+#include "intern_action.hh"
+#include "span.hh"
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[unit]] function `unit`
+
+Function `unit` is a function to be overloaded for converting value of type `X` 
+into a `const_ptr` of type `T`.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T, class X>
+const_ptr<T>
+unit(const X& x)
+{
+	return mutable_ptr<T> ()->build();
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[bind]] `operator&`
+
+Operator>> is a function template to be overloaded for adding side-effects to 
+an action to a `const_ptr`. Actions are kept pure since all side-effects are 
+in overloading and specilizing this function template.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T, class TAG, class OUT, class IN>
+const_ptr<T>
+operator&(const const_ptr<T>& const_ptr1, const action<TAG, OUT, IN>& f1)
+{
+	return const_ptr1;
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[outcome]] class template `outcome`
+
+Class template `outcome` carries a `const_ptr` state through a bind chain 
+together with an error code and the index of the stage that failed, so that a 
+failed chain stops calling binds. Binding an action to a successful outcome 
+binds it to its state, and the result becomes the next outcome: an empty state 
+fails with error `outcome_empty`, and a bind overloaded to return an 
+`outcome` itself, e.g. by function `fail`, could fail with its own error code. 
+Binding an action to a failed outcome returns it as it is in one branch, 
+without calling the bind. Binding a complex action to an outcome binds its 
+composed actions one after another, each as a stage, and leaves at the first 
+stage that fails, so the rest of a failed chain is skipped at once. A chain 
+that could fail early is better composed into one complex action, as in 
+`out & (f & f & f)`, than bound stage by stage, which costs a branch for every 
+remaining stage.
+
+Method `error` returns the error code, which is `outcome_ok` if no stage 
+failed, method `stage` returns the number of stages bound successfully, that 
+is the index of the failing stage, and method `state` returns the state, 
+which is empty once a stage fails.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+const_ptr<calc> operator&(const const_ptr<calc>& x, const action<...>& f);
+outcome<calc> operator&(const const_ptr<calc>& x, const action<...>& check);
+
+outcome<calc> out = outcome<calc>(unit<calc>(3.14)) & f & check & f & f;
+out.error(); // => error code of check if it fails, and f is not bound after
+out.stage(); // => 1 if check fails
+
+outcome<calc> out2 = outcome<calc>(unit<calc>(3.14)) & (f & f & f & f);
+out2.stage(); // => 4 if every f passes, or the index of the first failing f
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+enum
+{
+	outcome_ok = 0,
+	outcome_empty = -1
+};
+
+template<class T>
+class outcome
+{
+const_ptr<T> _state;
+int _error;
+unsigned int _stage;
+
+public:
+outcome(const const_ptr<T>& state1)
+	: _state(state1)
+	, _error(state1.get() ? outcome_ok : outcome_empty)
+	, _stage(0)
+{
+}
+
+outcome(const outcome<T>& outcome1)
+	: _state(outcome1._state)
+	, _error(outcome1._error)
+	, _stage(outcome1._stage)
+{
+}
+
+outcome(outcome<T>&& outcome1)
+	: _state(static_cast<const_ptr<T>&&> (outcome1._state))
+	, _error(outcome1._error)
+	, _stage(outcome1._stage)
+{
+}
+
+outcome(const const_ptr<T>& state1, int error1, unsigned int stage1)
+	: _state(state1)
+	, _error(error1)
+	, _stage(stage1)
+{
+}
+
+outcome(const_ptr<T>&& state1, int error1, unsigned int stage1)
+	: _state(static_cast<const_ptr<T>&&> (state1))
+	, _error(error1)
+	, _stage(stage1)
+{
+}
+
+int
+error() const
+{
+	return _error;
+}
+
+unsigned int
+stage() const
+{
+	return _stage;
+}
+
+const const_ptr<T>&
+state() const
+{
+	return _state;
+}
+
+template<class R>
+static outcome<T>
+finish(R&& result1, unsigned int stage1)
+{
+	int error1 = error_of(result1);
+
+	return outcome<T> (state_of(result1), error1, error1 == outcome_ok ?
+		stage1 + 1 : stage1);
+}
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+static outcome<T>
+walk(const const_ptr<T>& state1,
+	const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& f1,
+	unsigned int stage1)
+{
+	auto first1 = state1 & f1.first();
+	int error1 = error_of(first1);
+	if (__builtin_expect(error1 != outcome_ok, 0)) {
+		return outcome<T> (state_of(first1), error1, stage1);
+	}
+
+	const_ptr<T> state2(state_of(first1));
+	auto second1 = state2 & f1.second();
+	error1 = error_of(second1);
+	if (__builtin_expect(error1 != outcome_ok, 0)) {
+		return outcome<T> (state_of(second1), error1, stage1 + 1);
+	}
+
+	const_ptr<T> state3(state_of(second1));
+	for (unsigned int i = 0; i < f1.rest().size(); i++) {
+		auto next1 = state3 & f1.rest()[i];
+		error1 = error_of(next1);
+		state3.~const_ptr<T>();
+		new (&state3) const_ptr<T>(state_of(next1));
+		if (__builtin_expect(error1 != outcome_ok, 0)) {
+			return outcome<T> (static_cast<const_ptr<T>&&> (state3), error1,
+				stage1 + 2 + i);
+		}
+	}
+
+	return outcome<T> (static_cast<const_ptr<T>&&> (state3), outcome_ok,
+		stage1 + 2 + f1.rest().size());
+}
+
+private:
+static int
+error_of(const const_ptr<T>& state1)
+{
+	return state1.get() ? outcome_ok : outcome_empty;
+}
+
+static int
+error_of(const outcome<T>& outcome1)
+{
+	return outcome1._error;
+}
+
+static const_ptr<T>&&
+state_of(const_ptr<T>& state1)
+{
+	return static_cast<const_ptr<T>&&> (state1);
+}
+
+static const_ptr<T>&&
+state_of(outcome<T>& outcome1)
+{
+	return static_cast<const_ptr<T>&&> (outcome1._state);
+}
+
+outcome<T>& operator=(const outcome<T>&);
+
+};
+
+template<class T>
+outcome<T>
+fail(int error1)
+{
+	return outcome<T> (mutable_ptr<T> ((T*) NULL).build(), error1, 0);
+}
+
+template<class T, class OUT, class IN, class TAG>
+outcome<T>
+operator&(const outcome<T>& outcome1, const action<OUT, IN, TAG>& f1)
+{
+	if (__builtin_expect(outcome1.error() != outcome_ok, 0)) {
+		return outcome1;
+	}
+
+	return outcome<T>::finish(outcome1.state() & f1, outcome1.stage());
+}
+
+template<class T, class OUT, class IN, class TAG>
+outcome<T>
+operator&(outcome<T>&& outcome1, const action<OUT, IN, TAG>& f1)
+{
+	if (__builtin_expect(outcome1.error() != outcome_ok, 0)) {
+		return static_cast<outcome<T>&&> (outcome1);
+	}
+
+	return outcome<T>::finish(outcome1.state() & f1, outcome1.stage());
+}
+
+template<class T, class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+outcome<T>
+operator&(const outcome<T>& outcome1,
+	const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& f1)
+{
+	if (__builtin_expect(outcome1.error() != outcome_ok, 0)) {
+		return outcome1;
+	}
+
+	return outcome<T>::walk(outcome1.state(), f1, outcome1.stage());
+}
+
+template<class T, class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+outcome<T>
+operator&(outcome<T>&& outcome1,
+	const action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> >& f1)
+{
+	if (__builtin_expect(outcome1.error() != outcome_ok, 0)) {
+		return static_cast<outcome<T>&&> (outcome1);
+	}
+
+	return outcome<T>::walk(outcome1.state(), f1, outcome1.stage());
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,314 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/incremental.hh`
+
+This file consists of functions <<incremental_read>> and class template 
+<<incremental_chain>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_INCREMENTAL_HH
+#define HACTAR_INCREMENTAL_HH
+
+#include "action.hh"
+#include "complex_action.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[incremental_read]] functions `incremental_read` and `incremental_write`
+
+Functions `incremental_read` and `incremental_write` record that field 
+`field1`, counted from 0 to 63, of a state is read or written by the stage 
+being recorded by an <<incremental_chain>> in the calling thread. Getters and 
+setters of a state call them to make the state trackable, and they do nothing 
+but test a thread-local pointer if no stage is being recorded.
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct incremental_fields
+{
+uint64_t reads;
+uint64_t writes;
+};
+
+inline thread_local incremental_fields* incremental_current;
+
+inline void
+incremental_read(unsigned int field1)
+{
+	if (incremental_current) {
+		incremental_current->reads |= 1ULL << field1;
+	}
+}
+
+inline void
+incremental_write(unsigned int field1)
+{
+	if (incremental_current) {
+		incremental_current->writes |= 1ULL << field1;
+	}
+}
+
+template<class T>
+struct incremental_stage
+{
+const_ptr<T> out;
+incremental_fields fields;
+};
+
+template<class T, class F>
+class incremental_chain;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[incremental_chain]] class template `incremental_chain`
+
+Class template `incremental_chain` evaluates a bind chain `state & a & b & 
+...` of a complex action `a & b & ...` stage by stage, and adjusts its result 
+when the input state changes in a few fields, rerunning only the stages which 
+read changed fields. It records for every stage the fields read and written 
+and the output state. On the next input, the fields changed since the last 
+input are found by `T::diff`, and a stage reading none of them is not rerun: 
+its last output is reused, with the changed fields it does not write copied 
+from its new input by `T::assign`. Otherwise the stage is rerun and the fields 
+changed in its output are passed on to the next stage. Once no field is 
+changed, all remaining stages are reused.
+
+`T` must be reference counted as in `const_ptr<T>`, and have method `uint64_t 
+diff(const T& x1) const`, which returns a bit for every field differing from 
+`x1`, and method `void assign(const T& x1, uint64_t fields1)`, which copies the 
+fields of `fields1` from `x1` without recording them. Getters and setters of 
+the fields must call <<incremental_read>> and `incremental_write`. A bind of 
+`T` should start from an untracked copy of its input, e.g. by `assign`, and 
+only set the fields it computes, so that other fields pass through. Stages 
+whose outputs differ from their inputs in fields they do not write are rerun 
+on any change.
+
+The trace is bounded: one output state and two masks are kept for every 
+stage, however many inputs are evaluated, and method `reset` drops them. 
+Methods `evaluated` and `reused` count the stages rerun and reused. A chain is 
+invalid if memory could not be allocated, and it returns an empty state if a 
+stage does. A chain must not be evaluated by more than one thread at once.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+auto f = cell(0, 2, wrap(add, 1.0)) & cell(1, 3, wrap(multiply, 2.0));
+incremental_chain<cells, decltype(f)> chain1(f);
+chain1(cells1); // => both stages run
+chain1(cells2); // => only the second stage runs if cells2 differs in field 1
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T, class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+class incremental_chain<T, action<OUT, IN, complex_action_tag<OUTIN, TAG1,
+		TAG2> > >
+{
+typedef action<OUT, IN, complex_action_tag<OUTIN, TAG1, TAG2> > F;
+
+F _f;
+unsigned int _size;
+incremental_stage<T>* _stages;
+const_ptr<T> _in;
+bool _primed;
+uint64_t _evaluated;
+uint64_t _reused;
+
+public:
+explicit
+incremental_chain(const F& f1)
+	: _f(f1)
+	, _size(f1.rest().size() + 2)
+	, _stages((incremental_stage<T>*) malloc(_size *
+		sizeof(incremental_stage<T>)))
+	, _in(mutable_ptr<T>((T*) NULL).build())
+	, _primed(false)
+	, _evaluated(0)
+	, _reused(0)
+{
+	if (!_stages) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		new (&_stages[i].out) const_ptr<T>(mutable_ptr<T>((T*) NULL).build());
+		_stages[i].fields.reads = ~0ULL;
+		_stages[i].fields.writes = 0;
+	}
+}
+
+~incremental_chain()
+{
+	if (!_stages) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		_stages[i].out.~const_ptr<T>();
+	}
+
+	free(_stages);
+}
+
+bool
+valid() const
+{
+	return _stages != NULL;
+}
+
+uint64_t
+evaluated() const
+{
+	return _evaluated;
+}
+
+uint64_t
+reused() const
+{
+	return _reused;
+}
+
+void
+reset()
+{
+	for (unsigned int i = 0; _stages && i < _size; i++) {
+		replace(_stages[i].out, mutable_ptr<T>((T*) NULL).build());
+	}
+
+	replace(_in, mutable_ptr<T>((T*) NULL).build());
+	_primed = false;
+}
+
+const_ptr<T>
+operator()(const const_ptr<T>& in1)
+{
+	if (!_stages || !in1.get()) {
+		return mutable_ptr<T>((T*) NULL).build();
+	}
+
+	bool primed1 = _primed;
+	uint64_t changed1 = ~0ULL;
+	if (primed1) {
+		changed1 = in1.get() == _in.get() ? 0 : in1->diff(*_in.get());
+	}
+
+	_primed = false;
+	replace(_in, in1);
+	const_ptr<T> state1 = in1;
+	for (unsigned int i = 0; i < _size; i++) {
+		incremental_stage<T>& stage1 = _stages[i];
+		if (primed1 && !(changed1 & stage1.fields.reads)) {
+			changed1 &= ~stage1.fields.writes;
+			const_ptr<T> state2 = changed1 ? patch(stage1.out, state1,
+				changed1) : stage1.out;
+			if (!state2.get()) {
+				return state2;
+			}
+
+			replace(stage1.out, state2);
+			replace(state1, state2);
+			_reused++;
+			continue;
+		}
+
+		incremental_fields fields1 = { 0, 0 };
+		incremental_fields* previous1 = incremental_current;
+		incremental_current = &fields1;
+		const_ptr<T> state2 = bind(i, state1);
+		incremental_current = previous1;
+		if (!state2.get()) {
+			return state2;
+		}
+
+		if (state2->diff(*state1.get()) & ~fields1.writes) {
+			fields1.reads = ~0ULL;
+		}
+
+		changed1 = primed1 ? state2->diff(*stage1.out.get()) : ~0ULL;
+		stage1.fields = fields1;
+		replace(stage1.out, state2);
+		replace(state1, state2);
+		_evaluated++;
+	}
+
+	_primed = true;
+
+	return state1;
+}
+
+private:
+incremental_chain(const incremental_chain&);
+
+incremental_chain&
+operator=(const incremental_chain&);
+
+static void
+replace(const_ptr<T>& ptr1, const const_ptr<T>& ptr2)
+{
+	const_ptr<T> ptr3(ptr2);
+	ptr1.~const_ptr<T>();
+	new (&ptr1) const_ptr<T>(ptr3);
+}
+
+static const_ptr<T>
+patch(const const_ptr<T>& out1, const const_ptr<T>& in1, uint64_t fields1)
+{
+	mutable_ptr<T> state1;
+	if (!state1.get()) {
+		return state1.build();
+	}
+
+	state1->assign(*out1.get(), ~0ULL);
+	state1->assign(*in1.get(), fields1);
+
+	return state1.build();
+}
+
+const_ptr<T>
+bind(unsigned int i, const const_ptr<T>& state1) const
+{
+	if (i == 0) {
+		return state1 & _f.first();
+	}
+
+	if (i == 1) {
+		return state1 & _f.second();
+	}
+
+	return state1 & _f.rest()[i - 2];
+}
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
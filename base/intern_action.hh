@@ -0,0 +1,553 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/intern_action.hh`
+
+This file consists of class <<intern_key>>, class <<intern_table>>, function 
+<<same_action>> and <<action with interned_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_INTERN_ACTION_HH
+#define HACTAR_INTERN_ACTION_HH
+
+#include "action.hh"
+#include "const_ptr.hh"
+#include "const_queue.hh"
+#include "mutable_ptr.hh"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+namespace hactar {
+
+template<class X>
+class intern_node
+{
+std::atomic<unsigned int> _rc;
+X _value;
+
+public:
+explicit
+intern_node(const X& value1)
+	: _rc(0)
+	, _value(value1)
+{
+}
+
+bool
+retain()
+{
+	return _rc.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+const X&
+value() const
+{
+	return _value;
+}
+
+static void
+drop(const void* node1)
+{
+	const_ptr<intern_node<X> >* ptr1 = (const_ptr<intern_node<X> >*) node1;
+	ptr1->~const_ptr<intern_node<X> >();
+}
+
+private:
+intern_node(const intern_node&);
+
+intern_node&
+operator=(const intern_node&);
+
+};
+
+struct intern_slot
+{
+size_t hash;
+const void* type;
+char* key;
+size_t key_size;
+void (*release)(const void*);
+alignas(void*) char node[sizeof(void*)];
+};
+
+template<class X>
+struct intern_type
+{
+static const char id;
+};
+
+template<class X>
+const char intern_type<X>::id = 0;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[intern_key]] class `intern_key`
+
+Class `intern_key` collects the bytes of the fields of an action, by which 
+actions are compared and hashed. An action with a method `fields`, which passes 
+every field to the key, is collected field by field, so that padding between 
+fields is never compared. Other fields are collected by their bytes if they are 
+scalars or have no padding, i.e. `std::has_unique_object_representations`, and 
+empty ones are skipped. A `const_ptr` or a `const_queue` is collected by the 
+address it shares, and a tuple element by element. Any other field makes the 
+key opaque, and an action with an opaque key is never identical to another one.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class intern_key
+{
+char _buffer[64];
+char* _data;
+size_t _size;
+size_t _capacity;
+bool _opaque;
+
+public:
+intern_key()
+	: _data(_buffer)
+	, _size(0)
+	, _capacity(sizeof(_buffer))
+	, _opaque(false)
+{
+}
+
+~intern_key()
+{
+	if (_data != _buffer) {
+		free(_data);
+	}
+}
+
+bool
+comparable() const
+{
+	return !_opaque;
+}
+
+const char*
+data() const
+{
+	return _data;
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+bool
+equals(const intern_key& key1) const
+{
+	return !_opaque && !key1._opaque && _size == key1._size &&
+		memcmp(_data, key1._data, _size) == 0;
+}
+
+template<class X>
+void
+operator()(const X& x1)
+{
+	collect(x1, 0);
+}
+
+template<class T>
+void
+operator()(const const_ptr<T>& x1)
+{
+	const T* ptr1 = x1.get();
+	bytes(&ptr1, sizeof(ptr1));
+}
+
+template<class X>
+void
+operator()(const const_queue<X>& x1)
+{
+	unsigned int size1 = x1.size();
+	const X* ptr1 = size1 ? &x1[0] : NULL;
+	bytes(&size1, sizeof(size1));
+	bytes(&ptr1, sizeof(ptr1));
+}
+
+template<class... A>
+void
+operator()(const std::tuple<A...>& x1)
+{
+	std::apply([this](const A&... a1) { ((*this)(a1), ...); }, x1);
+}
+
+private:
+intern_key(const intern_key&);
+
+intern_key&
+operator=(const intern_key&);
+
+template<class X>
+auto
+collect(const X& x1, int) -> decltype(x1.fields(*this), void())
+{
+	x1.fields(*this);
+}
+
+template<class X>
+void
+collect(const X& x1, long)
+{
+	if constexpr (std::is_empty<X>::value) {
+		return;
+	}
+	else if constexpr (std::is_scalar<X>::value ||
+		std::has_unique_object_representations<X>::value) {
+		bytes(&x1, sizeof(X));
+	}
+	else {
+		_opaque = true;
+	}
+}
+
+void
+bytes(const void* x1, size_t size1)
+{
+	if (_opaque) {
+		return;
+	}
+
+	if (_size + size1 > _capacity) {
+		size_t capacity1 = 2 * (_size + size1);
+		char* data1 = (char*) malloc(capacity1);
+		if (!data1) {
+			_opaque = true;
+			return;
+		}
+
+		memcpy(data1, _data, _size);
+		if (_data != _buffer) {
+			free(_data);
+		}
+
+		_data = data1;
+		_capacity = capacity1;
+	}
+
+	memcpy(_data + _size, x1, size1);
+	_size += size1;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[intern_table]] class `intern_table`
+
+Class `intern_table` deduplicates structurally identical actions, so that 
+actions generated many times, e.g. the same `wrap(add, x)` in many branches of 
+an offer, are kept once and shared. Function `intern` looks up an action in a 
+table, and returns an interned action pointing to the copy kept by the table, 
+which is made at the first lookup. Two actions are identical if they have the 
+same type, that is the same tag, and the same <<intern_key>>, that is the same 
+function pointers and bound arguments compared field by field. Composed 
+actions holding `const_queue`s are identical only if they share the same 
+queues, so sub-actions should be interned before they are composed. An action 
+with an opaque key is kept every time it is looked up.
+
+Method `size` returns the number of distinct actions kept, `hits` the number 
+of lookups answered by a kept action, and `bytes` the bytes of kept actions. 
+Kept actions are released with the table, and live on in interned actions 
+still pointing to them.
+
+A table is not thread-safe and is meant to be used while actions are built, 
+but interned actions could be copied and evaluated by many threads.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class intern_table
+{
+intern_slot* _slots;
+size_t _capacity;
+size_t _size;
+size_t _hits;
+size_t _bytes;
+
+public:
+intern_table()
+	: _slots(NULL)
+	, _capacity(0)
+	, _size(0)
+	, _hits(0)
+	, _bytes(0)
+{
+}
+
+~intern_table()
+{
+	for (size_t i = 0; i < _capacity; i++) {
+		if (_slots[i].type) {
+			_slots[i].release(_slots[i].node);
+			free(_slots[i].key);
+		}
+	}
+
+	free(_slots);
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+size_t
+hits() const
+{
+	return _hits;
+}
+
+size_t
+bytes() const
+{
+	return _bytes;
+}
+
+template<class X>
+const_ptr<intern_node<X> >
+find(const X& x1)
+{
+	typedef const_ptr<intern_node<X> > node_ptr;
+	typedef char node_ptr_must_fit_in_slot[sizeof(node_ptr) <=
+		sizeof(_slots->node) ? 1 : -1];
+	(void) sizeof(node_ptr_must_fit_in_slot);
+
+	intern_key key1;
+	key1(x1);
+	if (!key1.comparable()) {
+		return mutable_ptr<intern_node<X> >(
+			new (std::nothrow) intern_node<X>(x1)).build();
+	}
+
+	const void* type1 = &intern_type<X>::id;
+	size_t hash1 = hash(type1, key1.data(), key1.size());
+	if (_capacity) {
+		for (size_t i = hash1 & (_capacity - 1);; i = (i + 1) &
+			(_capacity - 1)) {
+			intern_slot& slot1 = _slots[i];
+			if (!slot1.type) {
+				break;
+			}
+
+			if (slot1.hash == hash1 && slot1.type == type1 &&
+				slot1.key_size == key1.size() &&
+				memcmp(slot1.key, key1.data(), key1.size()) == 0) {
+				_hits++;
+				return *(const node_ptr*) slot1.node;
+			}
+		}
+	}
+
+	node_ptr node2 = mutable_ptr<intern_node<X> >(
+		new (std::nothrow) intern_node<X>(x1)).build();
+	char* key2 = (char*) malloc(key1.size() ? key1.size() : 1);
+	if (!node2.get() || !key2 || !reserve()) {
+		free(key2);
+		return node2;
+	}
+
+	memcpy(key2, key1.data(), key1.size());
+	size_t i = hash1 & (_capacity - 1);
+	while (_slots[i].type) {
+		i = (i + 1) & (_capacity - 1);
+	}
+
+	_slots[i].hash = hash1;
+	_slots[i].type = type1;
+	_slots[i].key = key2;
+	_slots[i].key_size = key1.size();
+	_slots[i].release = intern_node<X>::drop;
+	new (_slots[i].node) node_ptr(node2);
+	_size++;
+	_bytes += sizeof(intern_node<X>);
+
+	return node2;
+}
+
+private:
+intern_table(const intern_table&);
+
+intern_table&
+operator=(const intern_table&);
+
+static size_t
+hash(const void* type1, const void* x1, size_t size1)
+{
+	uint64_t hash1 = 14695981039346656037ULL ^ (uintptr_t) type1;
+	for (size_t i = 0; i < size1; i++) {
+		hash1 = (hash1 ^ ((const unsigned char*) x1)[i]) * 1099511628211ULL;
+	}
+
+	return hash1 ^ hash1 >> 32;
+}
+
+bool
+reserve()
+{
+	if (2 * (_size + 1) <= _capacity) {
+		return true;
+	}
+
+	size_t capacity1 = _capacity ? 2 * _capacity : 64;
+	intern_slot* slots1 = (intern_slot*) calloc(capacity1,
+		sizeof(intern_slot));
+	if (!slots1) {
+		return false;
+	}
+
+	for (size_t i = 0; i < _capacity; i++) {
+		if (!_slots[i].type) {
+			continue;
+		}
+
+		size_t j = _slots[i].hash & (capacity1 - 1);
+		while (slots1[j].type) {
+			j = (j + 1) & (capacity1 - 1);
+		}
+
+		slots1[j] = _slots[i];
+	}
+
+	free(_slots);
+	_slots = slots1;
+	_capacity = capacity1;
+
+	return true;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[same_action]] function `same_action`
+
+Function `same_action` tells if two actions are structurally identical in the 
+same way as an <<intern_table>> does. It returns false if either key is opaque, 
+or memory could not be allocated for the keys.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X>
+bool
+same_action(const X& x1, const X& x2)
+{
+	intern_key key1;
+	intern_key key2;
+	key1(x1);
+	key2(x2);
+
+	return key1.equals(key2);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with interned_action_tag]] action with interned_action_tag
+
+An interned action is a reference counted handle of an action kept by an 
+<<intern_table>>, returned by function `intern`. Copies of an interned action 
+share the same action, so that offers and composed actions built of interned 
+actions keep one pointer for every sub-action instead of a full copy. It is 
+evaluated as the action it points to, through one more indirection. Method 
+`get` returns the action, and `valid` returns false if memory could not be 
+allocated, in which case the action must not be evaluated.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+intern_table table1;
+auto f = intern(&table1, wrap(add, 1.0));
+auto g = intern(&table1, wrap(add, 1.0)); // => shares the action of f
+offer(f, wrap(is_small), 1) | offer(g, wrap(is_large), 2); // => offer action
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG>
+struct interned_action_tag { };
+
+template<class OUT, class IN, class TAG>
+class action<OUT, IN, interned_action_tag<TAG> >
+{
+const_ptr<intern_node<action<OUT, IN, TAG> > > _node;
+
+public:
+explicit
+action(const const_ptr<intern_node<action<OUT, IN, TAG> > >& node1)
+	: _node(node1)
+{
+}
+
+bool
+valid() const
+{
+	return _node.get() != NULL;
+}
+
+const action<OUT, IN, TAG>&
+get() const
+{
+	return _node->value();
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_node);
+}
+
+OUT
+operator()(const IN& in1) const
+{
+	return _node->value()(in1);
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+action<OUT, IN, interned_action_tag<TAG> >
+intern(intern_table* table1, const action<OUT, IN, TAG>& f1)
+{
+	return action<OUT, IN, interned_action_tag<TAG> > (table1->find(f1));
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
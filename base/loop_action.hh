@@ -1,164 +1,319 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or altertantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/loop_action.hh`
-
-This file consists of class template <<loop>> and class template 
-<<action with loop_action_tag>>.
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#ifndef HACTAR_LOOP_ACTION_HH
-#define HACTAR_LOOP_ACTION_HH
-
-#include "action.hh"
-#include "const_queue.hh"
-
-namespace hactar {
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[loop]] class template `loop`
-
-Class template `loop` consists of loop count and loop filter action. Loop count
-is the maximum times a loop could take. Loop filter is an action that returns 
-true if the loop could continue.
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class IN, class TAGF>
-class loop
-{
-unsigned int _count;
-action<bool, IN, TAGF> _filter;
-
-public:
-loop(const int& count1, const action<bool, IN, TAGF>& filter1)
-	: _count(count1)
-	, _filter(filter1)
-{
-}
-
-int
-count() const
-{
-	return _count;
-}
-
-action<bool, IN, TAGF>
-filter() const
-{
-	return _filter;
-}
-
-};
-
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[action with loop_action_tag]] action with loop_action_tag
-
-A loop action is used for looping through actions. A loop action consists of 
-loop count and loop filter action, and could be constructed by an action 
-`IN -> IN` and an `loop` object with `operator*`. An action `IN -> IN` and a 
-loop count value could construct a loop action with `operator*` too.
-
-In each loop iteration, the internal action `IN -> IN` would take the output of 
-last iteration as input.
-
-Below is an example:
-
---------------------------------------------------------------------------------
-double add(const double& x, double y) { return x + y; }
-bool is_small(const double& x) { return x < 100.0; }
-
-wrap(add, 10.0) * loop(10, wrap(is_small)); // => loop action
-wrap(add, 10.0) * 10; // => loop action
---------------------------------------------------------------------------------
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class TAG, class TAGF>
-struct loop_action_tag { };
-
-template<class IN, class TAG, class TAGF>
-class action<IN, IN, loop_action_tag<TAG, TAGF> >
-{
-action<IN, IN, TAG> _f;
-unsigned int _count;
-action<bool, IN, TAGF> _filter;
-
-public:
-action(const action<IN, IN, TAG>& f1,
-	const int& count1, const action<bool, IN, TAGF>& filter1)
-	: _f(f1)
-	, _count(count1)
-	, _filter(filter1)
-{
-}
-
-IN
-operator()(const IN& in1) const
-{
-	IN in = in1;
-	for (unsigned int i = 0; _filter(in) && i < _count; i++) {
-		in = _f(in);
-	}
-
-	return in;
-}
-
-};
-
-template<class IN, class TAG, class TAGF>
-action<IN, IN, loop_action_tag<TAG, TAGF> >
-operator*(const action<IN, IN, TAG>& f1, const loop<IN, TAGF>& loop1)
-{
-	return action<IN, IN, loop_action_tag<TAG, TAGF> > (f1,
-		loop1.count(), loop1.filter());
-}
-
-template<class IN, class TAG, class TAGF>
-action<IN, IN, loop_action_tag<TAG, TAGF> >
-operator*(const loop<IN, TAGF>& loop1, const action<IN, IN, TAG>& f1)
-{
-	return action<IN, IN, loop_action_tag<TAG, TAGF> > (f1,
-		loop1.count(), loop1.filter());
-}
-
-template<class IN, class TAG>
-action<IN, IN, loop_action_tag<TAG, true_action_tag> >
-operator*(const action<IN, IN, TAG>& f1, const unsigned int& count1)
-{
-	return action<IN, IN, loop_action_tag<TAG, true_action_tag> > (f1,
-		count1, action<bool, IN, true_action_tag> ());
-}
-
-template<class IN, class TAG>
-action<IN, IN, loop_action_tag<TAG, true_action_tag> >
-operator*(const unsigned int& count1, const action<IN, IN, TAG>& f1)
-{
-	return action<IN, IN, loop_action_tag<TAG, true_action_tag> > (f1,
-		count1, action<bool, IN, true_action_tag> ());
-}
-
-}
-
-#endif
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or altertantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/loop_action.hh`
+
+This file consists of class template <<loop>>, class template 
+<<action with loop_action_tag>> and <<in-place action with loop_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_LOOP_ACTION_HH
+#define HACTAR_LOOP_ACTION_HH
+
+#include "action.hh"
+#include "const_queue.hh"
+#include "profile_action.hh"
+
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[loop]] class template `loop`
+
+Class template `loop` consists of loop count and loop filter action. Loop count
+is the maximum times a loop could take. Loop filter is an action that returns 
+true if the loop could continue.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class IN, class TAGF>
+class loop
+{
+unsigned int _count;
+action<bool, IN, TAGF> _filter;
+
+public:
+constexpr
+loop(const int& count1, const action<bool, IN, TAGF>& filter1)
+	: _count(count1)
+	, _filter(filter1)
+{
+}
+
+constexpr int
+count() const
+{
+	return _count;
+}
+
+constexpr action<bool, IN, TAGF>
+filter() const
+{
+	return _filter;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with loop_action_tag]] action with loop_action_tag
+
+A loop action is used for looping through actions. A loop action consists of 
+loop count and loop filter action, and could be constructed by an action 
+`IN -> IN` and an `loop` object with `operator*`. An action `IN -> IN` and a 
+loop count value could construct a loop action with `operator*` too.
+
+In each loop iteration, the internal action `IN -> IN` would take the output of 
+last iteration as input. Evaluated directly by a profiled action, a loop action 
+records the number of iterations.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+bool is_small(const double& x) { return x < 100.0; }
+
+wrap(add, 10.0) * loop(10, wrap(is_small)); // => loop action
+wrap(add, 10.0) * 10; // => loop action
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG, class TAGF>
+struct loop_action_tag { };
+
+template<class IN, class TAG, class TAGF>
+class action<IN, IN, loop_action_tag<TAG, TAGF> >
+{
+action<IN, IN, TAG> _f;
+unsigned int _count;
+action<bool, IN, TAGF> _filter;
+
+public:
+constexpr
+action(const action<IN, IN, TAG>& f1,
+	const int& count1, const action<bool, IN, TAGF>& filter1)
+	: _f(f1)
+	, _count(count1)
+	, _filter(filter1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_count);
+	v1(_filter);
+}
+
+constexpr IN
+operator()(const IN& in1) const
+{
+	if constexpr (profile_policy::enabled) {
+		if (!__builtin_is_constant_evaluated()) {
+			return profile(in1);
+		}
+	}
+
+	IN in = in1;
+	for (unsigned int i = 0; _filter(in) && i < _count; i++) {
+		in = _f(in);
+	}
+
+	return in;
+}
+
+private:
+IN
+profile(const IN& in1) const
+{
+	profile_frame<profile_policy> frame1("loop");
+	uint64_t time = frame1.time();
+	IN in = in1;
+	unsigned int i = 0;
+	for (; _filter(in) && i < _count; i++) {
+		in = _f(in);
+		time = frame1.iteration(i, time);
+	}
+
+	frame1.iterations(i);
+
+	return in;
+}
+
+};
+
+template<class IN, class TAG, class TAGF>
+constexpr action<IN, IN, loop_action_tag<TAG, TAGF> >
+operator*(const action<IN, IN, TAG>& f1, const loop<IN, TAGF>& loop1)
+{
+	return action<IN, IN, loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG, class TAGF>
+constexpr action<IN, IN, loop_action_tag<TAG, TAGF> >
+operator*(const loop<IN, TAGF>& loop1, const action<IN, IN, TAG>& f1)
+{
+	return action<IN, IN, loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG>
+constexpr action<IN, IN, loop_action_tag<TAG, true_action_tag> >
+operator*(const action<IN, IN, TAG>& f1, const unsigned int& count1)
+{
+	return action<IN, IN, loop_action_tag<TAG, true_action_tag> > (f1,
+		count1, action<bool, IN, true_action_tag> ());
+}
+
+template<class IN, class TAG>
+constexpr action<IN, IN, loop_action_tag<TAG, true_action_tag> >
+operator*(const unsigned int& count1, const action<IN, IN, TAG>& f1)
+{
+	return action<IN, IN, loop_action_tag<TAG, true_action_tag> > (f1,
+		count1, action<bool, IN, true_action_tag> ());
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[in-place action with loop_action_tag]] in-place action with loop_action_tag
+
+An in-place loop action loops an in-place action `action<void, IN&, TAG>` over 
+the same argument. It is constructed with `operator*` as a loop action, and 
+like in-place complex actions, an rvalue argument is moved in, mutated and 
+returned.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+void blur(image& x);
+
+(wrap(blur) * 10)(img); // => img is blurred 10 times in place
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class IN, class TAG, class TAGF>
+class action<void, IN&, loop_action_tag<TAG, TAGF> >
+{
+action<void, IN&, TAG> _f;
+unsigned int _count;
+action<bool, IN, TAGF> _filter;
+
+public:
+constexpr
+action(const action<void, IN&, TAG>& f1,
+	const int& count1, const action<bool, IN, TAGF>& filter1)
+	: _f(f1)
+	, _count(count1)
+	, _filter(filter1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_count);
+	v1(_filter);
+}
+
+constexpr void
+operator()(IN& in1) const
+{
+	if constexpr (profile_policy::enabled) {
+		if (!__builtin_is_constant_evaluated()) {
+			profile(in1);
+			return;
+		}
+	}
+
+	for (unsigned int i = 0; _filter(in1) && i < _count; i++) {
+		_f(in1);
+	}
+}
+
+constexpr IN
+operator()(IN&& in1) const
+{
+	(*this)(in1);
+
+	return std::move(in1);
+}
+
+private:
+void
+profile(IN& in1) const
+{
+	profile_frame<profile_policy> frame1("loop");
+	uint64_t time = frame1.time();
+	unsigned int i = 0;
+	for (; _filter(in1) && i < _count; i++) {
+		_f(in1);
+		time = frame1.iteration(i, time);
+	}
+
+	frame1.iterations(i);
+}
+
+};
+
+template<class IN, class TAG, class TAGF>
+constexpr action<void, IN&, loop_action_tag<TAG, TAGF> >
+operator*(const action<void, IN&, TAG>& f1, const loop<IN, TAGF>& loop1)
+{
+	return action<void, IN&, loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG, class TAGF>
+constexpr action<void, IN&, loop_action_tag<TAG, TAGF> >
+operator*(const loop<IN, TAGF>& loop1, const action<void, IN&, TAG>& f1)
+{
+	return action<void, IN&, loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG>
+constexpr action<void, IN&, loop_action_tag<TAG, true_action_tag> >
+operator*(const action<void, IN&, TAG>& f1, const unsigned int& count1)
+{
+	return action<void, IN&, loop_action_tag<TAG, true_action_tag> > (f1,
+		count1, action<bool, IN, true_action_tag> ());
+}
+
+template<class IN, class TAG>
+constexpr action<void, IN&, loop_action_tag<TAG, true_action_tag> >
+operator*(const unsigned int& count1, const action<void, IN&, TAG>& f1)
+{
+	return action<void, IN&, loop_action_tag<TAG, true_action_tag> > (f1,
+		count1, action<bool, IN, true_action_tag> ());
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,959 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/profile_action.hh`
+
+This file consists of <<profile_policy>>, class <<profile_registry>>, class 
+template <<profile_frame>> and <<action with profiled_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_PROFILE_ACTION_HH
+#define HACTAR_PROFILE_ACTION_HH
+
+#include "action.hh"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[profile_policy]] `profile_policy`
+
+Type `profile_policy` is the instrumentation policy of all actions, which is 
+`profile_on` if macro `HACTAR_PROFILE` is defined, e.g. by `configure 
+--enable-profile`, or `profile_off` otherwise. The policy must be the same in 
+all translation units of a program.
+
+Complex, offer and loop actions evaluated directly by a profiled action record 
+what they do into its stage with a `profile_frame<profile_policy>`: a complex 
+action records the time of every composed action, an offer action records the 
+branch taken, and a loop action records the number of iterations. Actions 
+nested deeper are only recorded by their own profiled actions, but all of them 
+record spans for inputs sampled into the timeline. With `profile_off`, 
+`profile_frame` is empty and `profiled` returns the action itself, so no code 
+is generated for profiling.
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct profile_off
+{
+static const bool enabled = false;
+};
+
+struct profile_on
+{
+static const bool enabled = true;
+};
+
+#ifdef HACTAR_PROFILE
+typedef profile_on profile_policy;
+#else
+typedef profile_off profile_policy;
+#endif
+
+enum
+{
+	profile_buckets = 16 + 60 * 8,
+	profile_branches = 32,
+	profile_steps = 16
+};
+
+struct profile_counters
+{
+std::atomic<uint64_t> calls;
+std::atomic<uint64_t> sum;
+std::atomic<uint64_t> max;
+std::atomic<uint64_t> iterations;
+std::atomic<uint64_t> histogram[profile_buckets];
+std::atomic<uint64_t> branches[profile_branches];
+std::atomic<uint64_t> step_calls[profile_steps];
+std::atomic<uint64_t> step_sum[profile_steps];
+};
+
+struct profile_totals
+{
+uint64_t calls;
+uint64_t sum;
+uint64_t max;
+uint64_t iterations;
+uint64_t histogram[profile_buckets];
+uint64_t branches[profile_branches];
+uint64_t step_calls[profile_steps];
+uint64_t step_sum[profile_steps];
+};
+
+inline uint64_t
+profile_now()
+{
+	struct timespec time1;
+	clock_gettime(CLOCK_MONOTONIC, &time1);
+
+	return time1.tv_sec * 1000000000ULL + time1.tv_nsec;
+}
+
+inline void
+profile_add(std::atomic<uint64_t>& counter1, uint64_t value1)
+{
+	counter1.store(counter1.load(std::memory_order_relaxed) + value1,
+		std::memory_order_relaxed);
+}
+
+inline void
+profile_json(FILE* out1, const char* string1)
+{
+	fputc('"', out1);
+	for (const unsigned char* c = (const unsigned char*) string1; *c; c++) {
+		if (*c == '"' || *c == '\\') {
+			fprintf(out1, "\\%c", *c);
+		} else if (*c < 0x20) {
+			fprintf(out1, "\\u%04x", *c);
+		} else {
+			fputc(*c, out1);
+		}
+	}
+
+	fputc('"', out1);
+}
+
+struct profile_span
+{
+uint64_t begin;
+uint64_t end;
+const char* name;
+const char* arg_name;
+int64_t arg;
+};
+
+class profile_timeline
+{
+profile_span* _spans;
+std::atomic<unsigned int> _size;
+unsigned int _capacity;
+unsigned int _thread;
+std::atomic<uint64_t> _dropped;
+profile_timeline* _next;
+
+public:
+profile_timeline(unsigned int thread1, profile_timeline* next1)
+	: _spans((profile_span*) malloc(65536 * sizeof(profile_span)))
+	, _size(0)
+	, _capacity(_spans ? 65536 : 0)
+	, _thread(thread1)
+	, _dropped(0)
+	, _next(next1)
+{
+}
+
+void
+add(const char* name1, uint64_t begin1, uint64_t end1,
+	const char* arg_name1, int64_t arg1)
+{
+	unsigned int size1 = _size.load(std::memory_order_relaxed);
+	if (size1 == _capacity) {
+		profile_add(_dropped, 1);
+		return;
+	}
+
+	profile_span& span1 = _spans[size1];
+	span1.begin = begin1;
+	span1.end = end1;
+	span1.name = name1;
+	span1.arg_name = arg_name1;
+	span1.arg = arg1;
+	_size.store(size1 + 1, std::memory_order_release);
+}
+
+private:
+friend class profile_registry;
+
+profile_timeline(const profile_timeline&);
+
+profile_timeline&
+operator=(const profile_timeline&);
+
+};
+
+class profile_thread;
+
+struct profile_context
+{
+profile_counters* current;
+unsigned int depth;
+profile_thread* thread;
+unsigned int level;
+bool sampled;
+uint64_t inputs;
+profile_timeline* timeline;
+};
+
+inline thread_local profile_context profile_current;
+
+inline unsigned int
+profile_bucket(uint64_t value1)
+{
+	if (value1 < 16) {
+		return value1;
+	}
+
+	unsigned int exponent = 63 - __builtin_clzll(value1);
+
+	return 16 + (exponent - 4) * 8 + ((value1 >> (exponent - 3)) & 7);
+}
+
+inline uint64_t
+profile_value(unsigned int bucket1)
+{
+	if (bucket1 < 16) {
+		return bucket1;
+	}
+
+	unsigned int exponent = (bucket1 - 16) / 8 + 4;
+
+	return (8ULL + (bucket1 - 16) % 8) << (exponent - 3);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[profile_registry]] class `profile_registry`
+
+Class `profile_registry` keeps the names of all profiled stages, and the 
+counters of every stage in every thread. Threads record into their own 
+counters without locks, and counters of exited threads are merged into the 
+registry. Method `collect` adds up the counters of a stage in all threads, and 
+method `dump` writes the totals of all stages as text, with the number of 
+calls, the mean, 50th, 90th and 99th percentiles and maximum of latencies in 
+nanoseconds, followed by lines of branches, steps and iterations if recorded. 
+Percentiles are read from a histogram with 8 buckets for every power of 2, so 
+they are accurate to 12.5%.
+
+Method `sample` turns on the timeline of 1 in `sampling1` inputs of the 
+outermost profiled actions in every thread, or turns it off with 0. For a 
+sampled input, every profiled action, complex action, composed step, offer 
+action and loop iteration evaluated records a span with its begin and end time 
+into a buffer of its thread, with the branch taken by an offer or the index of 
+an iteration. Spans are dropped and counted once a buffer of 65536 spans is 
+full. Method `export_timeline` writes all spans as Chrome trace events in JSON, 
+which could be loaded into Perfetto or `chrome://tracing`. Names are escaped as 
+JSON strings.
+
+There is one registry in a program, returned by `instance`.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class profile_registry
+{
+pthread_mutex_t _mutex;
+char** _names;
+profile_totals** _retired;
+unsigned int _size;
+profile_thread* _threads;
+profile_timeline* _timelines;
+unsigned int _timeline_size;
+std::atomic<unsigned int> _sampling;
+
+public:
+static profile_registry&
+instance()
+{
+	static profile_registry registry1;
+
+	return registry1;
+}
+
+unsigned int stage(const char* name1);
+
+const char*
+name(unsigned int stage1)
+{
+	pthread_mutex_lock(&_mutex);
+	const char* name1 = stage1 < _size ? _names[stage1] : "";
+	pthread_mutex_unlock(&_mutex);
+
+	return name1;
+}
+
+unsigned int
+size()
+{
+	pthread_mutex_lock(&_mutex);
+	unsigned int size1 = _size;
+	pthread_mutex_unlock(&_mutex);
+
+	return size1;
+}
+
+bool collect(unsigned int stage1, profile_totals* totals1);
+
+bool dump(FILE* out1);
+
+void
+sample(unsigned int sampling1)
+{
+	_sampling.store(sampling1, std::memory_order_relaxed);
+}
+
+unsigned int
+sampling() const
+{
+	return _sampling.load(std::memory_order_relaxed);
+}
+
+profile_timeline*
+timeline()
+{
+	pthread_mutex_lock(&_mutex);
+	profile_timeline* timeline1 = new (std::nothrow) profile_timeline(
+		_timeline_size + 1, _timelines);
+	if (timeline1) {
+		_timelines = timeline1;
+		_timeline_size++;
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	return timeline1;
+}
+
+bool export_timeline(FILE* out1);
+
+private:
+friend class profile_thread;
+
+profile_registry()
+	: _names(NULL)
+	, _retired(NULL)
+	, _size(0)
+	, _threads(NULL)
+	, _timelines(NULL)
+	, _timeline_size(0)
+	, _sampling(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+profile_registry(const profile_registry&);
+
+profile_registry&
+operator=(const profile_registry&);
+
+static void
+merge(profile_totals* totals1, const profile_counters* counters1)
+{
+	totals1->calls += counters1->calls.load(std::memory_order_relaxed);
+	totals1->sum += counters1->sum.load(std::memory_order_relaxed);
+	uint64_t max1 = counters1->max.load(std::memory_order_relaxed);
+	totals1->max = totals1->max > max1 ? totals1->max : max1;
+	totals1->iterations += counters1->iterations.load(
+		std::memory_order_relaxed);
+	for (unsigned int i = 0; i < profile_buckets; i++) {
+		totals1->histogram[i] += counters1->histogram[i].load(
+			std::memory_order_relaxed);
+	}
+
+	for (unsigned int i = 0; i < profile_branches; i++) {
+		totals1->branches[i] += counters1->branches[i].load(
+			std::memory_order_relaxed);
+	}
+
+	for (unsigned int i = 0; i < profile_steps; i++) {
+		totals1->step_calls[i] += counters1->step_calls[i].load(
+			std::memory_order_relaxed);
+		totals1->step_sum[i] += counters1->step_sum[i].load(
+			std::memory_order_relaxed);
+	}
+}
+
+};
+
+class profile_thread
+{
+profile_counters** _stages;
+unsigned int _size;
+profile_thread* _next;
+
+public:
+profile_thread()
+	: _stages(NULL)
+	, _size(0)
+	, _next(NULL)
+{
+	profile_registry& registry1 = profile_registry::instance();
+	pthread_mutex_lock(&registry1._mutex);
+	_next = registry1._threads;
+	registry1._threads = this;
+	pthread_mutex_unlock(&registry1._mutex);
+}
+
+~profile_thread()
+{
+	profile_registry& registry1 = profile_registry::instance();
+	pthread_mutex_lock(&registry1._mutex);
+	for (profile_thread** thread1 = &registry1._threads; *thread1;
+		thread1 = &(*thread1)->_next) {
+		if (*thread1 == this) {
+			*thread1 = _next;
+			break;
+		}
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		if (_stages[i] && registry1._retired[i]) {
+			profile_registry::merge(registry1._retired[i], _stages[i]);
+		}
+
+		free(_stages[i]);
+	}
+
+	pthread_mutex_unlock(&registry1._mutex);
+	free(_stages);
+	profile_current.thread = NULL;
+}
+
+static profile_counters*
+counters(unsigned int stage1)
+{
+	profile_thread* thread1 = profile_current.thread;
+	if (!thread1) {
+		static thread_local profile_thread thread2;
+		thread1 = &thread2;
+		profile_current.thread = thread1;
+	}
+
+	if (stage1 < thread1->_size && thread1->_stages[stage1]) {
+		return thread1->_stages[stage1];
+	}
+
+	return thread1->add(stage1);
+}
+
+private:
+friend class profile_registry;
+
+profile_thread(const profile_thread&);
+
+profile_thread&
+operator=(const profile_thread&);
+
+profile_counters*
+add(unsigned int stage1)
+{
+	profile_registry& registry1 = profile_registry::instance();
+	profile_counters* counters1 = NULL;
+	pthread_mutex_lock(&registry1._mutex);
+	if (stage1 >= _size) {
+		unsigned int size1 = registry1._size > stage1 ? registry1._size :
+			stage1 + 1;
+		profile_counters** stages1 = (profile_counters**) realloc(_stages,
+			size1 * sizeof(profile_counters*));
+		if (stages1) {
+			memset(stages1 + _size, 0, (size1 - _size) *
+				sizeof(profile_counters*));
+			_stages = stages1;
+			_size = size1;
+		}
+	}
+
+	if (stage1 < _size) {
+		_stages[stage1] = (profile_counters*) calloc(1,
+			sizeof(profile_counters));
+		counters1 = _stages[stage1];
+	}
+
+	pthread_mutex_unlock(&registry1._mutex);
+
+	return counters1;
+}
+
+};
+
+inline unsigned int
+profile_registry::stage(const char* name1)
+{
+	pthread_mutex_lock(&_mutex);
+	unsigned int i = 0;
+	while (i < _size && strcmp(_names[i], name1) != 0) {
+		i++;
+	}
+
+	if (i == _size) {
+		char** names1 = (char**) realloc(_names, (_size + 1) * sizeof(char*));
+		if (names1) {
+			_names = names1;
+		}
+
+		profile_totals** retired1 = (profile_totals**) realloc(_retired,
+			(_size + 1) * sizeof(profile_totals*));
+		if (retired1) {
+			_retired = retired1;
+		}
+
+		char* name2 = names1 && retired1 ? strdup(name1) : NULL;
+		if (name2) {
+			_names[_size] = name2;
+			_retired[_size] = (profile_totals*) calloc(1,
+				sizeof(profile_totals));
+			_size++;
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	return i;
+}
+
+inline bool
+profile_registry::collect(unsigned int stage1, profile_totals* totals1)
+{
+	memset(totals1, 0, sizeof(profile_totals));
+	pthread_mutex_lock(&_mutex);
+	if (stage1 >= _size) {
+		pthread_mutex_unlock(&_mutex);
+		return false;
+	}
+
+	if (_retired[stage1]) {
+		*totals1 = *_retired[stage1];
+	}
+
+	for (profile_thread* thread1 = _threads; thread1;
+		thread1 = thread1->_next) {
+		if (stage1 < thread1->_size && thread1->_stages[stage1]) {
+			merge(totals1, thread1->_stages[stage1]);
+		}
+	}
+
+	pthread_mutex_unlock(&_mutex);
+
+	return true;
+}
+
+inline bool
+profile_registry::dump(FILE* out1)
+{
+	profile_totals* totals1 = (profile_totals*) malloc(sizeof(profile_totals));
+	if (!totals1) {
+		return false;
+	}
+
+	fprintf(out1, "stage\tcalls\tmean\tp50\tp90\tp99\tmax\n");
+	for (unsigned int i = 0; collect(i, totals1); i++) {
+		uint64_t percentiles[3] = { 0, 0, 0 };
+		static const double ranks[3] = { 0.5, 0.9, 0.99 };
+		for (unsigned int j = 0; j < 3; j++) {
+			uint64_t count = 0;
+			for (unsigned int k = 0; k < profile_buckets; k++) {
+				count += totals1->histogram[k];
+				if (count > ranks[j] * totals1->calls) {
+					percentiles[j] = profile_value(k);
+					break;
+				}
+			}
+		}
+
+		pthread_mutex_lock(&_mutex);
+		const char* name1 = _names[i];
+		pthread_mutex_unlock(&_mutex);
+		fprintf(out1, "%s\t%llu\t%.1f\t%llu\t%llu\t%llu\t%llu\n", name1,
+			(unsigned long long) totals1->calls, totals1->calls ?
+			(double) totals1->sum / totals1->calls : 0.0,
+			(unsigned long long) percentiles[0],
+			(unsigned long long) percentiles[1],
+			(unsigned long long) percentiles[2],
+			(unsigned long long) totals1->max);
+		for (unsigned int j = 0; j < profile_branches; j++) {
+			if (totals1->branches[j]) {
+				fprintf(out1, "%s\tbranch\t%u\t%llu\n", name1, j,
+					(unsigned long long) totals1->branches[j]);
+			}
+		}
+
+		for (unsigned int j = 0; j < profile_steps; j++) {
+			if (totals1->step_calls[j]) {
+				fprintf(out1, "%s\tstep\t%u\t%llu\t%.1f\n", name1, j,
+					(unsigned long long) totals1->step_calls[j],
+					(double) totals1->step_sum[j] / totals1->step_calls[j]);
+			}
+		}
+
+		if (totals1->iterations) {
+			fprintf(out1, "%s\titerations\t%llu\n", name1,
+				(unsigned long long) totals1->iterations);
+		}
+	}
+
+	free(totals1);
+
+	return !ferror(out1);
+}
+
+inline bool
+profile_registry::export_timeline(FILE* out1)
+{
+	pthread_mutex_lock(&_mutex);
+	profile_timeline* timelines1 = _timelines;
+	pthread_mutex_unlock(&_mutex);
+
+	bool first = true;
+	uint64_t dropped = 0;
+	fprintf(out1, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+	for (profile_timeline* timeline1 = timelines1; timeline1;
+		timeline1 = timeline1->_next) {
+		unsigned int size1 = timeline1->_size.load(std::memory_order_acquire);
+		dropped += timeline1->_dropped.load(std::memory_order_relaxed);
+		for (unsigned int i = 0; i < size1; i++) {
+			const profile_span& span1 = timeline1->_spans[i];
+			fprintf(out1, "%s\n{\"name\": ", first ? "" : ",");
+			profile_json(out1, span1.name);
+			fprintf(out1, ", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+				"\"pid\": %d, \"tid\": %u", span1.begin / 1000.0,
+				(span1.end - span1.begin) / 1000.0, (int) getpid(),
+				timeline1->_thread);
+			if (span1.arg_name) {
+				fprintf(out1, ", \"args\": {");
+				profile_json(out1, span1.arg_name);
+				fprintf(out1, ": %lld}", (long long) span1.arg);
+			}
+
+			fprintf(out1, "}");
+			first = false;
+		}
+	}
+
+	fprintf(out1, "\n], \"otherData\": {\"dropped\": %llu}}\n",
+		(unsigned long long) dropped);
+
+	return !ferror(out1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[profile_frame]] class template `profile_frame`
+
+Class template `profile_frame` is used by complex, offer and loop actions to 
+record into the stage of the profiled action evaluating them directly, and to 
+record spans of sampled inputs. For counters, a frame is active only for the 
+outermost combinator in a profiled action. With `profile_off`, a frame is 
+empty.
+
+Branches are counted from 0 in the order of offers, and branches from 31 on 
+are counted together. Steps are composed actions of a complex action, and 
+steps from 15 on are counted together.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class POLICY>
+class profile_frame
+{
+public:
+explicit
+profile_frame(const char*)
+{
+}
+
+bool
+active() const
+{
+	return false;
+}
+
+uint64_t
+time() const
+{
+	return 0;
+}
+
+void
+branch(unsigned int) const
+{
+}
+
+void
+iterations(unsigned int) const
+{
+}
+
+uint64_t
+step(unsigned int, uint64_t time1) const
+{
+	return time1;
+}
+
+uint64_t
+iteration(unsigned int, uint64_t time1) const
+{
+	return time1;
+}
+
+};
+
+template<>
+class profile_frame<profile_on>
+{
+profile_counters* _counters;
+const char* _name;
+uint64_t _time;
+const char* _arg_name;
+int64_t _arg;
+
+public:
+explicit
+profile_frame(const char* name1)
+	: _counters(profile_current.depth == 0 ? profile_current.current : NULL)
+	, _name(name1)
+	, _time(profile_current.sampled ? profile_now() : 0)
+	, _arg_name(NULL)
+	, _arg(0)
+{
+	profile_current.depth++;
+}
+
+~profile_frame()
+{
+	profile_current.depth--;
+	if (_time) {
+		profile_current.timeline->add(_name, _time, profile_now(), _arg_name,
+			_arg);
+	}
+}
+
+bool
+active() const
+{
+	return _counters || _time;
+}
+
+uint64_t
+time() const
+{
+	return _time;
+}
+
+void
+branch(unsigned int branch1)
+{
+	if (_counters) {
+		profile_add(_counters->branches[branch1 < profile_branches ? branch1 :
+			profile_branches - 1], 1);
+	}
+
+	_arg_name = "branch";
+	_arg = branch1;
+}
+
+void
+iterations(unsigned int iterations1)
+{
+	if (_counters) {
+		profile_add(_counters->iterations, iterations1);
+	}
+
+	_arg_name = "iterations";
+	_arg = iterations1;
+}
+
+uint64_t
+step(unsigned int step1, uint64_t time1) const
+{
+	uint64_t time2 = profile_now();
+	if (_time) {
+		profile_current.timeline->add("step", time1, time2, "step", step1);
+	}
+
+	if (_counters) {
+		step1 = step1 < profile_steps ? step1 : profile_steps - 1;
+		profile_add(_counters->step_calls[step1], 1);
+		profile_add(_counters->step_sum[step1], time2 - time1);
+	}
+
+	return time2;
+}
+
+uint64_t
+iteration(unsigned int iteration1, uint64_t time1) const
+{
+	if (!_time) {
+		return time1;
+	}
+
+	uint64_t time2 = profile_now();
+	profile_current.timeline->add("iteration", time1, time2, "iteration",
+		iteration1);
+
+	return time2;
+}
+
+private:
+profile_frame(const profile_frame&);
+
+profile_frame&
+operator=(const profile_frame&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with profiled_action_tag]] action with profiled_action_tag
+
+A profiled action records the number of calls and a histogram of latencies of 
+an action into a stage named `name1` in the `profile_registry`, and is 
+constructed by function `profiled`. Profiled actions with the same name share 
+the same stage. A profiled action is the stage of complex, offer and loop 
+actions it evaluates directly, and nested profiled actions record into their 
+own stages.
+
+With `profile_off`, function `profiled` returns the action itself.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+profiled("add", wrap(add, 10.0) & wrap(add, 5.0))(1.0); // => 16.0
+profile_registry::instance().dump(stderr);
+// => add calls and latencies, with the time of both steps
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG>
+struct profiled_action_tag { };
+
+template<class OUT, class IN, class TAG>
+class action<OUT, IN, profiled_action_tag<TAG> >
+{
+action<OUT, IN, TAG> _f;
+unsigned int _stage;
+const char* _name;
+
+public:
+action(const char* name1, const action<OUT, IN, TAG>& f1)
+	: _f(f1)
+	, _stage(profile_registry::instance().stage(name1))
+	, _name(profile_registry::instance().name(_stage))
+{
+}
+
+OUT
+operator()(const IN& in1) const
+{
+	scope scope1(_stage, _name);
+
+	return _f(in1);
+}
+
+private:
+class scope
+{
+profile_counters* _counters;
+profile_counters* _current;
+unsigned int _depth;
+bool _sampled;
+const char* _name;
+uint64_t _time;
+
+public:
+scope(unsigned int stage1, const char* name1)
+	: _counters(profile_thread::counters(stage1))
+	, _current(profile_current.current)
+	, _depth(profile_current.depth)
+	, _sampled(profile_current.sampled)
+	, _name(name1)
+{
+	if (profile_current.level++ == 0) {
+		sample();
+	}
+
+	profile_current.current = _counters;
+	profile_current.depth = 0;
+	_time = profile_now();
+}
+
+~scope()
+{
+	uint64_t time2 = profile_now();
+	uint64_t time1 = time2 - _time;
+	if (profile_current.sampled) {
+		profile_current.timeline->add(_name, _time, time2, NULL, 0);
+	}
+
+	profile_current.current = _current;
+	profile_current.depth = _depth;
+	profile_current.sampled = _sampled;
+	profile_current.level--;
+	if (!_counters) {
+		return;
+	}
+
+	profile_add(_counters->calls, 1);
+	profile_add(_counters->sum, time1);
+	profile_add(_counters->histogram[profile_bucket(time1)], 1);
+	if (time1 > _counters->max.load(std::memory_order_relaxed)) {
+		_counters->max.store(time1, std::memory_order_relaxed);
+	}
+}
+
+private:
+static void
+sample()
+{
+	unsigned int sampling1 = profile_registry::instance().sampling();
+	if (!sampling1 || ++profile_current.inputs % sampling1 != 0) {
+		return;
+	}
+
+	if (!profile_current.timeline) {
+		profile_current.timeline = profile_registry::instance().timeline();
+	}
+
+	profile_current.sampled = profile_current.timeline != NULL;
+}
+
+};
+
+};
+
+template<class OUT, class IN, class TAG>
+typename std::conditional<profile_policy::enabled,
+	action<OUT, IN, profiled_action_tag<TAG> >, action<OUT, IN, TAG> >::type
+profiled(const char* name1, const action<OUT, IN, TAG>& f1)
+{
+	if constexpr (profile_policy::enabled) {
+		return action<OUT, IN, profiled_action_tag<TAG> > (name1, f1);
+	}
+	else {
+		return f1;
+	}
+}
+
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
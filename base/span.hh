@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/span.hh`
+
+This file consists of class template <<span>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_SPAN_HH
+#define HACTAR_SPAN_HH
+
+#include <stdlib.h>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[span]] class template `span`
+
+Class template `span` is a view of values in an array, which is owned 
+elsewhere. It could be used as a collection in place of a `const_queue`, so 
+that values in plain arrays are not copied into a queue.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X>
+class span
+{
+const X* _ptr;
+unsigned int _size;
+
+public:
+span()
+	: _ptr(NULL)
+	, _size(0)
+{
+}
+
+span(const X* ptr1, unsigned int size1)
+	: _ptr(ptr1)
+	, _size(size1)
+{
+}
+
+unsigned int
+size() const
+{
+	return _size;
+}
+
+const X*
+data() const
+{
+	return _ptr;
+}
+
+const X&
+operator[](const unsigned int i) const
+{
+	return _ptr[i];
+}
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
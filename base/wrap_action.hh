@@ -1,349 +1,981 @@
-////////////////////////////////////////////////////////////////////////////////
-/*
-
-Copyright (c) 2014 Sam Yuen
-
-Permission is hereby granted, free of charge, to any person obtaining a copy of
-this software and associated documentation files (the "Software"), to deal in
-the Software without restriction, including without limitation the rights to
-use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
-the Software, and to permit persons to whom the Software is furnished to do so,
-subject to the following conditions:
-
-The above copyright notice and this permission notice shall be included in all
-copies or altertantial portions of the Software.
-
-THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
-IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
-FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
-COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
-IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
-CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
-
-////////////////////////////////////////////////////////////////////////////////
-= `base/wrap_action.hh`
-
-This file consists of various class templates in two categories: 
-<<function wrap actions>> and <<method wrap actions>>.
-////////////////////////////////////////////////////////////////////////////////
-*/
-
-#ifndef HACTAR_BIND_ACTION_HH
-#define HACTAR_BIND_ACTION_HH
-
-#include "action.hh"
-
-namespace hactar {
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[function wrap actions]] function wrap actions
-
-Function wrap actions are wrap actions for functions. A function wrap action 
-wraps a function with an `IN` argument and some other arguments.
-
-Below is an example:
-
---------------------------------------------------------------------------------
-double add(const double& x, double y) { return x + y; }
-
-wrap(add, 10.0)(5.0); // => 15.0
---------------------------------------------------------------------------------
-////////////////////////////////////////////////////////////////////////////////
-*/
-struct wrap_action_tag { };
-
-template<class OUT, class IN>
-class action<OUT, IN, wrap_action_tag>
-{
-typedef OUT (* F)();
-
-F _f;
-
-public:
-action(F f1)
-	: _f(f1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return _f();
-}
-
-};
-
-template<class OUT, class IN>
-action<OUT, IN, wrap_action_tag>
-wrap(OUT (* f1)())
-{
-	return action<OUT, IN, wrap_action_tag> (f1);
-}
-
-struct wrap0_action_tag { };
-
-template<class OUT, class IN>
-class action<OUT, IN, wrap0_action_tag>
-{
-typedef OUT (* F)(const IN&);
-
-F _f;
-
-public:
-action(F f1)
-	: _f(f1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return _f(in1);
-}
-
-};
-
-template<class OUT, class IN>
-action<OUT, IN, wrap0_action_tag>
-wrap(OUT (* f1)(const IN&))
-{
-	return action<OUT, IN, wrap0_action_tag> (f1);
-}
-
-template<class OUT, class IN, class OUTIN>
-action<OUT, IN, wrap0_action_tag>
-operator*(action<OUTIN, IN, wrap0_action_tag> f1, action<OUT, OUTIN,
-		wrap0_action_tag> g1)
-{
-	return action<OUT, IN, wrap0_action_tag> (f1, g1);
-}
-
-template<class A>
-struct wrap1_action_tag { };
-
-template<class OUT, class IN, class A>
-class action<OUT, IN, wrap1_action_tag<A> >
-{
-typedef OUT (* F)(const IN&, A);
-
-F _f;
-A _a;
-
-public:
-action(F f1, A a1)
-	: _f(f1)
-	, _a(a1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return _f(in1, _a);
-}
-
-};
-
-template<class OUT, class IN, class A>
-action<OUT, IN, wrap1_action_tag<A> >
-wrap(OUT (* f1)(const IN&, A), A a1)
-{
-	return action<OUT, IN, wrap1_action_tag<A> > (f1, a1);
-}
-
-template<class A, class B>
-struct wrap2_action_tag { };
-
-template<class OUT, class IN, class A, class B>
-class action<OUT, IN, wrap2_action_tag<A, B> >
-{
-typedef OUT (* F)(const IN&, A, B);
-
-F _f;
-A _a;
-B _b;
-
-public:
-action(F f1, A a1, B b1)
-	: _f(f1)
-	, _a(a1)
-	, _b(b1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return _f(in1, _a, _b);
-}
-
-};
-
-template<class OUT, class IN, class A, class B>
-action<OUT, IN, wrap2_action_tag<A, B> >
-wrap(OUT (* f1)(const IN&, A, B), A a1, B b1)
-{
-	return action<OUT, IN, wrap2_action_tag<A, B> > (f1, a1, b1);
-}
-
-/*
-////////////////////////////////////////////////////////////////////////////////
-== [[method wrap actions]] method wrap actions
-
-Method wrap actions are wrap actions for methods. A method wrap action 
-wraps a method with an `X*` pointer, an `IN` argument and some other arguments.
-
-An example:
---------------------------------------------------------------------------------
-struct utilities {
-	double add(const double& x, double y) { return x + y; }
-};
-
-utilities util;
-
-wrap(&util, &utilities::add, 10.0)(5.0); // => 15.0
---------------------------------------------------------------------------------
-////////////////////////////////////////////////////////////////////////////////
-*/
-template<class X>
-struct wrapm_action_tag { };
-
-template<class X, class OUT, class IN>
-class action<OUT, IN, wrapm_action_tag<X> >
-{
-typedef OUT (X::* F)();
-
-X* _px;
-F _f;
-
-public:
-action(X* px1, F f1)
-	: _px(px1)
-	, _f(f1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return (_px->*_f)();
-}
-
-};
-
-template<class X, class OUT, class IN>
-action<OUT, IN, wrapm_action_tag<X> >
-wrap(X* px1, OUT (X::* f1)())
-{
-	return action<OUT, IN, wrapm_action_tag<X> > (px1, f1);
-}
-
-template<class X>
-struct wrapm0_action_tag { };
-
-template<class X, class OUT, class IN>
-class action<OUT, IN, wrapm0_action_tag<X> >
-{
-typedef OUT (X::* F)(const IN&);
-
-X* _px;
-F _f;
-
-public:
-action(X* px1, F f1)
-	: _px(px1)
-	, _f(f1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return (_px->*_f)(in1);
-}
-
-};
-
-template<class X, class OUT, class IN>
-action<OUT, IN, wrapm0_action_tag<X> >
-wrap(X* px1, OUT (X::* f1)(const IN&))
-{
-	return action<OUT, IN, wrapm0_action_tag<X> > (px1, f1);
-}
-
-template<class X, class A>
-struct wrapm1_action_tag { };
-
-template<class X, class OUT, class IN, class A>
-class action<OUT, IN, wrapm1_action_tag<X, A> >
-{
-typedef OUT (X::* F)(const IN&, A);
-
-X* _px;
-F _f;
-A _a;
-
-public:
-action(X* px1, F f1, A a1)
-	: _px(px1)
-	, _f(f1)
-	, _a(a1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return (_px->*_f)(in1, _a);
-}
-
-};
-
-template<class X, class OUT, class IN, class A>
-action<OUT, IN, wrapm1_action_tag<X, A> >
-wrap(X* px1, OUT (X::* f1)(const IN&, A), A a1)
-{
-	return action<OUT, IN, wrapm1_action_tag<X, A> > (px1, f1, a1);
-}
-
-template<class X, class A, class B>
-struct wrapm2_action_tag { };
-
-template<class X, class OUT, class IN, class A, class B>
-class action<OUT, IN, wrapm2_action_tag<X, A, B> >
-{
-typedef OUT (X::* F)(const IN&, A, B);
-
-X* _px;
-F _f;
-A _a;
-B _b;
-
-public:
-action(X* px1, F f1, A a1, B b1)
-	: _px(px1)
-	, _f(f1)
-	, _a(a1)
-	, _b(b1)
-{
-}
-
-OUT
-operator()(const IN& in1) const
-{
-	return (_px->*_f)(in1, _a, _b);
-}
-
-};
-
-template<class X, class OUT, class IN, class A, class B>
-action<OUT, IN, wrapm2_action_tag<X, A, B> >
-wrap(X* px1, OUT (X::* f1)(const IN&, A, B), A a1, B b1)
-{
-	return action<OUT, IN, wrapm2_action_tag<X, A, B> > (px1, f1, a1, b1);
-}
-
-}
-
-#endif
-////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or altertantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `base/wrap_action.hh`
+
+This file consists of various class templates in six categories: 
+<<function wrap actions>>, <<in-place wrap actions>>, <<variadic wrap actions>>, 
+<<static wrap actions>>, <<functor wrap actions>> and <<method wrap actions>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_BIND_ACTION_HH
+#define HACTAR_BIND_ACTION_HH
+
+#include "action.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+
+#include <atomic>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[function wrap actions]] function wrap actions
+
+Function wrap actions are wrap actions for functions. A function wrap action 
+wraps a function with an `IN` argument and some other arguments.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+wrap(add, 10.0)(5.0); // => 15.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct wrap_action_tag { };
+
+template<class OUT, class IN>
+class action<OUT, IN, wrap_action_tag>
+{
+typedef OUT (* F)();
+
+F _f;
+
+public:
+constexpr
+action(F f1)
+	: _f(f1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return _f();
+}
+
+};
+
+template<class OUT, class IN>
+constexpr action<OUT, IN, wrap_action_tag>
+wrap(OUT (* f1)())
+{
+	return action<OUT, IN, wrap_action_tag> (f1);
+}
+
+struct wrap0_action_tag { };
+
+template<class OUT, class IN>
+class action<OUT, IN, wrap0_action_tag>
+{
+typedef OUT (* F)(const IN&);
+
+F _f;
+
+public:
+constexpr
+action(F f1)
+	: _f(f1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return _f(in1);
+}
+
+};
+
+template<class OUT, class IN>
+constexpr action<OUT, IN, wrap0_action_tag>
+wrap(OUT (* f1)(const IN&))
+{
+	return action<OUT, IN, wrap0_action_tag> (f1);
+}
+
+template<class OUT, class IN, class OUTIN>
+action<OUT, IN, wrap0_action_tag>
+operator*(action<OUTIN, IN, wrap0_action_tag> f1, action<OUT, OUTIN,
+		wrap0_action_tag> g1)
+{
+	return action<OUT, IN, wrap0_action_tag> (f1, g1);
+}
+
+template<class A>
+struct wrap1_action_tag { };
+
+template<class OUT, class IN, class A>
+class action<OUT, IN, wrap1_action_tag<A> >
+{
+typedef OUT (* F)(const IN&, A);
+
+F _f;
+A _a;
+
+public:
+constexpr
+action(F f1, A a1)
+	: _f(f1)
+	, _a(a1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_a);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return _f(in1, _a);
+}
+
+};
+
+template<class OUT, class IN, class A>
+constexpr action<OUT, IN, wrap1_action_tag<A> >
+wrap(OUT (* f1)(const IN&, A), A a1)
+{
+	return action<OUT, IN, wrap1_action_tag<A> > (f1, a1);
+}
+
+template<class A, class B>
+struct wrap2_action_tag { };
+
+template<class OUT, class IN, class A, class B>
+class action<OUT, IN, wrap2_action_tag<A, B> >
+{
+typedef OUT (* F)(const IN&, A, B);
+
+F _f;
+A _a;
+B _b;
+
+public:
+constexpr
+action(F f1, A a1, B b1)
+	: _f(f1)
+	, _a(a1)
+	, _b(b1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_a);
+	v1(_b);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return _f(in1, _a, _b);
+}
+
+};
+
+template<class OUT, class IN, class A, class B>
+constexpr action<OUT, IN, wrap2_action_tag<A, B> >
+wrap(OUT (* f1)(const IN&, A, B), A a1, B b1)
+{
+	return action<OUT, IN, wrap2_action_tag<A, B> > (f1, a1, b1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[in-place wrap actions]] in-place wrap actions
+
+In-place wrap actions wrap a function mutating its `IN&` argument instead of 
+returning a new value. They are actions of type `action<void, IN&, TAG>`, 
+sharing the function wrap action classes with reference type `IN&`.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+void scale(image& x, double y);
+
+wrap(scale, 2.0)(img); // => img is scaled in place
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class IN>
+constexpr action<void, IN&, wrap0_action_tag>
+wrap(void (* f1)(IN&))
+{
+	return action<void, IN&, wrap0_action_tag> (f1);
+}
+
+template<class IN, class A>
+constexpr action<void, IN&, wrap1_action_tag<A> >
+wrap(void (* f1)(IN&, A), A a1)
+{
+	return action<void, IN&, wrap1_action_tag<A> > (f1, a1);
+}
+
+template<class IN, class A, class B>
+constexpr action<void, IN&, wrap2_action_tag<A, B> >
+wrap(void (* f1)(IN&, A, B), A a1, B b1)
+{
+	return action<void, IN&, wrap2_action_tag<A, B> > (f1, a1, b1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[variadic wrap actions]] variadic wrap actions
+
+Variadic wrap actions wrap a function with an `IN` argument and any number of 
+other arguments taken by const reference. Bound arguments are moved into a 
+tuple when the action is created, and passed by const reference to the 
+function on each call, so large arguments like lookup tables are never copied 
+by calls.
+
+Function `wrap_shared` keeps the bound arguments in a reference counted 
+`const_ptr` instead, so that copying the action is O(1) and all copies share 
+the same arguments. Its method `valid` returns false if memory could not be 
+allocated for the arguments, in which case the action must not be evaluated.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double lookup(const double& x, const std::vector<double>& table, const int& n);
+
+wrap(lookup, std::move(table), 8); // => variadic wrap action
+wrap_shared(lookup, std::move(table), 8); // => wrap action sharing arguments
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class... A>
+struct wrapn_action_tag { };
+
+template<class OUT, class IN, class... A>
+class action<OUT, IN, wrapn_action_tag<A...> >
+{
+typedef OUT (* F)(const IN&, const A&...);
+
+F _f;
+std::tuple<A...> _args;
+
+public:
+template<class... X>
+constexpr
+action(F f1, X&&... x1)
+	: _f(f1)
+	, _args(std::forward<X>(x1)...)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_args);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return call(in1, std::index_sequence_for<A...>());
+}
+
+private:
+template<size_t... I>
+constexpr OUT
+call(const IN& in1, std::index_sequence<I...>) const
+{
+	return _f(in1, std::get<I>(_args)...);
+}
+
+};
+
+template<class OUT, class IN, class... A, class... X>
+constexpr action<OUT, IN, wrapn_action_tag<A...> >
+wrap(OUT (* f1)(const IN&, const A&...), X&&... x1)
+{
+	return action<OUT, IN, wrapn_action_tag<A...> > (f1,
+		std::forward<X>(x1)...);
+}
+
+template<class IN, class... A, class... X>
+constexpr action<void, IN&, wrapn_action_tag<A...> >
+wrap(void (* f1)(IN&, const A&...), X&&... x1)
+{
+	return action<void, IN&, wrapn_action_tag<A...> > (f1,
+		std::forward<X>(x1)...);
+}
+
+template<class... A>
+class wrapn_args
+{
+std::atomic<size_t> _rc;
+std::tuple<A...> _args;
+
+public:
+template<class... X>
+wrapn_args(X&&... x1)
+	: _rc(0)
+	, _args(std::forward<X>(x1)...)
+{
+}
+
+bool
+retain()
+{
+	return _rc.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+const std::tuple<A...>&
+args() const
+{
+	return _args;
+}
+
+};
+
+template<class... A>
+struct wrapsn_action_tag { };
+
+template<class OUT, class IN, class... A>
+class action<OUT, IN, wrapsn_action_tag<A...> >
+{
+typedef OUT (* F)(const IN&, const A&...);
+
+F _f;
+const_ptr<wrapn_args<A...> > _args;
+
+public:
+action(F f1, const const_ptr<wrapn_args<A...> >& args1)
+	: _f(f1)
+	, _args(args1)
+{
+}
+
+bool
+valid() const
+{
+	return _args.get() != NULL;
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_f);
+	v1(_args);
+}
+
+OUT
+operator()(const IN& in1) const
+{
+	return call(in1, std::index_sequence_for<A...>());
+}
+
+private:
+template<size_t... I>
+OUT
+call(const IN& in1, std::index_sequence<I...>) const
+{
+	return _f(in1, std::get<I>(_args->args())...);
+}
+
+};
+
+template<class OUT, class IN, class... A, class... X>
+action<OUT, IN, wrapsn_action_tag<A...> >
+wrap_shared(OUT (* f1)(const IN&, const A&...), X&&... x1)
+{
+	mutable_ptr<wrapn_args<A...> > args(new (std::nothrow) wrapn_args<A...>(
+			std::forward<X>(x1)...));
+
+	return action<OUT, IN, wrapsn_action_tag<A...> > (f1, args.build());
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[static wrap actions]] static wrap actions
+
+Static wrap actions are function wrap actions taking the function as a template 
+non-type argument instead of storing a function pointer. Calls are resolved at 
+compile time, so the function could be inlined into composed actions, and only 
+the bound arguments take storage. Types of the `IN` argument and the bound 
+arguments come from the signature of the function. A function taking `IN&` 
+makes an in-place action as in <<in-place wrap actions>>.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+wrap<&add>(10.0)(5.0); // => 15.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<auto F>
+struct wrapt_action_tag { };
+
+template<class OUT, class IN, OUT (* F)(const IN&)>
+class action<OUT, IN, wrapt_action_tag<F> >
+{
+public:
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return F(in1);
+}
+
+};
+
+template<class OUT, class IN, class A, OUT (* F)(const IN&, A)>
+class action<OUT, IN, wrapt_action_tag<F> >
+{
+A _a;
+
+public:
+constexpr
+action(A a1)
+	: _a(a1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_a);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return F(in1, _a);
+}
+
+};
+
+template<class OUT, class IN, class A, class B, OUT (* F)(const IN&, A, B)>
+class action<OUT, IN, wrapt_action_tag<F> >
+{
+A _a;
+B _b;
+
+public:
+constexpr
+action(A a1, B b1)
+	: _a(a1)
+	, _b(b1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_a);
+	v1(_b);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return F(in1, _a, _b);
+}
+
+};
+
+template<auto F, class G = decltype(F)>
+struct wrapt { };
+
+template<auto F, class OUT, class IN>
+struct wrapt<F, OUT (*)(const IN&)>
+{
+typedef action<OUT, IN, wrapt_action_tag<F> > type0;
+};
+
+template<auto F, class OUT, class IN, class A>
+struct wrapt<F, OUT (*)(const IN&, A)>
+{
+typedef action<OUT, IN, wrapt_action_tag<F> > type1;
+typedef A a_type;
+};
+
+template<auto F, class OUT, class IN, class A, class B>
+struct wrapt<F, OUT (*)(const IN&, A, B)>
+{
+typedef action<OUT, IN, wrapt_action_tag<F> > type2;
+typedef A a_type;
+typedef B b_type;
+};
+
+template<auto F, class IN>
+struct wrapt<F, void (*)(IN&)>
+{
+typedef action<void, IN&, wrapt_action_tag<F> > type0;
+};
+
+template<auto F, class IN>
+struct wrapt<F, void (*)(const IN&)>
+{
+typedef action<void, IN, wrapt_action_tag<F> > type0;
+};
+
+template<auto F, class IN, class A>
+struct wrapt<F, void (*)(IN&, A)>
+{
+typedef action<void, IN&, wrapt_action_tag<F> > type1;
+typedef A a_type;
+};
+
+template<auto F, class IN, class A>
+struct wrapt<F, void (*)(const IN&, A)>
+{
+typedef action<void, IN, wrapt_action_tag<F> > type1;
+typedef A a_type;
+};
+
+template<auto F, class IN, class A, class B>
+struct wrapt<F, void (*)(IN&, A, B)>
+{
+typedef action<void, IN&, wrapt_action_tag<F> > type2;
+typedef A a_type;
+typedef B b_type;
+};
+
+template<auto F, class IN, class A, class B>
+struct wrapt<F, void (*)(const IN&, A, B)>
+{
+typedef action<void, IN, wrapt_action_tag<F> > type2;
+typedef A a_type;
+typedef B b_type;
+};
+
+template<auto F>
+constexpr typename wrapt<F>::type0
+wrap()
+{
+	return typename wrapt<F>::type0 ();
+}
+
+template<auto F>
+constexpr typename wrapt<F>::type1
+wrap(typename wrapt<F>::a_type a1)
+{
+	return typename wrapt<F>::type1 (a1);
+}
+
+template<auto F>
+constexpr typename wrapt<F>::type2
+wrap(typename wrapt<F>::a_type a1, typename wrapt<F>::b_type b1)
+{
+	return typename wrapt<F>::type2 (a1, b1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[functor wrap actions]] functor wrap actions
+
+Functor wrap actions wrap any callable object, e.g. a lambda with captures, 
+that could be called with a `const IN&` argument. The callable object is 
+stored by value and called statically. Empty callable objects take no storage 
+since they are stored as a base class.
+
+`OUT` is the type returned by the callable object, so only `IN` needs to be 
+specified. With `IN&` specified, a callable object returning `void` makes an 
+in-place action.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double y = 10.0;
+
+wrap<double>([y](const double& x) { return x + y; })(5.0); // => 15.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class G, bool = std::is_empty<G>::value && !std::is_final<G>::value>
+class wrapf_storage
+	: private G
+{
+public:
+constexpr
+wrapf_storage(const G& g1)
+	: G(g1)
+{
+}
+
+constexpr const G&
+callable() const
+{
+	return *this;
+}
+
+};
+
+template<class G>
+class wrapf_storage<G, false>
+{
+G _g;
+
+public:
+constexpr
+wrapf_storage(const G& g1)
+	: _g(g1)
+{
+}
+
+constexpr const G&
+callable() const
+{
+	return _g;
+}
+
+};
+
+template<class G>
+struct wrapf_action_tag { };
+
+template<class OUT, class IN, class G>
+class action<OUT, IN, wrapf_action_tag<G> >
+	: private wrapf_storage<G>
+{
+public:
+constexpr
+action(const G& g1)
+	: wrapf_storage<G>(g1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(this->callable());
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return this->callable()(in1);
+}
+
+};
+
+template<class IN, class G>
+constexpr action<decltype(std::declval<const G&>()(
+		std::declval<const IN&>())), IN, wrapf_action_tag<G> >
+wrap(const G& g1)
+{
+	return action<decltype(std::declval<const G&>()(
+			std::declval<const IN&>())), IN, wrapf_action_tag<G> > (g1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[method wrap actions]] method wrap actions
+
+Method wrap actions are wrap actions for methods. A method wrap action 
+wraps a method with an `X*` pointer, an `IN` argument and some other arguments.
+Like <<variadic wrap actions>>, methods taking other arguments by const 
+reference could be wrapped with any number of bound arguments.
+
+An example:
+--------------------------------------------------------------------------------
+struct utilities {
+	double add(const double& x, double y) { return x + y; }
+};
+
+utilities util;
+
+wrap(&util, &utilities::add, 10.0)(5.0); // => 15.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X>
+struct wrapm_action_tag { };
+
+template<class X, class OUT, class IN>
+class action<OUT, IN, wrapm_action_tag<X> >
+{
+typedef OUT (X::* F)();
+
+X* _px;
+F _f;
+
+public:
+constexpr
+action(X* px1, F f1)
+	: _px(px1)
+	, _f(f1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_px);
+	v1(_f);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return (_px->*_f)();
+}
+
+};
+
+template<class X, class OUT, class IN>
+constexpr action<OUT, IN, wrapm_action_tag<X> >
+wrap(X* px1, OUT (X::* f1)())
+{
+	return action<OUT, IN, wrapm_action_tag<X> > (px1, f1);
+}
+
+template<class X>
+struct wrapm0_action_tag { };
+
+template<class X, class OUT, class IN>
+class action<OUT, IN, wrapm0_action_tag<X> >
+{
+typedef OUT (X::* F)(const IN&);
+
+X* _px;
+F _f;
+
+public:
+constexpr
+action(X* px1, F f1)
+	: _px(px1)
+	, _f(f1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_px);
+	v1(_f);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return (_px->*_f)(in1);
+}
+
+};
+
+template<class X, class OUT, class IN>
+constexpr action<OUT, IN, wrapm0_action_tag<X> >
+wrap(X* px1, OUT (X::* f1)(const IN&))
+{
+	return action<OUT, IN, wrapm0_action_tag<X> > (px1, f1);
+}
+
+template<class X, class A>
+struct wrapm1_action_tag { };
+
+template<class X, class OUT, class IN, class A>
+class action<OUT, IN, wrapm1_action_tag<X, A> >
+{
+typedef OUT (X::* F)(const IN&, A);
+
+X* _px;
+F _f;
+A _a;
+
+public:
+constexpr
+action(X* px1, F f1, A a1)
+	: _px(px1)
+	, _f(f1)
+	, _a(a1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_px);
+	v1(_f);
+	v1(_a);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return (_px->*_f)(in1, _a);
+}
+
+};
+
+template<class X, class OUT, class IN, class A>
+constexpr action<OUT, IN, wrapm1_action_tag<X, A> >
+wrap(X* px1, OUT (X::* f1)(const IN&, A), A a1)
+{
+	return action<OUT, IN, wrapm1_action_tag<X, A> > (px1, f1, a1);
+}
+
+template<class X, class A, class B>
+struct wrapm2_action_tag { };
+
+template<class X, class OUT, class IN, class A, class B>
+class action<OUT, IN, wrapm2_action_tag<X, A, B> >
+{
+typedef OUT (X::* F)(const IN&, A, B);
+
+X* _px;
+F _f;
+A _a;
+B _b;
+
+public:
+constexpr
+action(X* px1, F f1, A a1, B b1)
+	: _px(px1)
+	, _f(f1)
+	, _a(a1)
+	, _b(b1)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_px);
+	v1(_f);
+	v1(_a);
+	v1(_b);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return (_px->*_f)(in1, _a, _b);
+}
+
+};
+
+template<class X, class OUT, class IN, class A, class B>
+constexpr action<OUT, IN, wrapm2_action_tag<X, A, B> >
+wrap(X* px1, OUT (X::* f1)(const IN&, A, B), A a1, B b1)
+{
+	return action<OUT, IN, wrapm2_action_tag<X, A, B> > (px1, f1, a1, b1);
+}
+
+template<class X, class... A>
+struct wrapmn_action_tag { };
+
+template<class X, class OUT, class IN, class... A>
+class action<OUT, IN, wrapmn_action_tag<X, A...> >
+{
+typedef OUT (X::* F)(const IN&, const A&...);
+
+X* _px;
+F _f;
+std::tuple<A...> _args;
+
+public:
+template<class... Y>
+constexpr
+action(X* px1, F f1, Y&&... y1)
+	: _px(px1)
+	, _f(f1)
+	, _args(std::forward<Y>(y1)...)
+{
+}
+
+template<class V>
+void
+fields(V& v1) const
+{
+	v1(_px);
+	v1(_f);
+	v1(_args);
+}
+
+constexpr OUT
+operator()(const IN& in1) const
+{
+	return call(in1, std::index_sequence_for<A...>());
+}
+
+private:
+template<size_t... I>
+constexpr OUT
+call(const IN& in1, std::index_sequence<I...>) const
+{
+	return (_px->*_f)(in1, std::get<I>(_args)...);
+}
+
+};
+
+template<class X, class OUT, class IN, class... A, class... Y>
+constexpr action<OUT, IN, wrapmn_action_tag<X, A...> >
+wrap(X* px1, OUT (X::* f1)(const IN&, const A&...), Y&&... y1)
+{
+	return action<OUT, IN, wrapmn_action_tag<X, A...> > (px1, f1,
+		std::forward<Y>(y1)...);
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,215 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `bench/bench.cc`
+
+This file consists of the implementation of class <<bench_suite>> and function 
+<<bench_compare>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "bench.hh"
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+namespace hactar {
+
+bench_suite::bench_suite(unsigned int warmup1, unsigned int repetitions1,
+	uint64_t iterations1, const char* filter1)
+	: _warmup(warmup1)
+	, _repetitions(repetitions1 ? repetitions1 : 1)
+	, _iterations(iterations1)
+	, _filter(filter1)
+	, _results(NULL)
+	, _size(0)
+	, _capacity(0)
+	, _samples((double*) malloc(2 * _repetitions * sizeof(double)))
+{
+}
+
+bench_suite::~bench_suite()
+{
+	free(_results);
+	free(_samples);
+}
+
+bench_result*
+bench_suite::add(const char* name1)
+{
+	if (!_samples) {
+		return NULL;
+	}
+
+	if (_size == _capacity) {
+		size_t capacity1 = _capacity ? _capacity * 2 : 64;
+		bench_result* results1 = (bench_result*) realloc(_results,
+			capacity1 * sizeof(bench_result));
+		if (!results1) {
+			return NULL;
+		}
+
+		_results = results1;
+		_capacity = capacity1;
+	}
+
+	bench_result* result1 = &_results[_size++];
+	memset(result1, 0, sizeof(bench_result));
+	strncpy(result1->name, name1, sizeof(result1->name) - 1);
+
+	return result1;
+}
+
+void
+bench_suite::summarize(double* samples1, double* median1, double* min1) const
+{
+	std::sort(samples1, samples1 + _repetitions);
+	*median1 = samples1[_repetitions / 2];
+	*min1 = samples1[0];
+}
+
+bool
+bench_suite::write(FILE* out1) const
+{
+	fprintf(out1, "{\n\t\"warmup\": %u,\n\t\"repetitions\": %u,\n"
+		"\t\"benchmarks\": [", _warmup, _repetitions);
+	for (size_t i = 0; i < _size; i++) {
+		const bench_result& result1 = _results[i];
+		fprintf(out1, "%s\n\t\t{\"name\": \"%s\", \"iterations\": %llu, "
+			"\"ns\": %.3f, \"min\": %.3f, \"baseline_ns\": %.3f, "
+			"\"baseline_min\": %.3f, \"overhead_ns\": %.3f}", i ? "," : "",
+			result1.name, (unsigned long long) result1.iterations, result1.ns,
+			result1.min, result1.baseline, result1.baseline_min,
+			result1.ns - result1.baseline);
+	}
+
+	fprintf(out1, "\n\t]\n}\n");
+
+	return !ferror(out1);
+}
+
+struct bench_entry
+{
+char name[64];
+double ns;
+};
+
+static bench_entry*
+bench_read(FILE* in1, size_t* size1)
+{
+	char* text = NULL;
+	size_t length = 0;
+	size_t capacity = 0;
+	while (true) {
+		if (length + 4096 + 1 > capacity) {
+			capacity = capacity ? capacity * 2 : 65536;
+			char* text1 = (char*) realloc(text, capacity);
+			if (!text1) {
+				free(text);
+				return NULL;
+			}
+
+			text = text1;
+		}
+
+		size_t count = fread(text + length, 1, 4096, in1);
+		length += count;
+		if (count < 4096) {
+			break;
+		}
+	}
+
+	text[length] = '\0';
+
+	bench_entry* entries = NULL;
+	size_t size = 0;
+	const char* key = "\"name\": \"";
+	for (char* p = strstr(text, key); p; p = strstr(p, key)) {
+		p += strlen(key);
+		char* end = strchr(p, '"');
+		char* ns = strstr(p, "\"ns\": ");
+		if (!end || !ns) {
+			break;
+		}
+
+		bench_entry* entries1 = (bench_entry*) realloc(entries,
+			(size + 1) * sizeof(bench_entry));
+		if (!entries1) {
+			break;
+		}
+
+		entries = entries1;
+		size_t length1 = end - p < 63 ? end - p : 63;
+		memcpy(entries[size].name, p, length1);
+		entries[size].name[length1] = '\0';
+		entries[size].ns = strtod(ns + strlen("\"ns\": "), NULL);
+		size++;
+	}
+
+	free(text);
+	*size1 = size;
+
+	return entries ? entries : (bench_entry*) calloc(1, sizeof(bench_entry));
+}
+
+int
+bench_compare(FILE* old1, FILE* new1, double threshold1, FILE* out1)
+{
+	size_t old_size = 0;
+	size_t new_size = 0;
+	bench_entry* old_entries = bench_read(old1, &old_size);
+	bench_entry* new_entries = bench_read(new1, &new_size);
+	if (!old_entries || !new_entries) {
+		free(old_entries);
+		free(new_entries);
+		return -1;
+	}
+
+	int result = 0;
+	for (size_t i = 0; i < new_size; i++) {
+		for (size_t j = 0; j < old_size; j++) {
+			if (strcmp(new_entries[i].name, old_entries[j].name) != 0) {
+				continue;
+			}
+
+			double change = old_entries[j].ns > 0 ? new_entries[i].ns /
+				old_entries[j].ns - 1.0 : 0.0;
+			bool regressed = change > threshold1;
+			fprintf(out1, "%-40s %10.2f ns %10.2f ns %+7.1f%%%s\n",
+				new_entries[i].name, old_entries[j].ns, new_entries[i].ns,
+				change * 100.0, regressed ? "  REGRESSION" : "");
+			result += regressed;
+			break;
+		}
+	}
+
+	free(old_entries);
+	free(new_entries);
+
+	return result;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
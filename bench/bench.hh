@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `bench/bench.hh`
+
+This file consists of class <<bench_suite>> and function <<bench_compare>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_BENCH_HH
+#define HACTAR_BENCH_HH
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[bench_suite]] class `bench_suite`
+
+Class `bench_suite` measures the time of a benchmark and of its hand-written 
+baseline in nanoseconds per call. Method `run` calls `f1(i)` and `baseline1(i)` 
+for `i` from 0 to the number of iterations, which is the default of the suite 
+times `scale1`, in every repetition. The first `warmup1` repetitions are not 
+measured, and repetitions of a benchmark and its baseline alternate, so that 
+both run in the same state of caches and clocks. The median and the minimum of 
+all repetitions are recorded, and benchmarks not containing `filter1` in their 
+names are skipped. Method `selected` tells if a benchmark is not skipped, to 
+skip its setup as well.
+
+Results of callables are passed to `bench_keep`, and inputs could be hidden 
+from the compiler by `bench_hide`, so that calls are neither removed nor folded 
+into constants.
+
+Method `write` writes all results as a JSON document.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+bench_suite suite1(1, 5, 1000000, NULL);
+suite1.run("wrap", [](uint64_t i) { return wrap(add, 1.0)(i); },
+	[](uint64_t i) { return add(i, 1.0); });
+suite1.write(stdout);
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct bench_result
+{
+char name[64];
+double ns;
+double min;
+double baseline;
+double baseline_min;
+uint64_t iterations;
+};
+
+template<class X>
+inline void
+bench_keep(const X& x1)
+{
+	asm volatile ("" : : "r" (&x1) : "memory");
+}
+
+template<class X>
+inline X
+bench_hide(X x1)
+{
+	asm volatile ("" : "+m" (x1));
+
+	return x1;
+}
+
+class bench_suite
+{
+unsigned int _warmup;
+unsigned int _repetitions;
+uint64_t _iterations;
+const char* _filter;
+bench_result* _results;
+size_t _size;
+size_t _capacity;
+double* _samples;
+
+public:
+bench_suite(unsigned int warmup1, unsigned int repetitions1,
+	uint64_t iterations1, const char* filter1);
+
+~bench_suite();
+
+size_t
+size() const
+{
+	return _size;
+}
+
+const bench_result&
+operator[](size_t i) const
+{
+	return _results[i];
+}
+
+bool
+selected(const char* name1) const
+{
+	return !_filter || strstr(name1, _filter);
+}
+
+template<class F, class B>
+void
+run(const char* name1, const F& f1, const B& baseline1, double scale1 = 1.0)
+{
+	if (!selected(name1)) {
+		return;
+	}
+
+	bench_result* result1 = add(name1);
+	if (!result1) {
+		return;
+	}
+
+	uint64_t iterations1 = (uint64_t) (_iterations * scale1);
+	if (iterations1 == 0) {
+		iterations1 = 1;
+	}
+
+	double* fsamples = _samples;
+	double* bsamples = _samples + _repetitions;
+	for (unsigned int i = 0; i < _warmup + _repetitions; i++) {
+		double fns = measure(f1, iterations1);
+		double bns = measure(baseline1, iterations1);
+		if (i >= _warmup) {
+			fsamples[i - _warmup] = fns;
+			bsamples[i - _warmup] = bns;
+		}
+	}
+
+	result1->iterations = iterations1;
+	summarize(fsamples, &result1->ns, &result1->min);
+	summarize(bsamples, &result1->baseline, &result1->baseline_min);
+	fprintf(stderr, "%-40s %10.2f ns %10.2f ns\n", result1->name, result1->ns,
+		result1->baseline);
+}
+
+bool write(FILE* out1) const;
+
+private:
+bench_suite(const bench_suite&);
+
+bench_suite&
+operator=(const bench_suite&);
+
+static uint64_t
+now()
+{
+	struct timespec time1;
+	clock_gettime(CLOCK_MONOTONIC, &time1);
+
+	return time1.tv_sec * 1000000000ULL + time1.tv_nsec;
+}
+
+template<class F>
+static double
+measure(const F& f1, uint64_t iterations1)
+{
+	uint64_t begin = now();
+	for (uint64_t i = 0; i < iterations1; i++) {
+		bench_keep(f1(i));
+	}
+
+	return (double) (now() - begin) / iterations1;
+}
+
+bench_result* add(const char* name1);
+
+void summarize(double* samples1, double* median1, double* min1) const;
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[bench_compare]] function `bench_compare`
+
+Function `bench_compare` reads two JSON documents written by `bench_suite`, 
+prints the change of the time of every benchmark found in both, and flags 
+benchmarks slower by more than `threshold1`, e.g. 0.1 for 10%. It returns the 
+number of regressions, or -1 if a document could not be read.
+////////////////////////////////////////////////////////////////////////////////
+*/
+int bench_compare(FILE* old1, FILE* new1, double threshold1, FILE* out1);
+
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,1229 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `bench/hactar_bench.cc`
+
+The `hactar_bench` tool measures the overhead of every kind of action against 
+hand-written code doing the same work, and writes the results as JSON to the 
+standard output or to the file given by `--output`. Option `--warmup`, 
+`--repetitions` and `--iterations` set the number of unmeasured repetitions, 
+measured repetitions and calls in every repetition, and `--filter` runs only 
+benchmarks containing a string in their names.
+
+With `--compare old.json new.json`, it compares two results instead, prints the 
+change of every benchmark, and exits with 1 if any benchmark is slower by more 
+than `--threshold`, 0.1 by default.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "bench.hh"
+#include "capture.hh"
+#include "const_map.hh"
+#include "const_table.hh"
+#include "hactar.hh"
+#include "executor.hh"
+#include "parallel_action.hh"
+#include "state_store.hh"
+#include "trace.hh"
+
+#include <malloc.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+
+using namespace hactar;
+
+namespace {
+
+class node
+{
+size_t _rc;
+double _value;
+
+public:
+node()
+	: _rc(0)
+	, _value(0)
+{
+}
+
+bool
+retain()
+{
+	return ++_rc;
+}
+
+bool
+release()
+{
+	return --_rc;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+private:
+node(const node&);
+
+node& operator=(const node&);
+
+};
+
+class state
+{
+size_t _rc;
+double _value;
+double _mvalue;
+
+public:
+state()
+	: _rc(0)
+	, _value(0)
+	, _mvalue(0)
+{
+}
+
+bool
+retain()
+{
+	return ++_rc;
+}
+
+bool
+release()
+{
+	return --_rc;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+void
+set_value(double value1)
+{
+	_value = value1;
+}
+
+double
+mvalue() const
+{
+	return _mvalue;
+}
+
+void
+set_mvalue(double mvalue1)
+{
+	_mvalue = mvalue1;
+}
+
+private:
+state(const state&);
+
+state& operator=(const state&);
+
+};
+
+template<class TAG>
+const_ptr<state>
+operator&(const const_ptr<state>& state1,
+	const action<double, double, TAG>& f1)
+{
+	mutable_ptr<state> state2;
+	state2->set_value(f1(state1->value()));
+	state2->set_mvalue(state1->mvalue());
+
+	return state2.build();
+}
+
+class record
+{
+std::atomic<size_t> _rc;
+double _value;
+
+public:
+record()
+	: _rc(0)
+	, _value(0)
+{
+}
+
+bool
+retain()
+{
+	return _rc.fetch_add(1) + 1;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1) - 1;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+void
+set_value(double value1)
+{
+	_value = value1;
+}
+
+private:
+record(const record&);
+
+record& operator=(const record&);
+
+};
+
+template<class TAG>
+const_ptr<record>
+operator&(const const_ptr<record>& record1,
+	const action<double, double, TAG>& f1)
+{
+	if (record1.get() == NULL) {
+		return record1;
+	}
+
+	mutable_ptr<record> record2;
+	record2->set_value(f1(record1->value()));
+
+	return record2.build();
+}
+
+template<class TAG>
+const_ptr<record>
+operator&(const const_ptr<record>& record1,
+	const action<bool, double, TAG>& f1)
+{
+	if (record1.get() == NULL || !f1(record1->value())) {
+		return mutable_ptr<record>((record*) NULL).build();
+	}
+
+	return record1;
+}
+
+struct bounded
+{
+double step;
+double limit;
+
+double
+operator()(const double& x) const
+{
+	return x + step < limit ? x + step : -1.0;
+}
+
+};
+
+const_ptr<record>
+operator&(const const_ptr<record>& record1,
+	const action<double, double, wrapf_action_tag<bounded> >& f1)
+{
+	if (record1.get() == NULL) {
+		return record1;
+	}
+
+	double value1 = f1(record1->value());
+	if (value1 < 0) {
+		return mutable_ptr<record>((record*) NULL).build();
+	}
+
+	mutable_ptr<record> record2;
+	record2->set_value(value1);
+
+	return record2.build();
+}
+
+template<unsigned int N, class S, class F>
+S
+bind_n(S&& state1, const F& f1)
+{
+	if constexpr (N == 0) {
+		return static_cast<S&&> (state1);
+	}
+	else {
+		return bind_n<N - 1>(static_cast<S&&> (state1) & f1, f1);
+	}
+}
+
+struct raw_node
+{
+size_t rc;
+double value;
+};
+
+class adder
+{
+double _offset;
+
+public:
+adder()
+	: _offset(0.5)
+{
+}
+
+double
+add(const double& x, double y)
+{
+	return x + y + _offset;
+}
+
+};
+
+double
+twice(const double& x)
+{
+	return x * 2.0;
+}
+
+double
+add(const double& x, double y)
+{
+	return x + y;
+}
+
+double
+add_both(const double& x, double y, double z)
+{
+	return x + y + z;
+}
+
+double
+add_ref(const double& x, const double& y)
+{
+	return x + y;
+}
+
+double
+subtract(const double& x, const double& y)
+{
+	return x - y;
+}
+
+bool
+below(const double& x, double limit)
+{
+	return x < limit;
+}
+
+double
+work(const double& x, unsigned int n)
+{
+	double y = x;
+	for (unsigned int i = 0; i < n; i++) {
+		y = y * 0.999999 + 1.0;
+		asm volatile ("" : "+x" (y));
+	}
+
+	return y;
+}
+
+void
+increment(double& x)
+{
+	x += 1.0;
+}
+
+typedef action<double, double, offer_action_tag<wrap1_action_tag<double>,
+		null_action_tag, wrap1_action_tag<double> > > offer_type;
+
+typedef action<double, double, offer_action_tag<offer_action_tag<
+		wrap1_action_tag<double>, null_action_tag, wrap1_action_tag<double> >,
+		offer_action_tag<wrap1_action_tag<double>, null_action_tag,
+		wrap1_action_tag<double> >, wrap1_action_tag<double> > > offers_type;
+
+offer_type
+branch(unsigned int i, unsigned int count1)
+{
+	return offer(wrap(add, (double) i), wrap(below, 100.0 * (i + 1) / count1),
+		(int) (count1 - i));
+}
+
+offers_type
+branches(unsigned int begin1, unsigned int size1, unsigned int count1)
+{
+	if (size1 == 2) {
+		return branch(begin1, count1) | branch(begin1 + 1, count1);
+	}
+
+	return branches(begin1, size1 / 2, count1) | branches(begin1 + size1 / 2,
+		size1 / 2, count1);
+}
+
+double
+choose(const double& x, unsigned int count1)
+{
+	int cost = 0;
+	double y = x;
+	for (unsigned int i = 0; i < count1; i++) {
+		int cost1 = (int) (count1 - i);
+		if (x < 100.0 * (i + 1) / count1 && (y == x || cost1 < cost)) {
+			cost = cost1;
+			y = x + i;
+		}
+	}
+
+	return y;
+}
+
+void
+ptr_bench(bench_suite& suite1)
+{
+	suite1.run("const_ptr/create", [](uint64_t) {
+			return mutable_ptr<node>().build()->value();
+		}, [](uint64_t) {
+			raw_node* node1 = bench_hide(new raw_node());
+			node1->rc = 1;
+			double value = node1->value;
+			delete node1;
+			return value;
+		});
+
+	const_ptr<node> const_ptr1 = mutable_ptr<node>().build();
+	raw_node raw_node1 = { 1, 0.0 };
+	suite1.run("const_ptr/copy", [&](uint64_t) {
+			const_ptr<node> const_ptr2(const_ptr1);
+			return const_ptr2->value();
+		}, [&](uint64_t) {
+			raw_node* node1 = bench_hide(&raw_node1);
+			node1->rc++;
+			double value = node1->value;
+			node1->rc--;
+			return value;
+		});
+
+	suite1.run("mutable_ptr/copy", [&](uint64_t) {
+			mutable_ptr<node> mutable_ptr1(const_ptr1);
+			return mutable_ptr1->value();
+		}, [&](uint64_t) {
+			raw_node* node1 = bench_hide(&raw_node1);
+			node1->rc++;
+			double value = node1->value;
+			node1->rc--;
+			return value;
+		});
+}
+
+void
+queue_bench(bench_suite& suite1)
+{
+	double values[16] = { 0 };
+	const_queue<double> queue1 = const_queue<double>::build(16,
+		[&](double* ptr) {
+			for (unsigned int i = 0; i < 16; i++) {
+				new (ptr + i) double(values[i]);
+			}
+		});
+
+	suite1.run("const_queue/append/16", [&](uint64_t i) {
+			const_queue<double> queue2(queue1, bench_hide((double) i));
+			return queue2[16];
+		}, [&](uint64_t i) {
+			double* ptr = bench_hide((double*) malloc(17 * sizeof(double)));
+			memcpy(ptr, values, 16 * sizeof(double));
+			ptr[16] = bench_hide((double) i);
+			double value = ptr[16];
+			free(ptr);
+			return value;
+		});
+
+	suite1.run("const_queue/copy", [&](uint64_t) {
+			const_queue<double> queue2(*bench_hide(&queue1));
+			return queue2.size();
+		}, [&](uint64_t) {
+			return bench_hide(16u);
+		});
+}
+
+void
+map_bench(bench_suite& suite1)
+{
+	static const char* names[5] = { "const_map/set/1k", "const_map/set/10k",
+		"const_map/set/100k", "const_map/set/1m", "const_map/set/10m" };
+	unsigned int size1 = 1000;
+	for (unsigned int i = 0; i < 5; i++, size1 *= 10) {
+		if (!suite1.selected(names[i])) {
+			continue;
+		}
+
+		mutable_map<unsigned int, double> mutable_map1;
+		for (unsigned int j = 0; j < size1; j++) {
+			mutable_map1.set(j, j);
+		}
+
+		const_map<unsigned int, double> map1 = mutable_map1.build();
+		const_queue<double> queue1 = const_queue<double>::build(size1,
+			[&](double* ptr) {
+				for (unsigned int j = 0; j < size1; j++) {
+					new (ptr + j) double(j);
+				}
+			});
+
+		suite1.run(names[i], [&](uint64_t j) {
+				unsigned int key = j * 2654435761u % size1;
+				const_map<unsigned int, double> map2 = map1.set(key,
+					bench_hide((double) j));
+				return *map2.find(key);
+			}, [&](uint64_t j) {
+				unsigned int key = j * 2654435761u % size1;
+				const_queue<double> queue2 = const_queue<double>::build(size1,
+					[&](double* ptr) {
+						memcpy(ptr, &queue1[0], size1 * sizeof(double));
+						ptr[key] = bench_hide((double) j);
+					});
+				return queue2[key];
+			}, 100.0 / size1);
+	}
+}
+
+void
+table_bench(bench_suite& suite1)
+{
+	if (!suite1.selected("const_table/")) {
+		return;
+	}
+
+	const unsigned int size1 = 100000;
+	const_queue<double> values = const_queue<double>::build(size1,
+		[&](double* ptr) {
+			for (unsigned int i = 0; i < size1; i++) {
+				new (ptr + i) double(i);
+			}
+		});
+	const_table<double, double> table1(values, values);
+	const_ptr<state>* states = (const_ptr<state>*) malloc(size1 *
+		sizeof(const_ptr<state>));
+	for (unsigned int i = 0; i < size1; i++) {
+		mutable_ptr<state> state1;
+		state1->set_value(i);
+		state1->set_mvalue(i);
+		new (states + i) const_ptr<state>(state1.build());
+	}
+
+	unsigned int* rows = (unsigned int*) malloc(size1 / 10 *
+		sizeof(unsigned int));
+	for (unsigned int i = 0; i < size1 / 10; i++) {
+		rows[i] = i * 2654435761u % size1;
+	}
+
+	auto f = wrap(add, 1.0);
+	suite1.run("const_table/bind/100k", [&](uint64_t) {
+			const_table<double, double> table2 = bench_hide(&table1)->bind<0>(f);
+			return table2.column<0>()[size1 - 1];
+		}, [&](uint64_t) {
+			for (unsigned int i = 0; i < size1; i++) {
+				const_ptr<state> state1 = states[i] & f;
+				states[i].~const_ptr<state>();
+				new (states + i) const_ptr<state>(state1);
+			}
+
+			return states[size1 - 1]->value();
+		}, 0.0001);
+
+	suite1.run("const_table/gather/10k", [&](uint64_t) {
+			const_table<double, double> table2 = bench_hide(&table1)->bind<0>(f,
+				span<unsigned int>(rows, size1 / 10));
+			return table2.column<0>()[rows[0]];
+		}, [&](uint64_t) {
+			for (unsigned int i = 0; i < size1 / 10; i++) {
+				const_ptr<state> state1 = states[rows[i]] & f;
+				states[rows[i]].~const_ptr<state>();
+				new (states + rows[i]) const_ptr<state>(state1);
+			}
+
+			return states[rows[0]]->value();
+		}, 0.001);
+
+	for (unsigned int i = 0; i < size1; i++) {
+		states[i].~const_ptr<state>();
+	}
+
+	free(states);
+	free(rows);
+}
+
+class locked_store
+{
+pthread_mutex_t _mutex;
+std::map<unsigned int, const_ptr<record> > _records;
+
+public:
+locked_store()
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+~locked_store()
+{
+	pthread_mutex_destroy(&_mutex);
+}
+
+void
+set(unsigned int key1, const const_ptr<record>& record1)
+{
+	pthread_mutex_lock(&_mutex);
+	_records.insert(std::make_pair(key1, record1));
+	pthread_mutex_unlock(&_mutex);
+}
+
+const_ptr<record>
+find(unsigned int key1)
+{
+	pthread_mutex_lock(&_mutex);
+	const_ptr<record> record1 = _records.find(key1)->second;
+	pthread_mutex_unlock(&_mutex);
+
+	return record1;
+}
+
+template<class F>
+void
+update(unsigned int key1, const F& f1)
+{
+	pthread_mutex_lock(&_mutex);
+	std::map<unsigned int, const_ptr<record> >::iterator it =
+		_records.find(key1);
+	const_ptr<record> record1 = it->second & f1;
+	it->second.~const_ptr<record>();
+	new (&it->second) const_ptr<record>(record1);
+	pthread_mutex_unlock(&_mutex);
+}
+
+private:
+locked_store(const locked_store&);
+
+locked_store& operator=(const locked_store&);
+
+};
+
+void
+store_bench(bench_suite& suite1)
+{
+	if (!suite1.selected("state_store/")) {
+		return;
+	}
+
+	const unsigned int size1 = 100000;
+	const unsigned int mask1 = (1 << 16) - 1;
+	double* cdf = (double*) malloc(size1 * sizeof(double));
+	double sum = 0;
+	for (unsigned int i = 0; i < size1; i++) {
+		sum += 1.0 / pow(i + 1.0, 0.99);
+		cdf[i] = sum;
+	}
+
+	unsigned int* keys = (unsigned int*) malloc((mask1 + 1) *
+		sizeof(unsigned int));
+	uint64_t seed = 88172645463325252ULL;
+	for (unsigned int i = 0; i <= mask1; i++) {
+		seed ^= seed << 13;
+		seed ^= seed >> 7;
+		seed ^= seed << 17;
+		double u = (seed >> 11) * (sum / 9007199254740992.0);
+		unsigned int rank = std::lower_bound(cdf, cdf + size1, u) - cdf;
+		keys[i] = (rank < size1 ? rank : size1 - 1) * 2654435761u % size1;
+	}
+
+	state_store<unsigned int, record> store1;
+	locked_store locked1;
+	for (unsigned int i = 0; i < size1; i++) {
+		mutable_ptr<record> record1;
+		record1->set_value(i);
+		store1.set(i, record1.build());
+		locked1.set(i, store1.find(i));
+	}
+
+	static const char* names[3] = { "state_store/ycsb_a",
+		"state_store/ycsb_b", "state_store/ycsb_c" };
+	static const unsigned int reads[3] = { 50, 95, 100 };
+	auto f = wrap(add, 1.0);
+	for (unsigned int i = 0; i < 3; i++) {
+		unsigned int reads1 = reads[i];
+		suite1.run(names[i], [&](uint64_t j) {
+				unsigned int key = keys[j & mask1];
+				if (j * 37 % 100 < reads1) {
+					return store1.find(key)->value();
+				}
+
+				return (double) store1.update(key, f);
+			}, [&](uint64_t j) {
+				unsigned int key = keys[j & mask1];
+				if (j * 37 % 100 < reads1) {
+					return locked1.find(key)->value();
+				}
+
+				locked1.update(key, f);
+				return 1.0;
+			}, 0.1);
+	}
+
+	executor executor1(4, 64);
+	suite1.run("state_store/ycsb_a/4096x4", [&](uint64_t j) {
+			executor1.submit_range([&](size_t begin1, size_t end1) {
+					for (size_t k = begin1; k < end1; k++) {
+						unsigned int key = keys[(j * 4096 + k) & mask1];
+						if (k % 2) {
+							bench_keep(store1.find(key)->value());
+						}
+						else {
+							store1.update(key, f);
+						}
+					}
+				}, 4096, 1024).wait();
+			return j;
+		}, [&](uint64_t j) {
+			executor1.submit_range([&](size_t begin1, size_t end1) {
+					for (size_t k = begin1; k < end1; k++) {
+						unsigned int key = keys[(j * 4096 + k) & mask1];
+						if (k % 2) {
+							bench_keep(locked1.find(key)->value());
+						}
+						else {
+							locked1.update(key, f);
+						}
+					}
+				}, 4096, 1024).wait();
+			return j;
+		}, 0.0001);
+
+	suite1.run("state_store/snapshot", [&](uint64_t) {
+			return store1.snapshot().size();
+		}, [&](uint64_t) {
+			size_t size2 = 0;
+			for (unsigned int j = 0; j < size1; j++) {
+				size2 += locked1.find(j).get() != NULL;
+			}
+
+			return size2;
+		}, 0.0001);
+
+	free(cdf);
+	free(keys);
+}
+
+void
+outcome_bench(bench_suite& suite1)
+{
+	mutable_ptr<record> record1;
+	record1->set_value(1.0);
+	const_ptr<record> state1 = record1.build();
+	auto f = wrap<double>(bounded { 1.0, 3.5 });
+	auto f50 = bind_n<48>(f & f, f);
+	suite1.run("outcome/fail/50", [&](uint64_t) {
+			outcome<record> out = outcome<record>(*bench_hide(&state1)) &
+				f50;
+			return out.stage();
+		}, [&](uint64_t) {
+			const_ptr<record> out = bind_n<49>(*bench_hide(&state1) & f,
+				f);
+			return out.get() != NULL;
+		}, 0.1);
+
+	auto g = wrap<double>(bounded { 1.0, 100.0 });
+	auto g50 = bind_n<48>(g & g, g);
+	suite1.run("outcome/pass/50", [&](uint64_t) {
+			outcome<record> out = outcome<record>(*bench_hide(&state1)) &
+				g50;
+			return out.state()->value();
+		}, [&](uint64_t) {
+			const_ptr<record> out = bind_n<49>(*bench_hide(&state1) & g,
+				g);
+			return out->value();
+		}, 0.1);
+}
+
+void
+complex_bench(bench_suite& suite1)
+{
+	action<double, double, wrap1_action_tag<double> > f = wrap(add, 1.0);
+	suite1.run("complex_action/1", [&](uint64_t i) {
+			return f(bench_hide((double) i));
+		}, [](uint64_t i) {
+			return bench_hide((double) i) + 1.0;
+		});
+
+	auto f4 = f & f & f & f;
+	suite1.run("complex_action/4", [&](uint64_t i) {
+			return f4(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			return x + 1.0 + 1.0 + 1.0 + 1.0;
+		});
+
+	auto f16 = f4 & f4 & f4 & f4;
+	suite1.run("complex_action/16", [&](uint64_t i) {
+			return f16(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			for (int j = 0; j < 16; j++) {
+				x = x + 1.0;
+			}
+
+			return x;
+		});
+}
+
+action<double, double, offer_action_tag<complex_action_tag<double,
+	wrap1_action_tag<double>, wrap1_action_tag<double> >, null_action_tag,
+	wrap1_action_tag<double> > >
+generated_branch(unsigned int i)
+{
+	unsigned int k = i % 16;
+	return offer(wrap(add, (double) k) & wrap(add, 1.0) & wrap(add, 2.0) &
+		wrap(add, 3.0), wrap(below, 100.0 * (k + 1) / 16), (int) (16 - k));
+}
+
+auto
+interned_branch(intern_table* table1, unsigned int i)
+{
+	unsigned int k = i % 16;
+	return offer(intern(table1, intern(table1, intern(table1,
+					wrap(add, (double) k) & wrap(add, 1.0)) & wrap(add, 2.0)) &
+			wrap(add, 3.0)), intern(table1, wrap(below, 100.0 * (k + 1) / 16)),
+		(int) (16 - k));
+}
+
+size_t
+heap_bytes()
+{
+	struct mallinfo2 info1 = mallinfo2();
+
+	return info1.uordblks + info1.hblkhd;
+}
+
+template<class B>
+auto
+generated_offer(const B& branch1, unsigned int begin1, unsigned int pairs1)
+{
+	if (pairs1 == 1) {
+		return branch1(begin1) | branch1(begin1 + 1);
+	}
+
+	return generated_offer(branch1, begin1, pairs1 / 2) |
+		generated_offer(branch1, begin1 + pairs1 / 2 * 2,
+			pairs1 - pairs1 / 2);
+}
+
+void
+offer_bench(bench_suite& suite1)
+{
+	static const unsigned int counts[] = { 2, 8, 32 };
+	for (unsigned int k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+		unsigned int count1 = counts[k];
+		offers_type f = branches(0, count1, count1);
+		char name[64];
+		snprintf(name, sizeof(name), "offer_action/%u", count1);
+		suite1.run(name, [&](uint64_t i) {
+				return f(bench_hide((double) (i % 100)));
+			}, [&](uint64_t i) {
+				return choose(bench_hide((double) (i % 100)), count1);
+			});
+	}
+
+	if (!suite1.selected("offer_action/10k/interned")) {
+		return;
+	}
+
+	size_t heap = heap_bytes();
+	auto f = generated_offer(generated_branch, 0, 5000);
+	size_t plain = heap_bytes() - heap;
+	intern_table table1;
+	auto g = generated_offer([&](unsigned int i) {
+			return interned_branch(&table1, i);
+		}, 0, 5000);
+	size_t interned = heap_bytes() - heap - plain;
+	fprintf(stderr, "%-40s %10zu B  %10zu B (%zu actions kept)\n",
+		"offer_action/10k/interned/memory", interned, plain, table1.size());
+	suite1.run("offer_action/10k/interned", [&](uint64_t i) {
+			return g(bench_hide((double) (i % 100)));
+		}, [&](uint64_t i) {
+			return f(bench_hide((double) (i % 100)));
+		}, 0.001);
+}
+
+void
+loop_bench(bench_suite& suite1)
+{
+	auto f = wrap(add, 1.0) * 16;
+	suite1.run("loop_action/16", [&](uint64_t i) {
+			return f(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			for (int j = 0; j < 16; j++) {
+				x = x + 1.0;
+			}
+
+			return x;
+		});
+
+	auto g = wrap(add, 1.0) * loop(16, wrap(below, 1e18));
+	suite1.run("loop_action/16/filter", [&](uint64_t i) {
+			return g(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			for (int j = 0; j < 16 && x < 1e18; j++) {
+				x = x + 1.0;
+			}
+
+			return x;
+		});
+
+	auto h = wrap(increment) * 16;
+	suite1.run("loop_action/16/in_place", [&](uint64_t i) {
+			double x = bench_hide((double) i);
+			h(x);
+			return x;
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			for (int j = 0; j < 16; j++) {
+				increment(x);
+			}
+
+			return x;
+		});
+}
+
+void
+wrap_bench(bench_suite& suite1)
+{
+	auto baseline = [](uint64_t i) {
+			return add(bench_hide((double) i), 1.0);
+		};
+
+	auto f0 = wrap(twice);
+	suite1.run("wrap/0", [&](uint64_t i) {
+			return f0(bench_hide((double) i));
+		}, [](uint64_t i) {
+			return twice(bench_hide((double) i));
+		});
+
+	auto f1 = wrap(add, 1.0);
+	suite1.run("wrap/1", [&](uint64_t i) {
+			return f1(bench_hide((double) i));
+		}, baseline);
+
+	auto fp = profiled("wrap/profiled", f1);
+	suite1.run("wrap/profiled", [&](uint64_t i) {
+			return fp(bench_hide((double) i));
+		}, baseline);
+
+	auto f2 = wrap(add_both, 0.5, 0.5);
+	suite1.run("wrap/2", [&](uint64_t i) {
+			return f2(bench_hide((double) i));
+		}, [](uint64_t i) {
+			return add_both(bench_hide((double) i), 0.5, 0.5);
+		});
+
+	auto fn = wrap(add_ref, 1.0);
+	suite1.run("wrap/variadic", [&](uint64_t i) {
+			return fn(bench_hide((double) i));
+		}, baseline);
+
+	auto fs = wrap_shared(add_ref, 1.0);
+	suite1.run("wrap/shared", [&](uint64_t i) {
+			return fs(bench_hide((double) i));
+		}, baseline);
+
+	auto ft = wrap<&add>(1.0);
+	suite1.run("wrap/static", [&](uint64_t i) {
+			return ft(bench_hide((double) i));
+		}, baseline);
+
+	auto ff = wrap<double>([](const double& x) {
+			return x + 1.0;
+		});
+	suite1.run("wrap/functor", [&](uint64_t i) {
+			return ff(bench_hide((double) i));
+		}, baseline);
+
+	adder adder1;
+	auto fm = wrap(&adder1, &adder::add, 0.5);
+	suite1.run("wrap/method", [&](uint64_t i) {
+			return fm(bench_hide((double) i));
+		}, [&](uint64_t i) {
+			return bench_hide(&adder1)->add(bench_hide((double) i), 0.5);
+		});
+
+	auto fi = wrap(increment);
+	suite1.run("wrap/in_place", [&](uint64_t i) {
+			double x = bench_hide((double) i);
+			fi(x);
+			return x;
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			increment(x);
+			return x;
+		});
+}
+
+void
+profile_bench(bench_suite& suite1)
+{
+	auto f = wrap(add, 1.0) & (branches(0, 8, 8) & wrap(add, 1.0)) * 4;
+	auto g = profiled("profile/pipeline", f);
+	profile_registry& registry1 = profile_registry::instance();
+	suite1.run("profile/pipeline", [&](uint64_t i) {
+			return g(bench_hide((double) (i % 100)));
+		}, [&](uint64_t i) {
+			return f(bench_hide((double) (i % 100)));
+		});
+
+	registry1.sample(100);
+	suite1.run("profile/pipeline/sampled", [&](uint64_t i) {
+			return g(bench_hide((double) (i % 100)));
+		}, [&](uint64_t i) {
+			return f(bench_hide((double) (i % 100)));
+		}, 0.1);
+	registry1.sample(0);
+}
+
+void
+capture_bench(bench_suite& suite1)
+{
+	auto f = wrap(add, 1.0) & (branches(0, 8, 8) & wrap(add, 1.0)) * 4;
+	capture_file file1("hactar_bench.capture", sizeof(double),
+		sizeof(double), 100);
+	auto g = captured(file1, f);
+	suite1.run("capture/pipeline/sampled", [&](uint64_t i) {
+			return g(bench_hide((double) (i % 100)));
+		}, [&](uint64_t i) {
+			return f(bench_hide((double) (i % 100)));
+		}, 0.1);
+
+	executor executor1(4, 64);
+	suite1.run("capture/pipeline/sampled/4096x4", [&](uint64_t i) {
+			executor1.submit_range([&](size_t begin1, size_t end1) {
+					for (size_t k = begin1; k < end1; k++) {
+						bench_keep(g((double) ((i + k) % 100)));
+					}
+				}, 4096, 1024).wait();
+			return i;
+		}, [&](uint64_t i) {
+			executor1.submit_range([&](size_t begin1, size_t end1) {
+					for (size_t k = begin1; k < end1; k++) {
+						bench_keep(f((double) ((i + k) % 100)));
+					}
+				}, 4096, 1024).wait();
+			return i;
+		},0.0001);
+	remove("hactar_bench.capture");
+}
+
+void
+exec_bench(bench_suite& suite1)
+{
+	auto f = fork(wrap(add, 1.0), wrap(add, 2.0)) & join(subtract);
+	suite1.run("fork_action/join", [&](uint64_t i) {
+			return f(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			return subtract(add(x, 1.0), add(x, 2.0));
+		});
+
+	auto shared1 = fork(wrap(work, 256u) & wrap(add, 1.0), wrap(work, 256u) &
+		wrap(add, 2.0)) & join(subtract);
+	suite1.run("fork_action/shared/1", [&](uint64_t i) {
+			return shared1(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			return subtract(add(work(x, 256), 1.0), add(work(x, 256), 2.0));
+		}, 0.1);
+
+	auto shared3 = fork(wrap(work, 256u) & wrap(add, 1.0) & wrap(add, 2.0) &
+		wrap(add, 3.0), wrap(work, 256u) & wrap(add, 1.0) & wrap(add, 2.0) &
+		wrap(add, 4.0)) & join(subtract);
+	suite1.run("fork_action/shared/3", [&](uint64_t i) {
+			return shared3(bench_hide((double) i));
+		}, [](uint64_t i) {
+			double x = bench_hide((double) i);
+			return subtract(add(add(add(work(x, 256), 1.0), 2.0), 3.0),
+				add(add(add(work(x, 256), 1.0), 2.0), 4.0));
+		}, 0.1);
+
+	executor executor1;
+	suite1.run("executor/submit", [&](uint64_t i) {
+			return executor1.submit(wrap(add, 1.0), (double) i).wait();
+		}, [](uint64_t i) {
+			return add(bench_hide((double) i), 1.0);
+		}, 0.01);
+
+	double values[1024];
+	for (unsigned int i = 0; i < 1024; i++) {
+		values[i] = i;
+	}
+
+	auto g = map<span>(&executor1, wrap(add, 1.0));
+	suite1.run("parallel_action/map/1024", [&](uint64_t) {
+			return g(span<double> (bench_hide(values), 1024))[1023];
+		}, [&](uint64_t) {
+			double* out = bench_hide((double*) malloc(1024 * sizeof(double)));
+			for (unsigned int i = 0; i < 1024; i++) {
+				out[i] = add(values[i], 1.0);
+			}
+
+			double value = out[1023];
+			free(out);
+			return value;
+		}, 0.001);
+
+	trace_sink sink1("hactar_bench.trace", 1 << 16);
+	uint32_t event1 = sink1.event("bench");
+	suite1.run("trace_sink/write", [&](uint64_t i) {
+			sink1.write(event1, (double) i, 0.0);
+			return i;
+		}, [](uint64_t i) {
+			return bench_hide(i);
+		});
+	remove("hactar_bench.trace");
+}
+
+int
+usage(const char* name1)
+{
+	fprintf(stderr, "usage: %s [--warmup N] [--repetitions N] "
+		"[--iterations N] [--filter NAME] [--output FILE]\n"
+		"       %s --compare OLD NEW [--threshold RATIO]\n", name1, name1);
+
+	return 2;
+}
+
+int
+compare(const char* old1, const char* new1, double threshold1)
+{
+	FILE* old_file = fopen(old1, "r");
+	FILE* new_file = fopen(new1, "r");
+	int result = -1;
+	if (old_file && new_file) {
+		result = bench_compare(old_file, new_file, threshold1, stdout);
+	}
+
+	if (old_file) {
+		fclose(old_file);
+	}
+
+	if (new_file) {
+		fclose(new_file);
+	}
+
+	if (result < 0) {
+		fprintf(stderr, "could not read %s or %s\n", old1, new1);
+		return 2;
+	}
+
+	printf("%d regressions\n", result);
+
+	return result ? 1 : 0;
+}
+
+}
+
+int
+main(int argc, const char* argv[])
+{
+	unsigned int warmup = 1;
+	unsigned int repetitions = 5;
+	uint64_t iterations = 1000000;
+	const char* filter = NULL;
+	const char* output = NULL;
+	const char* compare_old = NULL;
+	const char* compare_new = NULL;
+	double threshold = 0.1;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--compare") == 0 && i + 2 < argc) {
+			compare_old = argv[++i];
+			compare_new = argv[++i];
+		}
+		else if (i + 1 >= argc) {
+			return usage(argv[0]);
+		}
+		else if (strcmp(argv[i], "--warmup") == 0) {
+			warmup = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--repetitions") == 0) {
+			repetitions = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--iterations") == 0) {
+			iterations = strtoull(argv[++i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--filter") == 0) {
+			filter = argv[++i];
+		}
+		else if (strcmp(argv[i], "--output") == 0) {
+			output = argv[++i];
+		}
+		else if (strcmp(argv[i], "--threshold") == 0) {
+			threshold = atof(argv[++i]);
+		}
+		else {
+			return usage(argv[0]);
+		}
+	}
+
+	if (compare_old) {
+		return compare(compare_old, compare_new, threshold);
+	}
+
+	bench_suite suite1(warmup, repetitions, iterations, filter);
+	ptr_bench(suite1);
+	queue_bench(suite1);
+	map_bench(suite1);
+	table_bench(suite1);
+	store_bench(suite1);
+	outcome_bench(suite1);
+	complex_bench(suite1);
+	offer_bench(suite1);
+	loop_bench(suite1);
+	wrap_bench(suite1);
+	profile_bench(suite1);
+	capture_bench(suite1);
+	exec_bench(suite1);
+
+	FILE* out = output ? fopen(output, "w") : stdout;
+	if (!out) {
+		perror(output);
+		return 2;
+	}
+
+	bool result = suite1.write(out);
+	if (out != stdout) {
+		result = fclose(out) == 0 && result;
+	}
+
+	return result ? 0 : 2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,737 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/async_action.hh`
+
+This file consists of class template <<task>>, function <<resume_on>>, 
+function <<ready>>, <<action with async_complex_action_tag>>, <<action with 
+async_loop_action_tag>> and function <<start>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_ASYNC_ACTION_HH
+#define HACTAR_ASYNC_ACTION_HH
+
+#include "action.hh"
+#include "loop_action.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+#include "executor.hh"
+#include "reactor.hh"
+
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <coroutine>
+#include <new>
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[task]] class template `task`
+
+Class template `task` is the result of a coroutine returning a value of type 
+`T`, which starts when the task is awaited by `co_await` in another coroutine, 
+and resumes the awaiting coroutine when it returns. A task could also be made 
+ready with a value, without a coroutine.
+
+An async action is an action `action<task<OUT>, IN, TAG>`, which returns a 
+task instead of a value, e.g. a wrapped coroutine `task<OUT> f(const IN&)`. A 
+coroutine keeps references to its arguments, so the arguments must live until 
+the task is finished. Async actions composed by operators keep their inputs 
+until then.
+
+A task is invalid if memory could not be allocated for the coroutine, and 
+awaiting an invalid task aborts. Exceptions are not supported in coroutines.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T>
+class task
+{
+public:
+class promise_type;
+
+private:
+std::coroutine_handle<promise_type> _coroutine;
+alignas(T) unsigned char _value[sizeof(T)];
+bool _ready;
+
+public:
+task()
+	: _coroutine(NULL)
+	, _ready(false)
+{
+}
+
+explicit
+task(const T& value1)
+	: _coroutine(NULL)
+	, _ready(true)
+{
+	new (_value) T(value1);
+}
+
+task(std::coroutine_handle<promise_type> coroutine1)
+	: _coroutine(coroutine1)
+	, _ready(false)
+{
+}
+
+task(task<T>&& task1)
+	: _coroutine(task1._coroutine)
+	, _ready(task1._ready)
+{
+	task1._coroutine = NULL;
+	if (_ready) {
+		new (_value) T(std::move(*(T*) task1._value));
+	}
+}
+
+~task()
+{
+	if (_coroutine) {
+		_coroutine.destroy();
+	}
+
+	if (_ready) {
+		((T*) _value)->~T();
+	}
+}
+
+bool
+valid() const
+{
+	return _ready || _coroutine;
+}
+
+bool
+await_ready() const
+{
+	return _ready;
+}
+
+std::coroutine_handle<>
+await_suspend(std::coroutine_handle<> continuation1)
+{
+	if (!_coroutine) {
+		abort();
+	}
+
+	_coroutine.promise()._continuation = continuation1;
+
+	return _coroutine;
+}
+
+T
+await_resume()
+{
+	if (_ready) {
+		return std::move(*(T*) _value);
+	}
+
+	return std::move(*(T*) _coroutine.promise()._value);
+}
+
+class promise_type
+{
+friend class task<T>;
+
+std::coroutine_handle<> _continuation;
+alignas(T) unsigned char _value[sizeof(T)];
+bool _has_value;
+
+public:
+class final_awaiter
+{
+public:
+bool
+await_ready() const noexcept
+{
+	return false;
+}
+
+std::coroutine_handle<>
+await_suspend(std::coroutine_handle<promise_type> coroutine1) noexcept
+{
+	std::coroutine_handle<> continuation = coroutine1.promise()._continuation;
+	if (!continuation) {
+		return std::noop_coroutine();
+	}
+
+	return continuation;
+}
+
+void
+await_resume() noexcept
+{
+}
+
+};
+
+promise_type()
+	: _continuation(NULL)
+	, _has_value(false)
+{
+}
+
+~promise_type()
+{
+	if (_has_value) {
+		((T*) _value)->~T();
+	}
+}
+
+task<T>
+get_return_object()
+{
+	return task<T> (std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+static task<T>
+get_return_object_on_allocation_failure()
+{
+	return task<T> ();
+}
+
+std::suspend_always
+initial_suspend() noexcept
+{
+	return std::suspend_always();
+}
+
+final_awaiter
+final_suspend() noexcept
+{
+	return final_awaiter();
+}
+
+void
+return_value(T value1)
+{
+	new (_value) T(std::move(value1));
+	_has_value = true;
+}
+
+void
+unhandled_exception()
+{
+	abort();
+}
+
+};
+
+private:
+task(const task<T>&);
+
+task<T>& operator=(const task<T>&);
+
+};
+
+template<class T>
+task<T>&&
+to_task(task<T>&& task1)
+{
+	return std::move(task1);
+}
+
+template<class T>
+task<T>
+to_task(const T& value1)
+{
+	return task<T> (value1);
+}
+
+template<class T>
+struct task_value
+{
+typedef T type;
+};
+
+template<class T>
+struct task_value<task<T> >
+{
+typedef T type;
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[resume_on]] function `resume_on`
+
+Function `resume_on` returns an awaitable object, which suspends the awaiting 
+coroutine and resumes it in a worker of an <<executor>>. No memory is 
+allocated, since the job lives in the suspended coroutine.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class resume_awaiter
+	: public job
+{
+executor* _executor;
+std::coroutine_handle<> _coroutine;
+
+public:
+resume_awaiter(executor* executor1)
+	: job(run)
+	, _executor(executor1)
+{
+}
+
+bool
+await_ready() const
+{
+	return false;
+}
+
+void
+await_suspend(std::coroutine_handle<> coroutine1)
+{
+	_coroutine = coroutine1;
+	_executor->schedule(this);
+}
+
+void
+await_resume()
+{
+}
+
+private:
+static void
+run(job* job1)
+{
+	static_cast<resume_awaiter*>(job1)->_coroutine.resume();
+}
+
+};
+
+inline resume_awaiter
+resume_on(executor* executor1)
+{
+	return resume_awaiter(executor1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[ready]] function `ready`
+
+Function `ready` returns an awaitable object, which suspends the awaiting 
+coroutine until a non-blocking file descriptor is ready to be read, or written 
+if `write1` is true, and resumes it in a worker of the executor of a 
+<<reactor>>. Awaiting it returns false if the file descriptor could not be 
+watched, e.g. a regular file, which is always ready.
+
+Coroutines `read_some` and `write_some` read and write a non-blocking file 
+descriptor as `read` and `write`, but wait for it to be ready instead of 
+failing with `EAGAIN`.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+task<double> receive(const int& fd, reactor* reactor1)
+{
+	double x = 0;
+	co_await read_some(reactor1, fd, &x, sizeof(x));
+	co_return x;
+}
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class ready_awaiter
+	: public job
+{
+reactor* _reactor;
+int _fd;
+bool _write;
+bool _watched;
+std::coroutine_handle<> _coroutine;
+
+public:
+ready_awaiter(reactor* reactor1, int fd1, bool write1)
+	: job(run)
+	, _reactor(reactor1)
+	, _fd(fd1)
+	, _write(write1)
+	, _watched(false)
+{
+}
+
+bool
+await_ready() const
+{
+	return false;
+}
+
+bool
+await_suspend(std::coroutine_handle<> coroutine1)
+{
+	_coroutine = coroutine1;
+	_watched = true;
+	if (_reactor->watch(_fd, _write, this)) {
+		return true;
+	}
+
+	_watched = false;
+
+	return false;
+}
+
+bool
+await_resume() const
+{
+	return _watched;
+}
+
+private:
+static void
+run(job* job1)
+{
+	static_cast<ready_awaiter*>(job1)->_coroutine.resume();
+}
+
+};
+
+inline ready_awaiter
+ready(reactor* reactor1, int fd1, bool write1)
+{
+	return ready_awaiter(reactor1, fd1, write1);
+}
+
+inline task<ssize_t>
+read_some(reactor* reactor1, int fd1, void* buffer1, size_t size1)
+{
+	for (;;) {
+		ssize_t size = read(fd1, buffer1, size1);
+		if (size >= 0 || (errno != EAGAIN && errno != EINTR)) {
+			co_return size;
+		}
+
+		if (errno == EAGAIN && !co_await ready(reactor1, fd1, false)) {
+			co_return -1;
+		}
+	}
+}
+
+inline task<ssize_t>
+write_some(reactor* reactor1, int fd1, const void* buffer1, size_t size1)
+{
+	for (;;) {
+		ssize_t size = write(fd1, buffer1, size1);
+		if (size >= 0 || (errno != EAGAIN && errno != EINTR)) {
+			co_return size;
+		}
+
+		if (errno == EAGAIN && !co_await ready(reactor1, fd1, true)) {
+			co_return -1;
+		}
+	}
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with async_complex_action_tag]] action with async_complex_action_tag
+
+Async complex actions are used for composition of async actions with 
+`operator&`, as complex actions of actions. Either action could be an action 
+returning a value, so async actions and actions could be composed in any 
+order, and the composed action is an async action. The second action starts 
+when the first one returns, so no thread is blocked while waiting.
+
+Offer actions of async actions are constructed with `operator|` as offer 
+actions of actions, and select an async action to await by filters and costs.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+task<double> receive(const int& fd, reactor* reactor1);
+
+wrap(receive, &reactor1) & wrap(add, 1.0); // => async action
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT1, class OUT2, class TAG1, class TAG2>
+struct async_complex_action_tag { };
+
+template<class OUT, class IN, class OUT1, class OUT2, class TAG1, class TAG2>
+class action<task<OUT>, IN, async_complex_action_tag<OUT1, OUT2, TAG1, TAG2> >
+{
+typedef typename task_value<OUT1>::type OUTIN;
+
+action<OUT1, IN, TAG1> _f;
+action<OUT2, OUTIN, TAG2> _g;
+
+public:
+action(const action<OUT1, IN, TAG1>& f1, const action<OUT2, OUTIN, TAG2>& g1)
+	: _f(f1)
+	, _g(g1)
+{
+}
+
+task<OUT>
+operator()(const IN& in1) const
+{
+	return run(*this, in1);
+}
+
+private:
+static task<OUT>
+run(action<task<OUT>, IN, async_complex_action_tag<OUT1, OUT2, TAG1, TAG2> >
+	action1, IN in1)
+{
+	OUTIN out = co_await to_task(action1._f(in1));
+	co_return co_await to_task(action1._g(out));
+}
+
+};
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+action<task<OUT>, IN, async_complex_action_tag<task<OUTIN>, task<OUT>, TAG1,
+		TAG2> >
+operator&(const action<task<OUTIN>, IN, TAG1>& f1,
+	const action<task<OUT>, OUTIN, TAG2>& g1)
+{
+	return action<task<OUT>, IN, async_complex_action_tag<task<OUTIN>,
+		task<OUT>, TAG1, TAG2> > (f1, g1);
+}
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+action<task<OUT>, IN, async_complex_action_tag<task<OUTIN>, OUT, TAG1, TAG2> >
+operator&(const action<task<OUTIN>, IN, TAG1>& f1,
+	const action<OUT, OUTIN, TAG2>& g1)
+{
+	return action<task<OUT>, IN, async_complex_action_tag<task<OUTIN>, OUT,
+		TAG1, TAG2> > (f1, g1);
+}
+
+template<class OUT, class IN, class OUTIN, class TAG1, class TAG2>
+action<task<OUT>, IN, async_complex_action_tag<OUTIN, task<OUT>, TAG1, TAG2> >
+operator&(const action<OUTIN, IN, TAG1>& f1,
+	const action<task<OUT>, OUTIN, TAG2>& g1)
+{
+	return action<task<OUT>, IN, async_complex_action_tag<OUTIN, task<OUT>,
+		TAG1, TAG2> > (f1, g1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with async_loop_action_tag]] action with async_loop_action_tag
+
+An async loop action loops an async action `action<task<IN>, IN, TAG>` as a 
+loop action, and could be constructed with `operator*` by a loop count or a 
+`loop` object. Each iteration starts when the last one returns.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+task<double> hop(const double& x, reactor* reactor1);
+
+wrap(hop, &reactor1) * 10; // => async loop action
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG, class TAGF>
+struct async_loop_action_tag { };
+
+template<class IN, class TAG, class TAGF>
+class action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> >
+{
+action<task<IN>, IN, TAG> _f;
+unsigned int _count;
+action<bool, IN, TAGF> _filter;
+
+public:
+action(const action<task<IN>, IN, TAG>& f1,
+	const int& count1, const action<bool, IN, TAGF>& filter1)
+	: _f(f1)
+	, _count(count1)
+	, _filter(filter1)
+{
+}
+
+task<IN>
+operator()(const IN& in1) const
+{
+	return run(*this, in1);
+}
+
+private:
+static task<IN>
+run(action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> > action1, IN in1)
+{
+	for (unsigned int i = 0; action1._filter(in1) && i < action1._count; i++) {
+		in1 = co_await action1._f(in1);
+	}
+
+	co_return in1;
+}
+
+};
+
+template<class IN, class TAG, class TAGF>
+action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> >
+operator*(const action<task<IN>, IN, TAG>& f1, const loop<IN, TAGF>& loop1)
+{
+	return action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG, class TAGF>
+action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> >
+operator*(const loop<IN, TAGF>& loop1, const action<task<IN>, IN, TAG>& f1)
+{
+	return action<task<IN>, IN, async_loop_action_tag<TAG, TAGF> > (f1,
+		loop1.count(), loop1.filter());
+}
+
+template<class IN, class TAG>
+action<task<IN>, IN, async_loop_action_tag<TAG, true_action_tag> >
+operator*(const action<task<IN>, IN, TAG>& f1, const unsigned int& count1)
+{
+	return action<task<IN>, IN, async_loop_action_tag<TAG, true_action_tag> > (
+		f1, count1, action<bool, IN, true_action_tag> ());
+}
+
+template<class IN, class TAG>
+action<task<IN>, IN, async_loop_action_tag<TAG, true_action_tag> >
+operator*(const unsigned int& count1, const action<task<IN>, IN, TAG>& f1)
+{
+	return action<task<IN>, IN, async_loop_action_tag<TAG, true_action_tag> > (
+		f1, count1, action<bool, IN, true_action_tag> ());
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[start]] function `start`
+
+Function `start` starts an async action with an input in a worker of an 
+<<executor>>, and returns a <<handle>> to wait for its result. Only the 
+coroutine frames of in-flight actions are kept while they are suspended, so 
+thousands of them could share a few workers. The handle is invalid if memory 
+could not be allocated.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+executor executor1(2);
+reactor reactor1(&executor1);
+
+handle<double> h = start(&executor1,
+	wrap(receive, &reactor1) & wrap(add, 1.0), fd);
+h.wait(); // => the value read from fd plus 1.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class detached_task
+{
+bool _valid;
+
+public:
+class promise_type
+{
+public:
+detached_task
+get_return_object()
+{
+	return detached_task(true);
+}
+
+static detached_task
+get_return_object_on_allocation_failure()
+{
+	return detached_task(false);
+}
+
+std::suspend_never
+initial_suspend() noexcept
+{
+	return std::suspend_never();
+}
+
+std::suspend_never
+final_suspend() noexcept
+{
+	return std::suspend_never();
+}
+
+void
+return_void()
+{
+}
+
+void
+unhandled_exception()
+{
+	abort();
+}
+
+};
+
+detached_task(bool valid1)
+	: _valid(valid1)
+{
+}
+
+bool
+valid() const
+{
+	return _valid;
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+detached_task
+run_detached(executor* executor1, action<task<OUT>, IN, TAG> f1, IN in1,
+	const_ptr<completion<OUT> > completion1)
+{
+	co_await resume_on(executor1);
+	OUT out = co_await f1(in1);
+	mutable_ptr<completion<OUT> > completion2(completion1);
+	completion2->set(std::move(out));
+	completion2->finish();
+}
+
+template<class OUT, class IN, class TAG>
+handle<OUT>
+start(executor* executor1, const action<task<OUT>, IN, TAG>& f1,
+	const IN& in1)
+{
+	mutable_ptr<completion<OUT> > completion1(
+		new (std::nothrow) completion<OUT>());
+	if (!completion1.get()) {
+		return handle<OUT> (completion1.build());
+	}
+
+	completion1->reset(executor1, 1);
+	if (!run_detached(executor1, f1, in1, completion1.build()).valid()) {
+		return handle<OUT> (mutable_ptr<completion<OUT> > (
+				(completion<OUT>*) NULL).build());
+	}
+
+	return handle<OUT> (completion1.build());
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,411 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/batcher.hh`
+
+This file consists of class template <<batcher>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_BATCHER_HH
+#define HACTAR_BATCHER_HH
+
+#include "action.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+#include "executor.hh"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[batcher]] class template `batcher`
+
+Class template `batcher` collects single inputs submitted one at a time into 
+batches, and evaluates an action over each batch in a job of an <<executor>>, 
+so that the action stays hot in cache. Method `submit` returns a <<handle>> 
+for the result of each input, and the handle is invalid if memory could not 
+be allocated.
+
+A batch is dispatched when it reaches the batch limit, or when its oldest input 
+has waited for `max_wait1` nanoseconds. The batch limit adapts to the arrival 
+rate: latencies from submission to completion are sampled, and the 99th 
+percentile of every window of samples is compared with `target1` nanoseconds. 
+If the target is missed while batches are dispatched on time out, inputs arrive 
+too slowly to fill batches, and the limit is halved. The limit is increased by 
+one up to `max_size1` if the target is met, or if inputs pile up faster than 
+batches are evaluated, so batches grow with the arrival rate. Methods `limit` 
+and `batches` return the current batch limit and the number of dispatched 
+batches.
+
+A batcher must be destroyed outside the workers of its executor. Pending 
+inputs are dispatched before it is destroyed.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+executor executor1;
+batcher<double, double, wrap1_action_tag<double> > batcher1(&executor1,
+	wrap(add, 10.0), 64, 100000, 1000000);
+handle<double> h = batcher1.submit(1.0);
+h.wait(); // => 11.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT, class IN, class TAG>
+class batcher
+{
+class request
+{
+public:
+IN in;
+const_ptr<completion<OUT> > result;
+uint64_t time;
+request* next;
+
+request(const IN& in1, const const_ptr<completion<OUT> >& result1,
+	uint64_t time1)
+	: in(in1)
+	, result(result1)
+	, time(time1)
+	, next(NULL)
+{
+}
+
+};
+
+class batch_job
+	: public job
+{
+batcher<OUT, IN, TAG>* _batcher;
+request* _head;
+
+public:
+batch_job(batcher<OUT, IN, TAG>* batcher1, request* head1)
+	: job(run)
+	, _batcher(batcher1)
+	, _head(head1)
+{
+}
+
+static void
+run(job* job1)
+{
+	batch_job* job2 = static_cast<batch_job*>(job1);
+	batcher<OUT, IN, TAG>* batcher1 = job2->_batcher;
+	request* head = job2->_head;
+	delete job2;
+	batcher1->run_batch(head);
+}
+
+};
+
+enum
+{
+	window = 128
+};
+
+executor* _executor;
+action<OUT, IN, TAG> _f;
+unsigned int _max_size;
+uint64_t _max_wait;
+uint64_t _target;
+
+pthread_mutex_t _mutex;
+pthread_cond_t _cond;
+pthread_t _thread;
+bool _started;
+bool _stopped;
+
+request* _head;
+request* _tail;
+unsigned int _count;
+unsigned int _limit;
+unsigned int _running;
+uint64_t _batches;
+unsigned int _timeouts;
+unsigned int _backlogs;
+uint64_t _latencies[window];
+unsigned int _samples;
+
+public:
+batcher(executor* executor1, const action<OUT, IN, TAG>& f1,
+	unsigned int max_size1, uint64_t max_wait1, uint64_t target1)
+	: _executor(executor1)
+	, _f(f1)
+	, _max_size(max_size1 ? max_size1 : 1)
+	, _max_wait(max_wait1)
+	, _target(target1)
+	, _started(false)
+	, _stopped(false)
+	, _head(NULL)
+	, _tail(NULL)
+	, _count(0)
+	, _limit(_max_size)
+	, _running(0)
+	, _batches(0)
+	, _timeouts(0)
+	, _backlogs(0)
+	, _samples(0)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_cond, &attr);
+	pthread_condattr_destroy(&attr);
+
+	_started = pthread_create(&_thread, NULL, loop, this) == 0;
+}
+
+~batcher()
+{
+	pthread_mutex_lock(&_mutex);
+	_stopped = true;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_mutex);
+
+	if (_started) {
+		pthread_join(_thread, NULL);
+	}
+
+	pthread_mutex_lock(&_mutex);
+	while (_running > 0) {
+		pthread_cond_wait(&_cond, &_mutex);
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	pthread_cond_destroy(&_cond);
+	pthread_mutex_destroy(&_mutex);
+}
+
+unsigned int
+limit()
+{
+	pthread_mutex_lock(&_mutex);
+	unsigned int limit1 = _limit;
+	pthread_mutex_unlock(&_mutex);
+
+	return limit1;
+}
+
+uint64_t
+batches()
+{
+	pthread_mutex_lock(&_mutex);
+	uint64_t batches1 = _batches;
+	pthread_mutex_unlock(&_mutex);
+
+	return batches1;
+}
+
+handle<OUT>
+submit(const IN& in1)
+{
+	mutable_ptr<completion<OUT> > completion1(
+		new (std::nothrow) completion<OUT>());
+	if (!completion1.get()) {
+		return handle<OUT> (completion1.build());
+	}
+
+	completion1->reset(_executor, 1);
+	if (!_started) {
+		completion1->set(_f(in1));
+		completion1->finish();
+		return handle<OUT> (completion1.build());
+	}
+
+	request* request1 = new (std::nothrow) request(in1, completion1.build(),
+		now());
+	if (!request1) {
+		return handle<OUT> (mutable_ptr<completion<OUT> > (
+				(completion<OUT>*) NULL).build());
+	}
+
+	pthread_mutex_lock(&_mutex);
+	if (_tail) {
+		_tail->next = request1;
+	}
+	else {
+		_head = request1;
+	}
+
+	_tail = request1;
+	_count++;
+	if (_count == 1 || _count >= _limit) {
+		pthread_cond_signal(&_cond);
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return handle<OUT> (completion1.build());
+}
+
+private:
+static uint64_t
+now()
+{
+	timespec time1;
+	clock_gettime(CLOCK_MONOTONIC, &time1);
+
+	return time1.tv_sec * 1000000000ull + time1.tv_nsec;
+}
+
+static void*
+loop(void* batcher1)
+{
+	batcher<OUT, IN, TAG>* batcher2 = (batcher<OUT, IN, TAG>*) batcher1;
+	pthread_mutex_t* mutex = &batcher2->_mutex;
+
+	pthread_mutex_lock(mutex);
+	for (;;) {
+		while (!batcher2->_stopped && batcher2->_count == 0) {
+			pthread_cond_wait(&batcher2->_cond, mutex);
+		}
+
+		if (batcher2->_count == 0) {
+			break;
+		}
+
+		uint64_t deadline = batcher2->_head->time + batcher2->_max_wait;
+		while (!batcher2->_stopped && batcher2->_count < batcher2->_limit &&
+			now() < deadline) {
+			timespec time1;
+			time1.tv_sec = deadline / 1000000000ull;
+			time1.tv_nsec = deadline % 1000000000ull;
+			pthread_cond_timedwait(&batcher2->_cond, mutex, &time1);
+		}
+
+		if (batcher2->_count < batcher2->_limit) {
+			batcher2->_timeouts++;
+		}
+		else if (batcher2->_count > batcher2->_limit) {
+			batcher2->_backlogs++;
+		}
+
+		request* head = batcher2->_head;
+		request* tail = head;
+		unsigned int size = 1;
+		while (size < batcher2->_limit && tail->next) {
+			tail = tail->next;
+			size++;
+		}
+
+		batcher2->_head = tail->next;
+		if (!batcher2->_head) {
+			batcher2->_tail = NULL;
+		}
+
+		tail->next = NULL;
+		batcher2->_count -= size;
+		batcher2->_running++;
+		batcher2->_batches++;
+		pthread_mutex_unlock(mutex);
+
+		batch_job* job1 = new (std::nothrow) batch_job(batcher2, head);
+		if (!job1) {
+			batcher2->run_batch(head);
+		}
+		else {
+			batcher2->_executor->schedule(job1);
+		}
+
+		pthread_mutex_lock(mutex);
+	}
+	pthread_mutex_unlock(mutex);
+
+	return NULL;
+}
+
+void
+run_batch(request* head1)
+{
+	for (request* request1 = head1; request1; request1 = request1->next) {
+		mutable_ptr<completion<OUT> > completion1(request1->result);
+		completion1->set(_f(request1->in));
+	}
+
+	uint64_t time1 = now();
+	uint64_t latencies[window];
+	unsigned int size = 0;
+	while (head1) {
+		request* request1 = head1;
+		head1 = head1->next;
+		if (size < window) {
+			latencies[size++] = time1 - request1->time;
+		}
+
+		mutable_ptr<completion<OUT> > completion1(request1->result);
+		delete request1;
+		completion1->finish();
+	}
+
+	pthread_mutex_lock(&_mutex);
+	for (unsigned int i = 0; i < size; i++) {
+		_latencies[_samples++] = latencies[i];
+		if (_samples == window) {
+			adapt();
+		}
+	}
+
+	_running--;
+	if (_running == 0 && _stopped) {
+		pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_mutex);
+}
+
+void
+adapt()
+{
+	uint64_t* p99 = _latencies + window * 99 / 100;
+	std::nth_element(_latencies, p99, _latencies + window);
+	if (*p99 > _target && _timeouts > 0) {
+		_limit = _limit > 1 ? _limit / 2 : 1;
+	}
+	else if ((*p99 <= _target || _backlogs > 0) && _limit < _max_size) {
+		_limit++;
+	}
+
+	_samples = 0;
+	_timeouts = 0;
+	_backlogs = 0;
+}
+
+batcher(const batcher<OUT, IN, TAG>&);
+
+batcher<OUT, IN, TAG>& operator=(const batcher<OUT, IN, TAG>&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,436 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/checkpoint.hh`
+
+This file consists of class templates <<offset_ptr>>, <<checkpoint_image>> and 
+class <<checkpoint_writer>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CHECKPOINT_HH
+#define HACTAR_CHECKPOINT_HH
+
+#include "const_ptr.hh"
+#include "mapped_file.hh"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[offset_ptr]] class template `offset_ptr`
+
+Class template `offset_ptr` is a pointer stored as the distance from itself to 
+the object, so that a graph of objects linked by `offset_ptr`s could be mapped 
+at any address without relocation. A NULL `offset_ptr` has a distance of 0, 
+and an `offset_ptr` could not be copied, since a copy would point elsewhere.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T>
+class offset_ptr
+{
+int64_t _offset;
+
+public:
+offset_ptr()
+	: _offset(0)
+{
+}
+
+const T*
+get() const
+{
+	return _offset ? (const T*) ((const char*) this + _offset) : NULL;
+}
+
+const T*
+operator->() const
+{
+	return get();
+}
+
+const T&
+operator[](size_t i) const
+{
+	return get()[i];
+}
+
+private:
+friend class checkpoint_writer;
+
+offset_ptr(const offset_ptr<T>&);
+
+offset_ptr<T>& operator=(const offset_ptr<T>&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[checkpoint_writer]] class `checkpoint_writer`
+
+Class `checkpoint_writer` writes a graph of `const_ptr` objects into an image, 
+where every object is converted into a plain record linked by `offset_ptr`s. 
+Objects shared by several `const_ptr`s are written once, as they are identified 
+by their addresses.
+
+Method `put` writes the object of a `const_ptr` by calling function 
+`checkpoint(writer1, object1)`, found by argument dependent lookup for the type 
+of the object, and returns the offset of its record, or 0 for a NULL 
+`const_ptr`. Function `checkpoint` puts the children of the object first, then 
+allocates its record by method `allocate`, fills the values, links the children 
+by method `link`, and returns the offset of the record by method `offset`. A 
+record returned by `allocate` is only valid until the next allocation. Graphs 
+are written recursively, so the depth of a graph is bounded by the stack.
+
+Method `save` writes the image to a file with a root record. Method `valid` 
+returns false if memory could not be allocated, in which case `allocate` 
+returns NULL, `put` returns 0 and `save` fails.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+struct node_image { double value; offset_ptr<node_image> next; };
+
+size_t checkpoint(checkpoint_writer& writer1, const node& node1)
+{
+	size_t next = writer1.put(node1.next());
+	node_image* image1 = writer1.allocate<node_image>();
+	if (!image1) {
+		return 0;
+	}
+
+	image1->value = node1.value();
+	writer1.link(image1->next, next);
+	return writer1.offset(image1);
+}
+
+checkpoint_writer writer1;
+writer1.save("node.image", writer1.put(root));
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct checkpoint_header
+{
+char magic[8];
+uint64_t version;
+uint64_t size;
+uint64_t root;
+};
+
+class checkpoint_writer
+{
+char* _data;
+size_t _size;
+size_t _capacity;
+
+struct entry
+{
+const void* key;
+size_t offset;
+};
+
+entry* _entries;
+size_t _count;
+size_t _buckets;
+bool _valid;
+
+public:
+checkpoint_writer()
+	: _data(NULL)
+	, _size(sizeof(checkpoint_header))
+	, _capacity(0)
+	, _entries(NULL)
+	, _count(0)
+	, _buckets(0)
+	, _valid(true)
+{
+}
+
+~checkpoint_writer()
+{
+	free(_data);
+	free(_entries);
+}
+
+bool
+valid() const
+{
+	return _valid;
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+template<class T>
+size_t
+put(const const_ptr<T>& const_ptr1)
+{
+	const T* ptr = const_ptr1.get();
+	if (!ptr || !_valid) {
+		return 0;
+	}
+
+	entry* entry1 = find(ptr);
+	if (entry1 && entry1->key) {
+		return entry1->offset;
+	}
+
+	size_t offset1 = checkpoint(*this, *ptr);
+	if (!offset1 || !_valid) {
+		_valid = false;
+		return 0;
+	}
+
+	entry1 = insert(ptr);
+	if (entry1) {
+		entry1->offset = offset1;
+	}
+
+	return offset1;
+}
+
+template<class I>
+I*
+allocate(size_t size1 = 1)
+{
+	size_t offset1 = (_size + alignof(I) - 1) & ~(alignof(I) - 1);
+	if (!reserve(offset1 + size1 * sizeof(I))) {
+		return NULL;
+	}
+
+	memset(_data + offset1, 0, size1 * sizeof(I));
+	_size = offset1 + size1 * sizeof(I);
+
+	I* image1 = (I*) (_data + offset1);
+	for (size_t i = 0; i < size1; i++) {
+		new (image1 + i) I();
+	}
+
+	return image1;
+}
+
+template<class I>
+size_t
+offset(const I* image1) const
+{
+	return image1 ? (const char*) image1 - _data : 0;
+}
+
+template<class I>
+void
+link(offset_ptr<I>& ptr1, size_t offset1) const
+{
+	ptr1._offset = offset1 ? (int64_t) offset1 - offset(&ptr1) : 0;
+}
+
+bool
+save(const char* path1, size_t root1)
+{
+	if (!_valid || !reserve(_size)) {
+		return false;
+	}
+
+	checkpoint_header* header = (checkpoint_header*) _data;
+	memcpy(header->magic, "HACIMAGE", sizeof(header->magic));
+	header->version = 1;
+	header->size = _size;
+	header->root = root1;
+
+	mapped_file file(path1, _size);
+	if (!file.valid()) {
+		return false;
+	}
+
+	memcpy(file.data(), _data, _size);
+
+	return msync(file.data(), _size, MS_SYNC) == 0;
+}
+
+private:
+checkpoint_writer(const checkpoint_writer&);
+
+checkpoint_writer&
+operator=(const checkpoint_writer&);
+
+bool
+reserve(size_t size1)
+{
+	if (size1 <= _capacity) {
+		return _valid;
+	}
+
+	size_t capacity1 = _capacity ? _capacity : 4096;
+	while (capacity1 < size1) {
+		capacity1 *= 2;
+	}
+
+	char* data1 = (char*) realloc(_data, capacity1);
+	if (!data1) {
+		_valid = false;
+		return false;
+	}
+
+	_data = data1;
+	_capacity = capacity1;
+
+	return _valid;
+}
+
+static size_t
+hash(const void* key1)
+{
+	uint64_t key = (uintptr_t) key1;
+	key ^= key >> 33;
+	key *= 0xff51afd7ed558ccdULL;
+	key ^= key >> 33;
+
+	return key;
+}
+
+entry*
+find(const void* key1) const
+{
+	if (!_buckets) {
+		return NULL;
+	}
+
+	size_t i = hash(key1) & (_buckets - 1);
+	while (_entries[i].key && _entries[i].key != key1) {
+		i = (i + 1) & (_buckets - 1);
+	}
+
+	return &_entries[i];
+}
+
+entry*
+insert(const void* key1)
+{
+	if ((_count + 1) * 2 > _buckets) {
+		size_t buckets1 = _buckets ? _buckets * 2 : 1024;
+		entry* entries1 = (entry*) calloc(buckets1, sizeof(entry));
+		if (!entries1) {
+			return NULL;
+		}
+
+		entry* entries = _entries;
+		size_t buckets = _buckets;
+		_entries = entries1;
+		_buckets = buckets1;
+		for (size_t i = 0; i < buckets; i++) {
+			if (entries[i].key) {
+				*find(entries[i].key) = entries[i];
+			}
+		}
+
+		free(entries);
+	}
+
+	entry* entry1 = find(key1);
+	entry1->key = key1;
+	_count++;
+
+	return entry1;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[checkpoint_image]] class template `checkpoint_image`
+
+Class template `checkpoint_image` maps an image saved by `checkpoint_writer` 
+read-only, and returns the root record of type `I` by method `root`, with no 
+deserialization. Records are read through `offset_ptr`s in place, and pages are 
+loaded on demand from the file, or shared from the page cache by processes 
+mapping the same image. Method `valid` returns false if the file could 
+not be mapped or is not an image.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+checkpoint_image<node_image> image1("node.image");
+image1.root()->next->value;
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class I>
+class checkpoint_image
+{
+mapped_file _file;
+
+public:
+explicit
+checkpoint_image(const char* path1)
+	: _file(path1)
+{
+	if (_file.data()) {
+		madvise(_file.data(), _file.size(), MADV_NORMAL);
+	}
+}
+
+bool
+valid() const
+{
+	const checkpoint_header* header = (const checkpoint_header*) _file.data();
+
+	return _file.valid() && _file.size() >= sizeof(checkpoint_header) &&
+		memcmp(header->magic, "HACIMAGE", sizeof(header->magic)) == 0 &&
+		header->version == 1 && header->size == _file.size() &&
+		header->root + sizeof(I) <= header->size;
+}
+
+const I*
+root() const
+{
+	if (!valid()) {
+		return NULL;
+	}
+
+	const checkpoint_header* header = (const checkpoint_header*) _file.data();
+
+	return header->root ? (const I*) ((const char*) _file.data() +
+		header->root) : NULL;
+}
+
+private:
+checkpoint_image(const checkpoint_image<I>&);
+
+checkpoint_image<I>&
+operator=(const checkpoint_image<I>&);
+
+};
+
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,744 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/exec_test.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "exec_test.h"
+
+#include "hactar.hh"
+#include "executor.hh"
+#include "pipeline.hh"
+#include "parallel_action.hh"
+#include "reactor.hh"
+#include "batcher.hh"
+#include "mapped_file.hh"
+#include "checkpoint.hh"
+#include "state_store.hh"
+#ifdef __cpp_impl_coroutine
+#include "async_action.hh"
+#endif
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <iostream>
+#include <vector>
+
+namespace hactar {
+
+class counter
+{
+std::atomic<size_t> _rc;
+double _value;
+
+public:
+counter()
+	: _rc(0)
+	, _value(0)
+{
+}
+
+bool
+retain()
+{
+	return _rc.fetch_add(1) + 1;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1) - 1;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+void
+set_value(const double& in1)
+{
+	_value = in1;
+}
+
+private:
+counter(const counter&);
+
+counter& operator=(const counter&);
+
+};
+
+template<>
+const_ptr<counter>
+unit(const double& in1)
+{
+	mutable_ptr<counter> mutable_ptr1;
+	mutable_ptr1->set_value(in1);
+
+	return mutable_ptr1.build();
+}
+
+template<class TAG>
+const_ptr<counter>
+operator&(const const_ptr<counter>& const_ptr1,
+	const action<double, double, TAG>& f1)
+{
+	if (const_ptr1.get() == NULL) {
+		return const_ptr1;
+	}
+
+	return unit<counter> (f1(const_ptr1->value()));
+}
+
+double
+increase(const double& x, double y)
+{
+	return x + y;
+}
+
+double
+spawn(const double& x, executor* executor1)
+{
+	return executor1->submit(wrap(increase, 1.0) * 10, x).wait();
+}
+
+double
+hold(const double& x, std::atomic<int>* state1)
+{
+	state1->store(1);
+	while (state1->load() != 2) {
+		sched_yield();
+	}
+
+	return x;
+}
+
+int
+executor_test()
+{
+	int result = 0;
+	executor executor1(4, 16);
+
+	std::vector<handle<double> > handles;
+	for (int i = 0; i < 1000; i++) {
+		handles.push_back(executor1.submit(wrap(increase, 1.0) * 10,
+				(double) i));
+	}
+
+	for (int i = 0; i < 100; i++) {
+		handles.push_back(executor1.submit(wrap(spawn, &executor1),
+				(double) i));
+	}
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		if (handles[i].wait() != (i % 1000) + 10.0) {
+			result = 1;
+		}
+	}
+
+	std::vector<double> in(10000);
+	std::vector<double> out(10000);
+	for (size_t i = 0; i < in.size(); i++) {
+		in[i] = i;
+	}
+
+	executor1.submit(wrap(increase, 2.0), in.data(), out.data(),
+		in.size()).wait();
+	for (size_t i = 0; i < out.size(); i++) {
+		if (out[i] != i + 2.0) {
+			result = 1;
+		}
+	}
+
+	const_ptr<counter> state = executor1.submit(unit<counter> (1.0),
+		wrap(increase, 1.0) & wrap(increase, 2.0)).wait();
+	std::cout << state->value() << std::endl;
+	if (state->value() != 4.0) {
+		result = 1;
+	}
+
+	uint64_t pushed = 0;
+	uint64_t executed = 0;
+	for (unsigned int i = 0; i < executor1.size(); i++) {
+		executor_stats stats = executor1.stats(i);
+		std::cout << i << "\t" << stats.pushed << "\t" << stats.executed <<
+			"\t" << stats.stolen << "\t" << stats.inlined << "\t" <<
+			stats.sleeps << std::endl;
+		pushed += stats.pushed;
+		executed += stats.executed;
+	}
+
+	if (pushed != executed) {
+		result = 1;
+	}
+
+	if (executor1.stats(executor1.size()).pushed != 0) {
+		result = 1;
+	}
+
+	return result;
+}
+
+int
+backpressure_test()
+{
+	int result = 0;
+	executor executor1(1, 1);
+	std::atomic<int> state(0);
+
+	handle<double> h1 = executor1.try_submit(wrap(hold, &state), 1.0);
+	while (state.load() != 1) {
+		sched_yield();
+	}
+
+	handle<double> h2 = executor1.try_submit(wrap(increase, 1.0), 2.0);
+	handle<double> h3 = executor1.try_submit(wrap(increase, 1.0), 3.0);
+	std::cout << h1.valid() << "\t" << h2.valid() << "\t" << h3.valid() <<
+		std::endl;
+	if (!h1.valid() || !h2.valid() || h3.valid()) {
+		result = 1;
+	}
+
+	state.store(2);
+	if (h1.wait() != 1.0 || h2.wait() != 3.0 || !h3.done() ||
+		h3.wait() != 0.0) {
+		result = 1;
+	}
+
+	return result;
+}
+
+double
+scale(const double& x, double y)
+{
+	double out = x;
+	for (int i = 0; i < 16; i++) {
+		out = out * y + 0.5;
+	}
+
+	return out;
+}
+
+int
+pipeline_test()
+{
+	int result = 0;
+	action<double, double, complex_action_tag<double, wrap1_action_tag<double>,
+		wrap1_action_tag<double> > > f = wrap(increase, 1.0) &
+		wrap(scale, 0.5) & wrap(increase, 2.0) & wrap(increase, 3.0) &
+		wrap(scale, 0.25) & wrap(increase, 4.0) & wrap(increase, 5.0) &
+		wrap(increase, 6.0);
+
+	pipeline<double> pipeline1(3, 16, 64);
+	pipeline1.add(f);
+
+	std::vector<double> in(10000);
+	std::vector<double> out(10000);
+	for (size_t i = 0; i < in.size(); i++) {
+		in[i] = i;
+	}
+
+	pipeline1.balance(in.data(), 1000);
+	std::cout << pipeline1.size() << "\t" << pipeline1.bound(1) << "\t" <<
+		pipeline1.bound(2) << std::endl;
+
+	pipeline1.run(in.data(), out.data(), in.size());
+	for (size_t i = 0; i < in.size(); i++) {
+		if (out[i] != f(in[i])) {
+			result = 1;
+		}
+	}
+
+	if (pipeline1.size() != 8 || pipeline1.bound(3) != 8) {
+		result = 1;
+	}
+
+	return result;
+}
+
+double
+sum(const double& x, const double& y)
+{
+	return x + y;
+}
+
+double
+last(const double& x, const double& y)
+{
+	return y;
+}
+
+int
+parallel_test()
+{
+	int result = 0;
+	executor executor1(4, 16);
+	executor executor2(1, 16);
+
+	std::vector<double> in(10000);
+	for (size_t i = 0; i < in.size(); i++) {
+		in[i] = 1.0 / (i + 1);
+	}
+
+	span<double> span1(in.data(), in.size());
+	const_queue<double> queue1 = map<span> (&executor1, wrap(increase, 2.0))(
+		span1);
+	for (size_t i = 0; i < in.size(); i++) {
+		if (queue1.size() != in.size() || queue1[i] != in[i] + 2.0) {
+			result = 1;
+		}
+	}
+
+	double out1 = (map(&executor1, wrap(increase, -2.0)) &
+		reduce(&executor1, join(sum), 0.0))(queue1);
+	double out2 = ordered_reduce<span> (&executor1, wrap(increase, 0.0),
+		join(sum), 0.0, 100)(span1);
+	double out3 = ordered_reduce<span> (&executor2, wrap(increase, 0.0),
+		join(sum), 0.0, 100)(span1);
+	double out4 = ordered_reduce(&executor1, join(last), -1.0, 7)(queue1);
+	double out5 = reduce(&executor1, join(sum), 1.0)(const_queue<double> ());
+	std::cout << out1 << "\t" << out2 << "\t" << out4 << std::endl;
+
+	if (out1 < out2 - 1e-9 || out1 > out2 + 1e-9 || out2 != out3 ||
+		out4 != queue1[queue1.size() - 1] || out5 != 1.0) {
+		result = 1;
+	}
+
+	return result;
+}
+
+int
+batcher_test()
+{
+	int result = 0;
+	executor executor1(2, 16);
+	std::vector<handle<double> > handles;
+	unsigned int limit = 0;
+	uint64_t batches = 0;
+
+	{
+		batcher<double, double, wrap1_action_tag<double> > batcher1(
+			&executor1, wrap(increase, 1.0), 16, 200000, 1000000000);
+		for (int i = 0; i < 1000; i++) {
+			handles.push_back(batcher1.submit((double) i));
+		}
+
+		for (size_t i = 0; i < handles.size(); i++) {
+			if (!handles[i].valid() || handles[i].wait() != i + 1.0) {
+				result = 1;
+			}
+		}
+
+		handles.push_back(batcher1.submit(-1.0));
+		limit = batcher1.limit();
+		batches = batcher1.batches();
+	}
+
+	batcher<double, double, wrap1_action_tag<double> > batcher2(&executor1,
+		wrap(increase, 1.0), 16, 200000, 1);
+	for (int i = 0; i < 1000; i++) {
+		batcher2.submit((double) i).wait();
+	}
+
+	std::cout << limit << "\t" << batches << "\t" << batcher2.limit() <<
+		std::endl;
+	if (handles.back().wait() != 0.0 || limit != 16 || batches >= 1000 ||
+		batcher2.limit() != 1) {
+		result = 1;
+	}
+
+	return result;
+}
+
+int
+mapped_file_test()
+{
+	int result = 0;
+	executor executor1(2);
+
+	{
+		mapped_file in("exec_test.in", 100000 * sizeof(double));
+		if (!in.valid()) {
+			return 1;
+		}
+
+		for (int i = 0; i < 100000; i++) {
+			((double*) in.data())[i] = i;
+		}
+	}
+
+	ssize_t size1 = map_file(&executor1, wrap(increase, 1.0), "exec_test.in",
+		"exec_test.out", 1000);
+	mapped_file out("exec_test.out");
+	if (size1 != 100000 || out.size() != 100000 * sizeof(double)) {
+		result = 1;
+	}
+
+	for (ssize_t i = 0; !result && i < size1; i++) {
+		if (((const double*) out.data())[i] != i + 1.0) {
+			result = 1;
+		}
+	}
+
+	ssize_t size2 = map_file(&executor1, wrap(increase, 1.0),
+		"exec_test.out", "exec_test.out");
+	mapped_file same("exec_test.out");
+	std::cout << size1 << "\t" << size2 << "\t" << map_file(&executor1,
+		wrap(increase, 1.0), "exec_test.none", "exec_test.out") << std::endl;
+	if (size2 != -1 || same.size() != 100000 * sizeof(double)) {
+		result = 1;
+	}
+	remove("exec_test.in");
+	remove("exec_test.out");
+
+	return result;
+}
+
+class tree
+{
+std::atomic<size_t> _rc;
+double _value;
+const_ptr<tree> _left;
+const_ptr<tree> _right;
+
+public:
+tree(double value1, const const_ptr<tree>& left1,
+	const const_ptr<tree>& right1)
+	: _rc(0)
+	, _value(value1)
+	, _left(left1)
+	, _right(right1)
+{
+}
+
+bool
+retain()
+{
+	return _rc.fetch_add(1) + 1;
+}
+
+bool
+release()
+{
+	return _rc.fetch_sub(1) - 1;
+}
+
+double
+value() const
+{
+	return _value;
+}
+
+const const_ptr<tree>&
+left() const
+{
+	return _left;
+}
+
+const const_ptr<tree>&
+right() const
+{
+	return _right;
+}
+
+private:
+tree(const tree&);
+
+tree& operator=(const tree&);
+
+};
+
+struct tree_image
+{
+double value;
+offset_ptr<tree_image> left;
+offset_ptr<tree_image> right;
+};
+
+size_t
+checkpoint(checkpoint_writer& writer1, const tree& tree1)
+{
+	size_t left = writer1.put(tree1.left());
+	size_t right = writer1.put(tree1.right());
+	tree_image* image1 = writer1.allocate<tree_image>();
+	if (!image1) {
+		return 0;
+	}
+
+	image1->value = tree1.value();
+	writer1.link(image1->left, left);
+	writer1.link(image1->right, right);
+
+	return writer1.offset(image1);
+}
+
+double
+sum(const tree_image* image1)
+{
+	if (!image1) {
+		return 0.0;
+	}
+
+	return image1->value + sum(image1->left.get()) + sum(image1->right.get());
+}
+
+int
+checkpoint_test()
+{
+	int result = 0;
+	const_ptr<tree> none = mutable_ptr<tree>((tree*) NULL).build();
+	const_ptr<tree> shared = mutable_ptr<tree>(new (std::nothrow) tree(1.0,
+			none, none)).build();
+	const_ptr<tree> left = mutable_ptr<tree>(new (std::nothrow) tree(2.0,
+			shared, none)).build();
+	const_ptr<tree> root = mutable_ptr<tree>(new (std::nothrow) tree(3.0,
+			left, shared)).build();
+
+	{
+		checkpoint_writer writer1;
+		size_t root1 = writer1.put(root);
+		if (writer1.size() != sizeof(checkpoint_header) +
+			3 * sizeof(tree_image) || !writer1.save("exec_test.image", root1)) {
+			result = 1;
+		}
+	}
+
+	checkpoint_image<tree_image> image1("exec_test.image");
+	const tree_image* root1 = image1.root();
+	std::cout << sum(root1) << std::endl;
+	if (!root1 || sum(root1) != 7.0 ||
+		root1->right.get() != root1->left->left.get() ||
+		checkpoint_image<tree_image>("exec_test.none").root() != NULL) {
+		result = 1;
+	}
+
+	remove("exec_test.image");
+
+	return result;
+}
+
+double
+bump(const double& key, state_store<int, counter>* store1)
+{
+	double updated = 0;
+	for (int i = 0; i < 10; i++) {
+		updated += store1->update((int) key, wrap(increase, 1.0));
+	}
+
+	return updated;
+}
+
+double
+sweep(const double& rounds, state_store<int, counter>* store1)
+{
+	double updated = 0;
+	for (int i = 0; i < rounds; i++) {
+		for (int j = 0; j < 64; j++) {
+			updated += store1->update(j, wrap(increase, 1.0));
+		}
+	}
+
+	return updated;
+}
+
+int
+state_store_test()
+{
+	int result = 0;
+	state_store<int, counter> store1(10);
+	if (!store1.valid() || store1.shards() != 16) {
+		return 1;
+	}
+
+	for (int i = 0; i < 64; i++) {
+		store1.set(i, unit<counter> (0.0));
+	}
+
+	executor executor1(4, 16);
+	std::vector<handle<double> > handles;
+	for (int i = 0; i < 256; i++) {
+		handles.push_back(executor1.submit(wrap(bump, &store1),
+				(double) (i % 64)));
+	}
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		if (handles[i].wait() != 10.0) {
+			result = 1;
+		}
+	}
+
+	for (int i = 0; i < 64; i++) {
+		if (store1.find(i)->value() != 40.0) {
+			result = 1;
+		}
+	}
+
+	handle<double> handle1 = executor1.submit(wrap(sweep, &store1), 200.0);
+	size_t snapshots = 0;
+	do {
+		state_snapshot<int, counter> snapshot1 = store1.snapshot();
+		double values[64];
+		snapshot1.visit([&](const int& key, const const_ptr<counter>& state) {
+				values[key] = state->value();
+			});
+		for (int i = 1; i < 64; i++) {
+			if (values[i] > values[i - 1] || values[0] - values[i] > 1.0) {
+				result = 1;
+			}
+		}
+
+		if (!snapshot1.valid() || snapshot1.size() != 64) {
+			result = 1;
+		}
+
+		snapshots++;
+	} while (!handle1.done());
+
+	std::cout << handle1.wait() << "\t" << snapshots << "\t" <<
+		store1.find(63)->value() << std::endl;
+	if (handle1.wait() != 200.0 * 64 || store1.find(63)->value() != 240.0) {
+		result = 1;
+	}
+
+	state_snapshot<int, counter> snapshot2 = store1.snapshot();
+	if (!store1.erase(1) || store1.erase(1) || store1.find(1).get() ||
+		store1.update(1, wrap(increase, 1.0)) || !snapshot2.find(1) ||
+		(*snapshot2.find(1))->value() != 240.0 ||
+		store1.snapshot().size() != 63) {
+		result = 1;
+	}
+
+	return result;
+}
+
+#ifdef __cpp_impl_coroutine
+task<double>
+receive(const int& fd, reactor* reactor1)
+{
+	double x = 0;
+	size_t size = 0;
+	while (size < sizeof(x)) {
+		ssize_t size1 = co_await read_some(reactor1, fd, (char*) &x + size,
+			sizeof(x) - size);
+		if (size1 <= 0) {
+			co_return -1.0;
+		}
+
+		size += size1;
+	}
+
+	co_return x;
+}
+
+task<double>
+hop(const double& x, reactor* reactor1)
+{
+	co_await resume_on(reactor1->owner());
+	co_return x + 1.0;
+}
+
+task<double>
+skip(const double& x, reactor* reactor1)
+{
+	co_return x - 1.0;
+}
+
+int
+async_test()
+{
+	int result = 0;
+	executor executor1(2, 16);
+	reactor reactor1(&executor1);
+	if (!reactor1.valid()) {
+		return 1;
+	}
+
+	std::vector<int> fds(200);
+	for (size_t i = 0; i < fds.size(); i += 2) {
+		if (pipe2(&fds[i], O_NONBLOCK) < 0) {
+			return 1;
+		}
+	}
+
+	std::vector<handle<double> > handles;
+	for (size_t i = 0; i < fds.size(); i += 2) {
+		handles.push_back(start(&executor1, wrap(receive, &reactor1) &
+				wrap(increase, 1.0) & (wrap(hop, &reactor1) * 10), fds[i]));
+	}
+
+	for (size_t i = fds.size(); i > 0; i -= 2) {
+		double x = i / 2 - 1;
+		if (write(fds[i - 1], &x, sizeof(x)) != sizeof(x)) {
+			result = 1;
+		}
+	}
+
+	for (size_t i = 0; i < handles.size(); i++) {
+		if (!handles[i].valid() || handles[i].wait() != i + 11.0) {
+			result = 1;
+		}
+	}
+
+	double out1 = start(&executor1, wrap(skip, &reactor1) |
+			wrap(hop, &reactor1), 1.0).wait();
+	double out2 = start(&executor1, wrap(increase, 1.0) &
+			wrap(hop, &reactor1), 1.0).wait();
+	std::cout << handles[99].wait() << "\t" << out1 << "\t" << out2 <<
+		std::endl;
+	if (out1 != 0.0 || out2 != 3.0) {
+		result = 1;
+	}
+
+	for (size_t i = 0; i < fds.size(); i++) {
+		close(fds[i]);
+	}
+
+	return result;
+}
+#endif
+
+}
+
+int
+hactar::exec_test(int argc, const char* argv[])
+{
+	int result = 0;
+
+	result |= executor_test();
+	result |= backpressure_test();
+	result |= pipeline_test();
+	result |= parallel_test();
+	result |= batcher_test();
+	result |= mapped_file_test();
+	result |= checkpoint_test();
+	result |= state_store_test();
+#ifdef __cpp_impl_coroutine
+	result |= async_test();
+#endif
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,503 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/executor.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "executor.hh"
+
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace hactar {
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[executor_deque]] class `executor_deque`
+
+Class `executor_deque` is a bounded ring buffer of jobs guarded by a spin lock. 
+The owner worker pushes and pops jobs at the bottom, and other workers steal 
+jobs from the top.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class executor_deque
+{
+job** _jobs;
+size_t _mask;
+std::atomic<size_t> _top;
+std::atomic<size_t> _bottom;
+std::atomic_flag _lock;
+
+public:
+executor_deque()
+	: _jobs(NULL)
+	, _mask(0)
+	, _top(0)
+	, _bottom(0)
+{
+	_lock.clear();
+}
+
+~executor_deque()
+{
+	free(_jobs);
+}
+
+bool
+init(size_t capacity1)
+{
+	_jobs = (job**) malloc(capacity1 * sizeof(job*));
+	_mask = capacity1 - 1;
+
+	return _jobs != NULL;
+}
+
+size_t
+size() const
+{
+	return _bottom.load(std::memory_order_relaxed) -
+		_top.load(std::memory_order_relaxed);
+}
+
+bool
+push(job* job1)
+{
+	lock();
+	size_t bottom = _bottom.load(std::memory_order_relaxed);
+	bool is_pushed = bottom - _top.load(std::memory_order_relaxed) <= _mask;
+	if (is_pushed) {
+		_jobs[bottom & _mask] = job1;
+		_bottom.store(bottom + 1, std::memory_order_relaxed);
+	}
+	unlock();
+
+	return is_pushed;
+}
+
+job*
+pop()
+{
+	if (size() == 0) {
+		return NULL;
+	}
+
+	job* job1 = NULL;
+	lock();
+	size_t bottom = _bottom.load(std::memory_order_relaxed);
+	if (bottom != _top.load(std::memory_order_relaxed)) {
+		job1 = _jobs[(bottom - 1) & _mask];
+		_bottom.store(bottom - 1, std::memory_order_relaxed);
+	}
+	unlock();
+
+	return job1;
+}
+
+job*
+steal()
+{
+	if (size() == 0) {
+		return NULL;
+	}
+
+	job* job1 = NULL;
+	lock();
+	size_t top = _top.load(std::memory_order_relaxed);
+	if (top != _bottom.load(std::memory_order_relaxed)) {
+		job1 = _jobs[top & _mask];
+		_top.store(top + 1, std::memory_order_relaxed);
+	}
+	unlock();
+
+	return job1;
+}
+
+private:
+void
+lock()
+{
+	for (unsigned int i = 0; _lock.test_and_set(std::memory_order_acquire);
+		i++) {
+		if (i > 64) {
+			sched_yield();
+		}
+	}
+}
+
+void
+unlock()
+{
+	_lock.clear(std::memory_order_release);
+}
+
+executor_deque(const executor_deque&);
+
+executor_deque& operator=(const executor_deque&);
+
+};
+
+struct alignas(64) executor_worker
+{
+executor* owner;
+unsigned int index;
+uint32_t seed;
+pthread_t thread;
+executor_deque deque;
+
+std::atomic<uint64_t> pushed;
+std::atomic<uint64_t> executed;
+std::atomic<uint64_t> stolen;
+std::atomic<uint64_t> inlined;
+std::atomic<uint64_t> sleeps;
+};
+
+static thread_local executor_worker* current_worker = NULL;
+
+static void
+count(std::atomic<uint64_t>& counter1)
+{
+	counter1.store(counter1.load(std::memory_order_relaxed) + 1,
+		std::memory_order_relaxed);
+}
+
+void
+completion_base::finish()
+{
+	if (_pending.fetch_sub(1, std::memory_order_seq_cst) == 1 && _executor) {
+		_executor->notify();
+	}
+}
+
+void
+completion_base::wait() const
+{
+	while (!done()) {
+		if (!_executor->help(*this)) {
+			_executor->block(*this);
+		}
+	}
+}
+
+executor::executor(unsigned int size1, unsigned int capacity1)
+	: _workers(NULL)
+	, _size(0)
+	, _capacity(1)
+	, _next(0)
+	, _queued(0)
+	, _stopped(false)
+	, _work_waiters(0)
+	, _space_waiters(0)
+	, _done_waiters(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+	pthread_cond_init(&_work_cond, NULL);
+	pthread_cond_init(&_space_cond, NULL);
+	pthread_cond_init(&_done_cond, NULL);
+
+	if (size1 == 0) {
+		long cores = sysconf(_SC_NPROCESSORS_ONLN);
+		size1 = cores > 0 ? cores : 1;
+	}
+
+	while (_capacity < capacity1 && _capacity < 1u << 31) {
+		_capacity <<= 1;
+	}
+
+	_workers = new (std::nothrow) executor_worker[size1];
+	if (!_workers) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < size1; i++) {
+		executor_worker& worker = _workers[i];
+		worker.owner = this;
+		worker.index = i;
+		worker.seed = 2654435761u * (i + 1);
+		worker.pushed = 0;
+		worker.executed = 0;
+		worker.stolen = 0;
+		worker.inlined = 0;
+		worker.sleeps = 0;
+		if (!worker.deque.init(_capacity)) {
+			break;
+		}
+
+		_size = i + 1;
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		if (pthread_create(&_workers[i].thread, NULL, work, &_workers[i])) {
+			_size = i;
+			break;
+		}
+	}
+}
+
+executor::~executor()
+{
+	_stopped.store(true);
+
+	pthread_mutex_lock(&_mutex);
+	pthread_cond_broadcast(&_work_cond);
+	pthread_mutex_unlock(&_mutex);
+
+	for (unsigned int i = 0; i < _size; i++) {
+		pthread_join(_workers[i].thread, NULL);
+	}
+
+	delete[] _workers;
+
+	pthread_cond_destroy(&_done_cond);
+	pthread_cond_destroy(&_space_cond);
+	pthread_cond_destroy(&_work_cond);
+	pthread_mutex_destroy(&_mutex);
+}
+
+executor_stats
+executor::stats(unsigned int i) const
+{
+	executor_stats stats1 = executor_stats();
+	if (i >= _size) {
+		return stats1;
+	}
+
+	stats1.pushed = _workers[i].pushed.load(std::memory_order_relaxed);
+	stats1.executed = _workers[i].executed.load(std::memory_order_relaxed);
+	stats1.stolen = _workers[i].stolen.load(std::memory_order_relaxed);
+	stats1.inlined = _workers[i].inlined.load(std::memory_order_relaxed);
+	stats1.sleeps = _workers[i].sleeps.load(std::memory_order_relaxed);
+
+	return stats1;
+}
+
+bool
+executor::push(job* job1, bool block1)
+{
+	executor_worker* worker = current_worker;
+	if (worker && worker->owner != this) {
+		worker = NULL;
+	}
+
+	if (_size == 0) {
+		job1->run();
+		return true;
+	}
+
+	for (;;) {
+		_queued.fetch_add(1, std::memory_order_seq_cst);
+
+		bool is_pushed = false;
+		if (worker && worker->deque.push(job1)) {
+			count(worker->pushed);
+			is_pushed = true;
+		}
+
+		unsigned int next = _next.fetch_add(1, std::memory_order_relaxed);
+		for (unsigned int i = 0; !is_pushed && i < _size; i++) {
+			executor_worker& worker1 = _workers[(next + i) % _size];
+			if (worker1.deque.push(job1)) {
+				count(worker1.pushed);
+				is_pushed = true;
+			}
+		}
+
+		if (is_pushed) {
+			if (_work_waiters.load(std::memory_order_seq_cst) > 0) {
+				pthread_mutex_lock(&_mutex);
+				pthread_cond_signal(&_work_cond);
+				pthread_mutex_unlock(&_mutex);
+			}
+
+			return true;
+		}
+
+		_queued.fetch_sub(1, std::memory_order_seq_cst);
+
+		if (worker) {
+			count(worker->inlined);
+			job1->run();
+			return true;
+		}
+
+		if (!block1) {
+			return false;
+		}
+
+		pthread_mutex_lock(&_mutex);
+		_space_waiters.fetch_add(1, std::memory_order_seq_cst);
+		if (_queued.load(std::memory_order_seq_cst) >=
+			(size_t) _size * _capacity) {
+			pthread_cond_wait(&_space_cond, &_mutex);
+		}
+		_space_waiters.fetch_sub(1, std::memory_order_relaxed);
+		pthread_mutex_unlock(&_mutex);
+	}
+}
+
+job*
+executor::next(executor_worker* worker1)
+{
+	job* job1 = worker1->deque.pop();
+
+	if (!job1 && _size > 1) {
+		worker1->seed ^= worker1->seed << 13;
+		worker1->seed ^= worker1->seed >> 17;
+		worker1->seed ^= worker1->seed << 5;
+
+		unsigned int victim = worker1->seed % _size;
+		for (unsigned int i = 0; !job1 && i < _size; i++) {
+			executor_worker& worker2 = _workers[(victim + i) % _size];
+			if (&worker2 != worker1) {
+				job1 = worker2.deque.steal();
+			}
+		}
+
+		if (job1) {
+			count(worker1->stolen);
+		}
+	}
+
+	if (!job1) {
+		return NULL;
+	}
+
+	_queued.fetch_sub(1, std::memory_order_seq_cst);
+	if (_space_waiters.load(std::memory_order_seq_cst) > 0) {
+		pthread_mutex_lock(&_mutex);
+		pthread_cond_broadcast(&_space_cond);
+		pthread_mutex_unlock(&_mutex);
+	}
+
+	return job1;
+}
+
+bool
+executor::help(const completion_base& completion1)
+{
+	executor_worker* worker = current_worker;
+	if (!worker || worker->owner != this) {
+		return false;
+	}
+
+	job* job1 = next(worker);
+	if (!job1) {
+		return false;
+	}
+
+	count(worker->executed);
+	job1->run();
+
+	return true;
+}
+
+void
+executor::block(const completion_base& completion1)
+{
+	executor_worker* worker = current_worker;
+	if (worker && worker->owner != this) {
+		worker = NULL;
+	}
+
+	pthread_mutex_lock(&_mutex);
+	_done_waiters.fetch_add(1, std::memory_order_seq_cst);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (!completion1.done()) {
+		if (worker) {
+			timespec deadline;
+			clock_gettime(CLOCK_REALTIME, &deadline);
+			deadline.tv_nsec += 1000000;
+			if (deadline.tv_nsec >= 1000000000) {
+				deadline.tv_sec++;
+				deadline.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&_done_cond, &_mutex, &deadline);
+		}
+		else {
+			while (!completion1.done()) {
+				pthread_cond_wait(&_done_cond, &_mutex);
+			}
+		}
+	}
+	_done_waiters.fetch_sub(1, std::memory_order_relaxed);
+	pthread_mutex_unlock(&_mutex);
+}
+
+void
+executor::notify()
+{
+	if (_done_waiters.load(std::memory_order_seq_cst) > 0) {
+		pthread_mutex_lock(&_mutex);
+		pthread_cond_broadcast(&_done_cond);
+		pthread_mutex_unlock(&_mutex);
+	}
+}
+
+void*
+executor::work(void* worker1)
+{
+	executor_worker* worker = (executor_worker*) worker1;
+	executor* executor1 = worker->owner;
+	current_worker = worker;
+
+	for (unsigned int idle = 0; ; ) {
+		job* job1 = executor1->next(worker);
+		if (job1) {
+			count(worker->executed);
+			job1->run();
+			idle = 0;
+			continue;
+		}
+
+		if (executor1->_stopped.load() &&
+			executor1->_queued.load(std::memory_order_seq_cst) == 0) {
+			break;
+		}
+
+		if (++idle < 64) {
+			sched_yield();
+			continue;
+		}
+
+		pthread_mutex_lock(&executor1->_mutex);
+		executor1->_work_waiters.fetch_add(1, std::memory_order_seq_cst);
+		if (executor1->_queued.load(std::memory_order_seq_cst) == 0 &&
+			!executor1->_stopped.load()) {
+			count(worker->sleeps);
+			pthread_cond_wait(&executor1->_work_cond, &executor1->_mutex);
+		}
+		executor1->_work_waiters.fetch_sub(1, std::memory_order_relaxed);
+		pthread_mutex_unlock(&executor1->_mutex);
+		idle = 0;
+	}
+
+	current_worker = NULL;
+
+	return NULL;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
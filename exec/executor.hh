@@ -0,0 +1,665 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/executor.hh`
+
+This file consists of class template <<handle>> and class <<executor>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_EXECUTOR_HH
+#define HACTAR_EXECUTOR_HH
+
+#include "action.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace hactar {
+
+class executor;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[job]] class `job`
+
+Class `job` is a unit of work queued in an `executor`. A job is created on the 
+heap by the executor, and its run function deletes it after running.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class job
+{
+public:
+typedef void (* F)(job*);
+
+job(F run1)
+	: _run(run1)
+{
+}
+
+void
+run()
+{
+	_run(this);
+}
+
+private:
+F _run;
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[completion]] class template `completion`
+
+Class template `completion` keeps the state of submitted jobs. It is reference 
+counted, so it could be shared by `const_ptr` between the executor and 
+<<handle>>s. A completion is done when all of its pending jobs are finished, 
+and `completion<OUT>` keeps the result of type `OUT`.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class completion_base
+{
+std::atomic<size_t> _rc;
+std::atomic<size_t> _pending;
+executor* _executor;
+
+public:
+completion_base()
+	: _rc(0)
+	, _pending(1)
+	, _executor(NULL)
+{
+}
+
+void
+reset(executor* executor1, size_t pending1)
+{
+	_executor = executor1;
+	_pending.store(pending1, std::memory_order_relaxed);
+}
+
+bool
+done() const
+{
+	return _pending.load(std::memory_order_acquire) == 0;
+}
+
+void finish();
+
+void wait() const;
+
+protected:
+bool
+retain_base()
+{
+	return _rc.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+bool
+release_base()
+{
+	return _rc.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+};
+
+template<class OUT>
+class completion
+	: public completion_base
+{
+alignas(OUT) unsigned char _out[sizeof(OUT)];
+bool _has_out;
+
+public:
+completion()
+	: _has_out(false)
+{
+}
+
+~completion()
+{
+	if (_has_out) {
+		get().~OUT();
+	}
+}
+
+bool
+retain()
+{
+	return retain_base();
+}
+
+bool
+release()
+{
+	return release_base();
+}
+
+void
+set(OUT&& out1)
+{
+	new (_out) OUT(std::move(out1));
+	_has_out = true;
+}
+
+const OUT&
+get() const
+{
+	return *(const OUT*) _out;
+}
+
+private:
+completion(const completion<OUT>&);
+
+completion<OUT>& operator=(const completion<OUT>&);
+
+};
+
+template<>
+class completion<void>
+	: public completion_base
+{
+public:
+completion()
+{
+}
+
+bool
+retain()
+{
+	return retain_base();
+}
+
+bool
+release()
+{
+	return release_base();
+}
+
+private:
+completion(const completion<void>&);
+
+completion<void>& operator=(const completion<void>&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[handle]] class template `handle`
+
+Class template `handle` is the completion handle of jobs submitted to an 
+<<executor>>. Method `done` returns true if the jobs are finished, and method 
+`wait` blocks until the jobs are finished and returns the result. Waiting in a 
+job running in the same executor runs other queued jobs instead of blocking.
+
+A handle is invalid if the submission failed, e.g. a bounded queue is full in 
+`executor::try_submit`, or memory could not be allocated. An invalid handle 
+has no jobs to wait for, so `done` returns true at once and `wait` returns a 
+default constructed `OUT`, or an empty `const_ptr`, without blocking.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT>
+struct handle_none
+{
+static const OUT&
+get()
+{
+	static const OUT none = OUT();
+
+	return none;
+}
+
+};
+
+template<class T>
+struct handle_none<const_ptr<T> >
+{
+static const const_ptr<T>&
+get()
+{
+	static const const_ptr<T> none = mutable_ptr<T> ((T*) NULL).build();
+
+	return none;
+}
+
+};
+
+template<class OUT>
+class handle
+{
+const_ptr<completion<OUT> > _completion;
+
+public:
+handle(const const_ptr<completion<OUT> >& completion1)
+	: _completion(completion1)
+{
+}
+
+bool
+valid() const
+{
+	return _completion.get() != NULL;
+}
+
+bool
+done() const
+{
+	return !valid() || _completion->done();
+}
+
+const OUT&
+wait() const
+{
+	if (!valid()) {
+		return handle_none<OUT>::get();
+	}
+
+	_completion->wait();
+
+	return _completion->get();
+}
+
+};
+
+template<>
+class handle<void>
+{
+const_ptr<completion<void> > _completion;
+
+public:
+handle(const const_ptr<completion<void> >& completion1)
+	: _completion(completion1)
+{
+}
+
+bool
+valid() const
+{
+	return _completion.get() != NULL;
+}
+
+bool
+done() const
+{
+	return !valid() || _completion->done();
+}
+
+void
+wait() const
+{
+	if (valid()) {
+		_completion->wait();
+	}
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[executor]] class `executor`
+
+Class `executor` evaluates actions on a pool of worker threads, one for each 
+core by default. Every worker owns a bounded deque of jobs. A worker runs jobs 
+from the bottom of its own deque, and steals jobs from the top of the deques of 
+other workers when its own deque is empty.
+
+Jobs are submitted as an action with an input, as a seeded `const_ptr` state 
+with an action to bind, or in bulk as an action with arrays of inputs and 
+outputs. Method `submit_range`, which bulk submissions are built on, splits a 
+range of indexes into chunks of `grain1` indexes, about 8 chunks for every 
+worker by default, and calls `f1(begin, end)` for every chunk in a job. Method 
+`schedule` queues a job made by the caller, e.g. to resume a suspended 
+coroutine, and the job is not deleted unless its run function does.
+
+Method `submit` blocks while all deques are full, and method `try_submit` 
+returns an invalid handle instead. Jobs submitted by a worker go to its own 
+deque, and run in place when all deques are full. The capacity of a deque is 
+`capacity1` rounded up to a power of two, at most 2^31. Method `stats` returns 
+zeros for an index not below `size()`.
+
+States bound in jobs are shared between threads, so `retain` and `release` of 
+their types must be thread safe.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+executor executor1;
+handle<double> h = executor1.submit(wrap(add, 10.0) * 4, 1.0);
+h.wait(); // => 41.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct executor_stats
+{
+uint64_t pushed;
+uint64_t executed;
+uint64_t stolen;
+uint64_t inlined;
+uint64_t sleeps;
+};
+
+struct executor_worker;
+
+class executor
+{
+executor_worker* _workers;
+unsigned int _size;
+unsigned int _capacity;
+
+std::atomic<unsigned int> _next;
+std::atomic<size_t> _queued;
+std::atomic<bool> _stopped;
+
+pthread_mutex_t _mutex;
+pthread_cond_t _work_cond;
+pthread_cond_t _space_cond;
+pthread_cond_t _done_cond;
+std::atomic<unsigned int> _work_waiters;
+std::atomic<unsigned int> _space_waiters;
+std::atomic<unsigned int> _done_waiters;
+
+public:
+executor(unsigned int size1 = 0, unsigned int capacity1 = 1024);
+
+~executor();
+
+unsigned int
+size() const
+{
+	return _size;
+}
+
+executor_stats stats(unsigned int i) const;
+
+template<class OUT, class IN, class TAG>
+handle<OUT>
+submit(const action<OUT, IN, TAG>& f1, const IN& in1)
+{
+	return post(f1, in1, true);
+}
+
+template<class OUT, class IN, class TAG>
+handle<OUT>
+try_submit(const action<OUT, IN, TAG>& f1, const IN& in1)
+{
+	return post(f1, in1, false);
+}
+
+template<class T, class OUT, class IN, class TAG>
+handle<const_ptr<T> >
+submit(const const_ptr<T>& state1, const action<OUT, IN, TAG>& f1)
+{
+	return post(state1, f1, true);
+}
+
+template<class T, class OUT, class IN, class TAG>
+handle<const_ptr<T> >
+try_submit(const const_ptr<T>& state1, const action<OUT, IN, TAG>& f1)
+{
+	return post(state1, f1, false);
+}
+
+template<class OUT, class IN, class TAG>
+handle<void>
+submit(const action<OUT, IN, TAG>& f1, const IN* in1, OUT* out1,
+	size_t size1, size_t grain1 = 0)
+{
+	return submit_range(bulk_range<OUT, IN, TAG> (f1, in1, out1), size1,
+		grain1);
+}
+
+template<class F>
+handle<void>
+submit_range(const F& f1, size_t size1, size_t grain1 = 0)
+{
+	mutable_ptr<completion<void> > completion1(
+		new (std::nothrow) completion<void>());
+	if (!completion1.get()) {
+		return handle<void> (completion1.build());
+	}
+
+	if (grain1 == 0) {
+		grain1 = (_size ? size1 / (8 * _size) : size1) + 1;
+	}
+
+	size_t count = (size1 + grain1 - 1) / grain1;
+	completion1->reset(this, count);
+
+	for (size_t i = 0; i < count; i++) {
+		size_t end = (i + 1) * grain1 < size1 ? (i + 1) * grain1 : size1;
+		range_job<F>* job1 = new (std::nothrow) range_job<F>(f1,
+			completion1.build(), i * grain1, end);
+		if (!job1) {
+			f1(i * grain1, end);
+			completion1->finish();
+		}
+		else {
+			push(job1, true);
+		}
+	}
+
+	return handle<void> (completion1.build());
+}
+
+bool
+schedule(job* job1)
+{
+	return push(job1, true);
+}
+
+bool help(const completion_base& completion1);
+
+void block(const completion_base& completion1);
+
+void notify();
+
+private:
+template<class OUT, class IN, class TAG>
+class action_job
+	: public job
+{
+action<OUT, IN, TAG> _f;
+IN _in;
+const_ptr<completion<OUT> > _completion;
+
+public:
+action_job(const action<OUT, IN, TAG>& f1, const IN& in1,
+	const const_ptr<completion<OUT> >& completion1)
+	: job(run)
+	, _f(f1)
+	, _in(in1)
+	, _completion(completion1)
+{
+}
+
+static void
+run(job* job1)
+{
+	action_job<OUT, IN, TAG>* job2 = static_cast<action_job<OUT, IN, TAG>*>(
+		job1);
+	mutable_ptr<completion<OUT> > completion1(job2->_completion);
+	completion1->set(job2->_f(job2->_in));
+	delete job2;
+	completion1->finish();
+}
+
+};
+
+template<class T, class OUT, class IN, class TAG>
+class bind_job
+	: public job
+{
+const_ptr<T> _state;
+action<OUT, IN, TAG> _f;
+const_ptr<completion<const_ptr<T> > > _completion;
+
+public:
+bind_job(const const_ptr<T>& state1, const action<OUT, IN, TAG>& f1,
+	const const_ptr<completion<const_ptr<T> > >& completion1)
+	: job(run)
+	, _state(state1)
+	, _f(f1)
+	, _completion(completion1)
+{
+}
+
+static void
+run(job* job1)
+{
+	bind_job<T, OUT, IN, TAG>* job2 =
+		static_cast<bind_job<T, OUT, IN, TAG>*>(job1);
+	mutable_ptr<completion<const_ptr<T> > > completion1(job2->_completion);
+	completion1->set(job2->_state & job2->_f);
+	delete job2;
+	completion1->finish();
+}
+
+};
+
+template<class R>
+class range_job
+	: public job
+{
+R _f;
+const_ptr<completion<void> > _completion;
+size_t _begin;
+size_t _end;
+
+public:
+range_job(const R& f1, const const_ptr<completion<void> >& completion1,
+	size_t begin1, size_t end1)
+	: job(run)
+	, _f(f1)
+	, _completion(completion1)
+	, _begin(begin1)
+	, _end(end1)
+{
+}
+
+static void
+run(job* job1)
+{
+	range_job<R>* job2 = static_cast<range_job<R>*>(job1);
+	job2->_f(job2->_begin, job2->_end);
+	mutable_ptr<completion<void> > completion1(job2->_completion);
+	delete job2;
+	completion1->finish();
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+class bulk_range
+{
+action<OUT, IN, TAG> _f;
+const IN* _in;
+OUT* _out;
+
+public:
+bulk_range(const action<OUT, IN, TAG>& f1, const IN* in1, OUT* out1)
+	: _f(f1)
+	, _in(in1)
+	, _out(out1)
+{
+}
+
+void
+operator()(size_t begin1, size_t end1) const
+{
+	for (size_t i = begin1; i < end1; i++) {
+		_out[i] = _f(_in[i]);
+	}
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+handle<OUT>
+post(const action<OUT, IN, TAG>& f1, const IN& in1, bool block1)
+{
+	mutable_ptr<completion<OUT> > completion1(
+		new (std::nothrow) completion<OUT>());
+	if (!completion1.get()) {
+		return handle<OUT> (completion1.build());
+	}
+
+	completion1->reset(this, 1);
+	action_job<OUT, IN, TAG>* job1 = new (std::nothrow)
+		action_job<OUT, IN, TAG>(f1, in1, completion1.build());
+	if (!job1 || !push(job1, block1)) {
+		delete job1;
+		return handle<OUT> (mutable_ptr<completion<OUT> > (
+				(completion<OUT>*) NULL).build());
+	}
+
+	return handle<OUT> (completion1.build());
+}
+
+template<class T, class OUT, class IN, class TAG>
+handle<const_ptr<T> >
+post(const const_ptr<T>& state1, const action<OUT, IN, TAG>& f1, bool block1)
+{
+	mutable_ptr<completion<const_ptr<T> > > completion1(
+		new (std::nothrow) completion<const_ptr<T> >());
+	if (!completion1.get()) {
+		return handle<const_ptr<T> > (completion1.build());
+	}
+
+	completion1->reset(this, 1);
+	bind_job<T, OUT, IN, TAG>* job1 = new (std::nothrow)
+		bind_job<T, OUT, IN, TAG>(state1, f1, completion1.build());
+	if (!job1 || !push(job1, block1)) {
+		delete job1;
+		return handle<const_ptr<T> > (mutable_ptr<completion<const_ptr<T> > > (
+				(completion<const_ptr<T> >*) NULL).build());
+	}
+
+	return handle<const_ptr<T> > (completion1.build());
+}
+
+bool push(job* job1, bool block1);
+
+job* next(executor_worker* worker1);
+
+static void* work(void* worker1);
+
+executor(const executor&);
+
+executor& operator=(const executor&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,408 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/hazard.hh`
+
+This file consists of class <<hazard_domain>> and class <<hazard_guard>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_HAZARD_HH
+#define HACTAR_HAZARD_HH
+
+#include <pthread.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[hazard_domain]] class `hazard_domain`
+
+Class `hazard_domain` reclaims objects removed from lock-free structures with 
+hazard pointers. A reader announces the object it is about to read in a 
+hazard slot of its thread, and a writer retires a removed object instead of 
+deleting it. Retired objects are kept in a list of the retiring thread, and 
+once the list holds `hazard_scan_threshold` objects, or twice as many as were 
+left by the last scan, those not announced by any thread are deleted. Objects 
+still retired when a thread exits are handed to the domain, and deleted by 
+later scans of other threads.
+
+Every thread has `hazard_slots` hazard slots, taken by nested `hazard_guard`s 
+in order. Records of hazard slots are never freed, and records of exited threads 
+are reused by new threads. New records are only prepended, so a scan counts and 
+collects the slots of the same records from one loaded head.
+
+There is one domain in a program, returned by `instance`, which is never 
+destroyed.
+////////////////////////////////////////////////////////////////////////////////
+*/
+enum
+{
+	hazard_slots = 8,
+	hazard_scan_threshold = 64
+};
+
+struct hazard_record
+{
+alignas(64) std::atomic<const void*> slots[hazard_slots];
+std::atomic<bool> active;
+hazard_record* next;
+};
+
+struct hazard_retired
+{
+void* pointer;
+void (*deleter)(void*);
+};
+
+class hazard_thread;
+
+class hazard_domain
+{
+std::atomic<hazard_record*> _records;
+pthread_mutex_t _mutex;
+hazard_retired* _orphans;
+std::atomic<size_t> _orphan_size;
+
+public:
+static hazard_domain&
+instance()
+{
+	alignas(hazard_domain) static char storage1[sizeof(hazard_domain)];
+	static hazard_domain* domain1 = new (storage1) hazard_domain();
+
+	return *domain1;
+}
+
+hazard_record*
+acquire()
+{
+	for (hazard_record* record1 = _records.load(std::memory_order_acquire);
+		record1; record1 = record1->next) {
+		bool active1 = false;
+		if (!record1->active.load(std::memory_order_relaxed) &&
+			record1->active.compare_exchange_strong(active1, true)) {
+			return record1;
+		}
+	}
+
+	hazard_record* record1 = new (std::nothrow) hazard_record();
+	if (!record1) {
+		return NULL;
+	}
+
+	for (unsigned int i = 0; i < hazard_slots; i++) {
+		record1->slots[i].store(NULL, std::memory_order_relaxed);
+	}
+
+	record1->active.store(true, std::memory_order_relaxed);
+	record1->next = _records.load(std::memory_order_relaxed);
+	while (!_records.compare_exchange_weak(record1->next, record1)) {
+	}
+
+	return record1;
+}
+
+void
+release(hazard_record* record1, hazard_retired* retired1, size_t size1)
+{
+	if (record1) {
+		for (unsigned int i = 0; i < hazard_slots; i++) {
+			record1->slots[i].store(NULL, std::memory_order_release);
+		}
+
+		record1->active.store(false, std::memory_order_release);
+	}
+
+	if (size1 == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&_mutex);
+	size_t orphan_size1 = _orphan_size.load(std::memory_order_relaxed);
+	hazard_retired* orphans1 = (hazard_retired*) realloc(_orphans,
+		(orphan_size1 + size1) * sizeof(hazard_retired));
+	if (orphans1) {
+		std::copy(retired1, retired1 + size1, orphans1 + orphan_size1);
+		_orphans = orphans1;
+		_orphan_size.store(orphan_size1 + size1, std::memory_order_relaxed);
+	}
+
+	pthread_mutex_unlock(&_mutex);
+}
+
+size_t
+scan(hazard_retired* retired1, size_t size1)
+{
+	hazard_record* head1 = _records.load(std::memory_order_acquire);
+	size_t capacity1 = 0;
+	for (hazard_record* record1 = head1; record1; record1 = record1->next) {
+		capacity1 += hazard_slots;
+	}
+
+	const void** hazards1 = (const void**) malloc(capacity1 *
+		sizeof(const void*));
+	if (!hazards1) {
+		return size1;
+	}
+
+	size_t hazard_size1 = 0;
+	for (hazard_record* record1 = head1; record1; record1 = record1->next) {
+		for (unsigned int i = 0; i < hazard_slots; i++) {
+			const void* pointer1 = record1->slots[i].load(
+				std::memory_order_seq_cst);
+			if (pointer1) {
+				hazards1[hazard_size1++] = pointer1;
+			}
+		}
+	}
+
+	std::sort(hazards1, hazards1 + hazard_size1);
+	size_t size2 = reclaim(retired1, size1, hazards1, hazard_size1);
+	if (_orphan_size.load(std::memory_order_relaxed) &&
+		pthread_mutex_trylock(&_mutex) == 0) {
+		_orphan_size.store(reclaim(_orphans,
+			_orphan_size.load(std::memory_order_relaxed), hazards1,
+			hazard_size1), std::memory_order_relaxed);
+		pthread_mutex_unlock(&_mutex);
+	}
+
+	free(hazards1);
+
+	return size2;
+}
+
+private:
+hazard_domain()
+	: _records(NULL)
+	, _orphans(NULL)
+	, _orphan_size(0)
+{
+	pthread_mutex_init(&_mutex, NULL);
+}
+
+hazard_domain(const hazard_domain&);
+
+hazard_domain&
+operator=(const hazard_domain&);
+
+static size_t
+reclaim(hazard_retired* retired1, size_t size1, const void** hazards1,
+	size_t hazard_size1)
+{
+	size_t size2 = 0;
+	for (size_t i = 0; i < size1; i++) {
+		if (std::binary_search(hazards1, hazards1 + hazard_size1,
+			(const void*) retired1[i].pointer)) {
+			retired1[size2++] = retired1[i];
+		}
+		else {
+			retired1[i].deleter(retired1[i].pointer);
+		}
+	}
+
+	return size2;
+}
+
+};
+
+class hazard_thread
+{
+hazard_record* _record;
+unsigned int _depth;
+hazard_retired* _retired;
+size_t _size;
+size_t _capacity;
+size_t _threshold;
+
+public:
+hazard_thread()
+	: _record(hazard_domain::instance().acquire())
+	, _depth(0)
+	, _retired(NULL)
+	, _size(0)
+	, _capacity(0)
+	, _threshold(hazard_scan_threshold)
+{
+}
+
+~hazard_thread()
+{
+	hazard_domain::instance().release(_record, _retired, _size);
+	free(_retired);
+}
+
+static hazard_thread&
+current()
+{
+	static thread_local hazard_thread thread1;
+
+	return thread1;
+}
+
+std::atomic<const void*>*
+enter()
+{
+	if (!_record || _depth == hazard_slots) {
+		_depth++;
+		return NULL;
+	}
+
+	return &_record->slots[_depth++];
+}
+
+void
+leave(std::atomic<const void*>* slot1)
+{
+	if (slot1) {
+		slot1->store(NULL, std::memory_order_release);
+	}
+
+	_depth--;
+}
+
+bool
+retire(void* pointer1, void (*deleter1)(void*))
+{
+	if (_size == _capacity) {
+		size_t capacity1 = _capacity ? _capacity * 2 : hazard_scan_threshold;
+		hazard_retired* retired1 = (hazard_retired*) realloc(_retired,
+			capacity1 * sizeof(hazard_retired));
+		if (!retired1) {
+			return false;
+		}
+
+		_retired = retired1;
+		_capacity = capacity1;
+	}
+
+	_retired[_size].pointer = pointer1;
+	_retired[_size].deleter = deleter1;
+	if (++_size >= _threshold) {
+		_size = hazard_domain::instance().scan(_retired, _size);
+		_threshold = std::max<size_t>(hazard_scan_threshold, _size * 2);
+	}
+
+	return true;
+}
+
+private:
+hazard_thread(const hazard_thread&);
+
+hazard_thread&
+operator=(const hazard_thread&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[hazard_guard]] class `hazard_guard`
+
+Class `hazard_guard` holds a hazard slot of the calling thread while it 
+lives. Method `protect` loads a pointer from an atomic and announces it in the 
+slot until the pointer is stable, so that the object could be read until the 
+guard is destroyed or protects another pointer. It returns NULL if the thread 
+has no slot left. Function `hazard_retire` retires an object allocated by 
+`new`, which is deleted once no guard protects it. It returns false if memory 
+could not be allocated to keep the object, which is then never deleted.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+std::atomic<X*> current;
+
+{
+	hazard_guard guard1;
+	const X* x = guard1.protect(current); // *x could be read here
+}
+
+X* old = current.exchange(new X());
+hazard_retire(old); // deleted when no guard protects it
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class hazard_guard
+{
+std::atomic<const void*>* _slot;
+
+public:
+hazard_guard()
+	: _slot(hazard_thread::current().enter())
+{
+}
+
+~hazard_guard()
+{
+	hazard_thread::current().leave(_slot);
+}
+
+template<class X>
+X*
+protect(const std::atomic<X*>& pointer1)
+{
+	if (!_slot) {
+		return NULL;
+	}
+
+	X* pointer2 = pointer1.load(std::memory_order_relaxed);
+	for (;;) {
+		_slot->store(pointer2, std::memory_order_seq_cst);
+		X* pointer3 = pointer1.load(std::memory_order_seq_cst);
+		if (pointer3 == pointer2) {
+			return pointer2;
+		}
+
+		pointer2 = pointer3;
+	}
+}
+
+private:
+hazard_guard(const hazard_guard&);
+
+hazard_guard&
+operator=(const hazard_guard&);
+
+};
+
+template<class X>
+void
+hazard_delete(void* pointer1)
+{
+	delete (X*) pointer1;
+}
+
+template<class X>
+bool
+hazard_retire(X* pointer1)
+{
+	return hazard_thread::current().retire(pointer1, hazard_delete<X>);
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/mapped_file.hh`
+
+This file consists of <<mapped_file>> and <<map_file>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_MAPPED_FILE_HH
+#define HACTAR_MAPPED_FILE_HH
+
+#include "action.hh"
+#include "executor.hh"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <type_traits>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[mapped_file]] class `mapped_file`
+
+Class `mapped_file` maps a whole file into memory, read-only by the constructor 
+with a path, or read-write by the constructor with a path and a size, which 
+creates or truncates the file to the size. The mapping is hinted with 
+`MADV_SEQUENTIAL`, so that the kernel reads ahead and drops pages behind. 
+Method `valid` returns false if the file could not be opened or mapped, and an 
+empty file is valid with a NULL `data`.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+mapped_file in("in.bin");
+mapped_file out("out.bin", in.size());
+memcpy(out.data(), in.data(), in.size());
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class mapped_file
+{
+void* _data;
+size_t _size;
+bool _valid;
+
+public:
+explicit
+mapped_file(const char* path1)
+	: _data(NULL)
+	, _size(0)
+	, _valid(false)
+{
+	int fd = open(path1, O_RDONLY);
+	if (fd < 0) {
+		return;
+	}
+
+	struct stat stat1;
+	if (fstat(fd, &stat1) == 0) {
+		map(fd, stat1.st_size, PROT_READ);
+	}
+
+	close(fd);
+}
+
+mapped_file(const char* path1, size_t size1)
+	: _data(NULL)
+	, _size(0)
+	, _valid(false)
+{
+	int fd = open(path1, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		return;
+	}
+
+	if (ftruncate(fd, size1) == 0) {
+		map(fd, size1, PROT_READ | PROT_WRITE);
+	}
+
+	close(fd);
+}
+
+~mapped_file()
+{
+	if (_data) {
+		munmap(_data, _size);
+	}
+}
+
+bool
+valid() const
+{
+	return _valid;
+}
+
+void*
+data() const
+{
+	return _data;
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+private:
+mapped_file(const mapped_file&);
+
+mapped_file&
+operator=(const mapped_file&);
+
+void
+map(int fd1, size_t size1, int prot1)
+{
+	if (size1 == 0) {
+		_valid = true;
+		return;
+	}
+
+	void* data1 = mmap(NULL, size1, prot1, MAP_SHARED, fd1, 0);
+	if (data1 == MAP_FAILED) {
+		return;
+	}
+
+	madvise(data1, size1, MADV_SEQUENTIAL);
+	_data = data1;
+	_size = size1;
+	_valid = true;
+}
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[map_file]] function `map_file`
+
+Function `map_file` evaluates an action for every fixed-size `IN` record of an 
+input file, and writes the `OUT` results at the same indexes of an output file. 
+Both files are mapped by `mapped_file`, and records are read and written in 
+place without any intermediate buffer. Records are split into chunks of 
+`grain1` records, about 8 chunks for every worker by default, which are 
+evaluated in parallel by an `executor`.
+
+`IN` and `OUT` must be trivially copyable, since records are the raw bytes of 
+values in the native layout. Function `map_file` returns the number of records, 
+or -1 if a file could not be mapped, the size of the input file is not a 
+multiple of the size of `IN`, the output file is the input file, which would be 
+truncated under its mapping, or the records could not be submitted.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+executor executor1;
+map_file(&executor1, wrap(add, 10.0), "in.bin", "out.bin");
+// => the number of doubles in in.bin
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class OUT, class IN, class TAG>
+ssize_t
+map_file(executor* executor1, const action<OUT, IN, TAG>& f1,
+	const char* in1, const char* out1, size_t grain1 = 0)
+{
+	typedef char in_must_be_trivially_copyable[
+		std::is_trivially_copyable<IN>::value ? 1 : -1];
+	typedef char out_must_be_trivially_copyable[
+		std::is_trivially_copyable<OUT>::value ? 1 : -1];
+	(void) sizeof(in_must_be_trivially_copyable);
+	(void) sizeof(out_must_be_trivially_copyable);
+
+	struct stat in_stat;
+	struct stat out_stat;
+	if (stat(in1, &in_stat) == 0 && stat(out1, &out_stat) == 0 &&
+		in_stat.st_dev == out_stat.st_dev &&
+		in_stat.st_ino == out_stat.st_ino) {
+		return -1;
+	}
+
+	mapped_file in(in1);
+	if (!in.valid() || in.size() % sizeof(IN) != 0) {
+		return -1;
+	}
+
+	size_t size1 = in.size() / sizeof(IN);
+	mapped_file out(out1, size1 * sizeof(OUT));
+	if (!out.valid()) {
+		return -1;
+	}
+
+	if (size1 > 0) {
+		handle<void> handle1 = executor1->submit(f1, (const IN*) in.data(),
+			(OUT*) out.data(), size1, grain1);
+		if (!handle1.valid()) {
+			return -1;
+		}
+
+		handle1.wait();
+	}
+
+	return size1;
+}
+
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
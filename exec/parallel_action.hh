@@ -0,0 +1,382 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/parallel_action.hh`
+
+This file consists of <<action with map_action_tag>> and <<action with 
+reduce_action_tag>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_PARALLEL_ACTION_HH
+#define HACTAR_PARALLEL_ACTION_HH
+
+#include "action.hh"
+#include "const_queue.hh"
+#include "fork_action.hh"
+#include "span.hh"
+#include "executor.hh"
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+#include <utility>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with map_action_tag]] action with map_action_tag
+
+A map action applies an action to every value of a collection, and returns the 
+results in a `const_queue` in the same order. A collection is a `const_queue` 
+by default, or a `span` of an array with `map<span>`. Values are split into 
+chunks of `grain1` values, which are evaluated in parallel by an `executor`, 
+about 8 chunks for every worker by default. A map action is constructed by an 
+executor and an action with function `map`.
+
+Unlike a loop action, the values of a collection are independent, so the 
+action must not depend on the order of evaluation.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+executor executor1;
+double in[] = { 1.0, 2.0, 3.0 };
+map<span>(&executor1, wrap(add, 10.0))(span<double> (in, 3));
+// => { 11.0, 12.0, 13.0 }
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG>
+struct map_action_tag { };
+
+template<class OUT, template<class> class C, class IN, class TAG>
+class action<const_queue<OUT>, C<IN>, map_action_tag<TAG> >
+{
+executor* _executor;
+action<OUT, IN, TAG> _f;
+size_t _grain;
+
+public:
+action(executor* executor1, const action<OUT, IN, TAG>& f1, size_t grain1)
+	: _executor(executor1)
+	, _f(f1)
+	, _grain(grain1)
+{
+}
+
+const_queue<OUT>
+operator()(const C<IN>& in1) const
+{
+	return const_queue<OUT>::build(in1.size(), map_fill(this, &in1));
+}
+
+private:
+class map_range
+{
+const action<OUT, IN, TAG>* _f;
+const C<IN>* _in;
+OUT* _out;
+
+public:
+map_range(const action<OUT, IN, TAG>* f1, const C<IN>* in1, OUT* out1)
+	: _f(f1)
+	, _in(in1)
+	, _out(out1)
+{
+}
+
+void
+operator()(size_t begin1, size_t end1) const
+{
+	for (size_t i = begin1; i < end1; i++) {
+		new (_out + i) OUT((*_f)((*_in)[i]));
+	}
+}
+
+};
+
+class map_fill
+{
+const action<const_queue<OUT>, C<IN>, map_action_tag<TAG> >* _map;
+const C<IN>* _in;
+
+public:
+map_fill(const action<const_queue<OUT>, C<IN>, map_action_tag<TAG> >* map1,
+	const C<IN>* in1)
+	: _map(map1)
+	, _in(in1)
+{
+}
+
+void
+operator()(OUT* out1) const
+{
+	map_range range1(&_map->_f, _in, out1);
+	handle<void> handle1 = _map->_executor->submit_range(range1,
+		_in->size(), _map->_grain);
+	if (!handle1.valid()) {
+		range1(0, _in->size());
+		return;
+	}
+
+	handle1.wait();
+}
+
+};
+
+};
+
+template<template<class> class C = const_queue, class OUT, class IN, class TAG>
+action<const_queue<OUT>, C<IN>, map_action_tag<TAG> >
+map(executor* executor1, const action<OUT, IN, TAG>& f1, size_t grain1 = 0)
+{
+	return action<const_queue<OUT>, C<IN>, map_action_tag<TAG> > (executor1,
+		f1, grain1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with reduce_action_tag]] action with reduce_action_tag
+
+A reduce action applies an action to every value of a collection, and folds 
+the results with a binary action on `duo`s, starting from an initial value. 
+Values are split into chunks, which are folded in parallel by an `executor`, 
+and the results of chunks are folded in order at last. The action to apply 
+could be omitted, if values are folded as they are.
+
+A reduce action constructed with function `reduce` balances the load by 
+letting every worker take chunks of `grain1` values dynamically, so the 
+binary action must be associative and commutative, and the result may vary 
+with scheduling, e.g. by rounding of floating-point values.
+
+A reduce action constructed with function `ordered_reduce` folds values in 
+chunks of a fixed `grain1` values, and folds the chunks in their order. The 
+binary action is only required to be associative, and the result is the same 
+regardless of the number of workers and scheduling.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, const double& y) { return x + y; }
+double square(const double& x) { return x * x; }
+
+executor executor1;
+double in[] = { 1.0, 2.0, 3.0 };
+reduce<span>(&executor1, wrap(square), join(add), 0.0)(span<double> (in, 3));
+// => 14.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG, class TAGG>
+struct reduce_action_tag { };
+
+template<class OUT, template<class> class C, class IN, class TAG, class TAGG>
+class action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> >
+{
+executor* _executor;
+action<OUT, IN, TAG> _f;
+action<OUT, duo<OUT, OUT>, TAGG> _g;
+OUT _init;
+size_t _grain;
+bool _ordered;
+
+public:
+action(executor* executor1, const action<OUT, IN, TAG>& f1,
+	const action<OUT, duo<OUT, OUT>, TAGG>& g1, const OUT& init1,
+	size_t grain1, bool ordered1)
+	: _executor(executor1)
+	, _f(f1)
+	, _g(g1)
+	, _init(init1)
+	, _grain(grain1)
+	, _ordered(ordered1)
+{
+}
+
+OUT
+operator()(const C<IN>& in1) const
+{
+	size_t size1 = in1.size();
+	size_t workers = _executor->size();
+	size_t grain1 = _grain ? _grain :
+		(workers ? size1 / (8 * workers) : size1) + 1;
+	size_t count = (size1 + grain1 - 1) / grain1;
+	size_t slots = _ordered || count < workers ? count : workers;
+
+	OUT out = _init;
+	slot* slots1 = slots ? new (std::nothrow) slot[slots] : NULL;
+	if (!slots1) {
+		fold(in1, 0, size1, out);
+		return out;
+	}
+
+	std::atomic<size_t> next(0);
+	reduce_range range1(this, &in1, slots1, grain1, count,
+		_ordered ? NULL : &next);
+	handle<void> handle1 = _executor->submit_range(range1, slots, 1);
+	if (!handle1.valid()) {
+		range1(0, slots);
+	}
+	else {
+		handle1.wait();
+	}
+
+	for (size_t i = 0; i < slots; i++) {
+		if (slots1[i].full) {
+			OUT* value = (OUT*) slots1[i].value;
+			out = _g(duo<OUT, OUT> { std::move(out), std::move(*value) });
+			value->~OUT();
+		}
+	}
+
+	delete[] slots1;
+
+	return out;
+}
+
+private:
+struct slot
+{
+alignas(OUT) unsigned char value[sizeof(OUT)];
+bool full;
+};
+
+void
+fold(const C<IN>& in1, size_t begin1, size_t end1, OUT& out1) const
+{
+	for (size_t i = begin1; i < end1; i++) {
+		out1 = _g(duo<OUT, OUT> { std::move(out1), _f(in1[i]) });
+	}
+}
+
+class reduce_range
+{
+const action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> >* _reduce;
+const C<IN>* _in;
+slot* _slots;
+size_t _grain;
+size_t _count;
+std::atomic<size_t>* _next;
+
+public:
+reduce_range(const action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> >* reduce1,
+	const C<IN>* in1, slot* slots1, size_t grain1, size_t count1,
+	std::atomic<size_t>* next1)
+	: _reduce(reduce1)
+	, _in(in1)
+	, _slots(slots1)
+	, _grain(grain1)
+	, _count(count1)
+	, _next(next1)
+{
+}
+
+void
+operator()(size_t begin1, size_t end1) const
+{
+	for (size_t i = begin1; i < end1; i++) {
+		_slots[i].full = false;
+		if (!_next) {
+			run(i, _slots[i]);
+			continue;
+		}
+
+		for (;;) {
+			size_t chunk = _next->fetch_add(1, std::memory_order_relaxed);
+			if (chunk >= _count) {
+				break;
+			}
+
+			run(chunk, _slots[i]);
+		}
+	}
+}
+
+private:
+void
+run(size_t chunk1, slot& slot1) const
+{
+	size_t begin = chunk1 * _grain;
+	size_t end = begin + _grain < _in->size() ? begin + _grain :
+		_in->size();
+	OUT* value = (OUT*) slot1.value;
+	if (!slot1.full) {
+		new (value) OUT(_reduce->_f((*_in)[begin]));
+		slot1.full = true;
+		begin++;
+	}
+
+	_reduce->fold(*_in, begin, end, *value);
+}
+
+};
+
+};
+
+template<template<class> class C = const_queue, class OUT, class IN, class TAG,
+	class TAGG>
+action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> >
+reduce(executor* executor1, const action<OUT, IN, TAG>& f1,
+	const action<OUT, duo<OUT, OUT>, TAGG>& g1, const OUT& init1,
+	size_t grain1 = 0)
+{
+	return action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> > (executor1, f1,
+		g1, init1, grain1, false);
+}
+
+template<template<class> class C = const_queue, class OUT, class TAGG>
+action<OUT, C<OUT>, reduce_action_tag<null_action_tag, TAGG> >
+reduce(executor* executor1, const action<OUT, duo<OUT, OUT>, TAGG>& g1,
+	const OUT& init1, size_t grain1 = 0)
+{
+	return reduce<C> (executor1, action<OUT, OUT> (), g1, init1, grain1);
+}
+
+template<template<class> class C = const_queue, class OUT, class IN, class TAG,
+	class TAGG>
+action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> >
+ordered_reduce(executor* executor1, const action<OUT, IN, TAG>& f1,
+	const action<OUT, duo<OUT, OUT>, TAGG>& g1, const OUT& init1,
+	size_t grain1 = 1024)
+{
+	return action<OUT, C<IN>, reduce_action_tag<TAG, TAGG> > (executor1, f1,
+		g1, init1, grain1, true);
+}
+
+template<template<class> class C = const_queue, class OUT, class TAGG>
+action<OUT, C<OUT>, reduce_action_tag<null_action_tag, TAGG> >
+ordered_reduce(executor* executor1, const action<OUT, duo<OUT, OUT>, TAGG>& g1,
+	const OUT& init1, size_t grain1 = 1024)
+{
+	return ordered_reduce<C> (executor1, action<OUT, OUT> (), g1, init1,
+		grain1);
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
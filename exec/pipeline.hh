@@ -0,0 +1,415 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/pipeline.hh`
+
+This file consists of class template <<pipeline>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_PIPELINE_HH
+#define HACTAR_PIPELINE_HH
+
+#include "action.hh"
+#include "complex_action.hh"
+#include "spsc_ring.hh"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <atomic>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[pipeline]] class template `pipeline`
+
+Class template `pipeline` runs a stream of inputs through a chain of stages 
+`T -> T`, with groups of consecutive stages running on dedicated threads. 
+Groups are connected by <<spsc_ring>>s, and items are handed off in batches, 
+so that throughput scales with the number of groups when stages cost alike.
+
+Stages are added in order with method `add`. Complex actions of stages `T -> T` 
+are split into their composed actions, so a long chain `a & b & c & ...` could 
+be added at once.
+
+Stages are split into groups of the same number of stages by default. Method 
+`balance` measures the cost of every stage on sample inputs, and regroups the 
+stages to minimize the cost of the slowest group.
+
+Method `run` streams inputs through the pipeline and writes outputs in order. 
+Threads live for one call to `run`, so it is meant for long streams. With one 
+group, or when threads could not be created, stages run on the calling thread.
+
+`T` in `pipeline<T>` must be default constructible and copy assignable.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+pipeline<double> pipeline1(2);
+pipeline1.add(wrap(add, 1.0) & wrap(add, 2.0) & wrap(add, 3.0));
+pipeline1.balance(in, 1000);
+pipeline1.run(in, out, size); // => out[i] == in[i] + 6.0
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class T>
+class pipeline
+{
+struct stage
+{
+void* f;
+void (* run)(const void* f, T* items, size_t size);
+void (* destroy)(void* f);
+};
+
+struct group
+{
+pipeline<T>* owner;
+size_t begin;
+size_t end;
+size_t size;
+spsc_ring<T>* in;
+spsc_ring<T>* out;
+pthread_t thread;
+};
+
+stage* _stages;
+size_t _size;
+unsigned int _groups;
+size_t* _bounds;
+size_t _batch;
+size_t _capacity;
+std::atomic<bool> _aborted;
+
+public:
+pipeline(unsigned int groups1 = 2, size_t batch1 = 64,
+	size_t capacity1 = 1024)
+	: _stages(NULL)
+	, _size(0)
+	, _groups(groups1 > 0 ? groups1 : 1)
+	, _bounds((size_t*) calloc(_groups + 1, sizeof(size_t)))
+	, _batch(batch1 > 0 ? batch1 : 1)
+	, _capacity(capacity1 > _batch ? capacity1 : _batch)
+	, _aborted(false)
+{
+}
+
+~pipeline()
+{
+	for (size_t i = 0; i < _size; i++) {
+		_stages[i].destroy(_stages[i].f);
+	}
+
+	free(_stages);
+	free(_bounds);
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+unsigned int
+groups() const
+{
+	return _groups;
+}
+
+size_t
+bound(unsigned int i) const
+{
+	return _bounds[i];
+}
+
+template<class TAG>
+bool
+add(const action<T, T, TAG>& f1)
+{
+	stage* stages = (stage*) realloc(_stages, (_size + 1) * sizeof(stage));
+	if (!stages || !_bounds) {
+		return false;
+	}
+
+	_stages = stages;
+
+	action<T, T, TAG>* f = new (std::nothrow) action<T, T, TAG>(f1);
+	if (!f) {
+		return false;
+	}
+
+	_stages[_size].f = f;
+	_stages[_size].run = run_stage<TAG>;
+	_stages[_size].destroy = destroy_stage<TAG>;
+	_size++;
+
+	for (unsigned int i = 0; i <= _groups; i++) {
+		_bounds[i] = _size * i / _groups;
+	}
+
+	return true;
+}
+
+template<class TAG1, class TAG2>
+bool
+add(const action<T, T, complex_action_tag<T, TAG1, TAG2> >& f1)
+{
+	if (!add(f1.first()) || !add(f1.second())) {
+		return false;
+	}
+
+	for (unsigned int i = 0; i < f1.rest().size(); i++) {
+		if (!add(f1.rest()[i])) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool
+balance(const T* samples1, size_t size1)
+{
+	T* items = new (std::nothrow) T[size1];
+	double* costs = (double*) calloc(_size + 1, sizeof(double));
+	double* best = (double*) malloc((_groups + 1) * (_size + 1) *
+		sizeof(double));
+	size_t* splits = (size_t*) malloc((_groups + 1) * (_size + 1) *
+		sizeof(size_t));
+	if (!items || !costs || !best || !splits || !_bounds || size1 == 0) {
+		delete[] items;
+		free(costs);
+		free(best);
+		free(splits);
+		return false;
+	}
+
+	for (size_t i = 0; i < size1; i++) {
+		items[i] = samples1[i];
+	}
+
+	for (size_t i = 0; i < _size; i++) {
+		double begin = now();
+		_stages[i].run(_stages[i].f, items, size1);
+		costs[i + 1] = costs[i] + (now() - begin);
+	}
+
+	size_t columns = _size + 1;
+	for (size_t s = 0; s <= _size; s++) {
+		best[columns + s] = costs[s];
+		splits[columns + s] = 0;
+	}
+
+	for (unsigned int g = 2; g <= _groups; g++) {
+		for (size_t s = 0; s <= _size; s++) {
+			best[g * columns + s] = best[(g - 1) * columns + s];
+			splits[g * columns + s] = s;
+			for (size_t k = 0; k < s; k++) {
+				double cost = best[(g - 1) * columns + k];
+				if (cost < costs[s] - costs[k]) {
+					cost = costs[s] - costs[k];
+				}
+
+				if (cost < best[g * columns + s]) {
+					best[g * columns + s] = cost;
+					splits[g * columns + s] = k;
+				}
+			}
+		}
+	}
+
+	_bounds[_groups] = _size;
+	for (unsigned int g = _groups; g > 0; g--) {
+		_bounds[g - 1] = g > 1 ? splits[g * columns + _bounds[g]] : 0;
+	}
+
+	delete[] items;
+	free(costs);
+	free(best);
+	free(splits);
+
+	return true;
+}
+
+size_t
+run(const T* in1, T* out1, size_t size1)
+{
+	if (_groups > 1 && size1 > _batch && run_groups(in1, out1, size1)) {
+		return size1;
+	}
+
+	for (size_t i = 0; i < size1; i += _batch) {
+		size_t size = size1 - i < _batch ? size1 - i : _batch;
+		for (size_t j = 0; j < size; j++) {
+			out1[i + j] = in1[i + j];
+		}
+
+		run_range(0, _size, out1 + i, size);
+	}
+
+	return size1;
+}
+
+private:
+template<class TAG>
+static void
+run_stage(const void* f1, T* items1, size_t size1)
+{
+	const action<T, T, TAG>& f = *(const action<T, T, TAG>*) f1;
+	for (size_t i = 0; i < size1; i++) {
+		items1[i] = f(items1[i]);
+	}
+}
+
+template<class TAG>
+static void
+destroy_stage(void* f1)
+{
+	delete (action<T, T, TAG>*) f1;
+}
+
+static double
+now()
+{
+	timespec time;
+	clock_gettime(CLOCK_MONOTONIC, &time);
+
+	return time.tv_sec * 1e9 + time.tv_nsec;
+}
+
+void
+run_range(size_t begin1, size_t end1, T* items1, size_t size1) const
+{
+	for (size_t i = begin1; i < end1; i++) {
+		_stages[i].run(_stages[i].f, items1, size1);
+	}
+}
+
+static void*
+work(void* group1)
+{
+	group* group2 = (group*) group1;
+	pipeline<T>* owner = group2->owner;
+	T* items = new (std::nothrow) T[owner->_batch];
+	if (!items) {
+		owner->_aborted.store(true);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < group2->size && !owner->_aborted.load(); ) {
+		size_t size = group2->in->pop(items, owner->_batch);
+		if (size == 0) {
+			sched_yield();
+			continue;
+		}
+
+		owner->run_range(group2->begin, group2->end, items, size);
+		for (size_t j = 0; j < size && !owner->_aborted.load(); ) {
+			size_t pushed = group2->out->push(items + j, size - j);
+			if (pushed == 0) {
+				sched_yield();
+			}
+
+			j += pushed;
+		}
+
+		i += size;
+	}
+
+	delete[] items;
+
+	return NULL;
+}
+
+bool
+run_groups(const T* in1, T* out1, size_t size1)
+{
+	spsc_ring<T>* rings = new (std::nothrow) spsc_ring<T>[_groups + 1];
+	group* groups = new (std::nothrow) group[_groups];
+	bool is_valid = rings && groups;
+	for (unsigned int i = 0; is_valid && i <= _groups; i++) {
+		is_valid = rings[i].init(_capacity);
+	}
+
+	unsigned int started = 0;
+	_aborted.store(false);
+	for (unsigned int i = 0; is_valid && i < _groups; i++) {
+		groups[i].owner = this;
+		groups[i].begin = _bounds[i];
+		groups[i].end = _bounds[i + 1];
+		groups[i].size = size1;
+		groups[i].in = rings + i;
+		groups[i].out = rings + i + 1;
+		is_valid = pthread_create(&groups[i].thread, NULL, work,
+				groups + i) == 0;
+		started += is_valid ? 1 : 0;
+	}
+
+	if (!is_valid) {
+		_aborted.store(true);
+	}
+
+	size_t fed = 0;
+	size_t got = 0;
+	while (is_valid && got < size1 && !_aborted.load()) {
+		size_t size = 0;
+		if (fed < size1) {
+			size = rings[0].push(in1 + fed,
+					size1 - fed < _batch ? size1 - fed : _batch);
+			fed += size;
+		}
+
+		size_t popped = rings[_groups].pop(out1 + got, size1 - got);
+		got += popped;
+		if (size == 0 && popped == 0) {
+			sched_yield();
+		}
+	}
+
+	for (unsigned int i = 0; i < started; i++) {
+		pthread_join(groups[i].thread, NULL);
+	}
+
+	bool is_done = is_valid && got == size1;
+	delete[] rings;
+	delete[] groups;
+
+	return is_done;
+}
+
+pipeline(const pipeline<T>&);
+
+pipeline<T>& operator=(const pipeline<T>&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/reactor.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "reactor.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+
+namespace hactar {
+
+reactor::reactor(executor* executor1)
+	: _executor(executor1)
+	, _epoll(-1)
+	, _started(false)
+{
+	_wake[0] = -1;
+	_wake[1] = -1;
+
+	_epoll = epoll_create1(EPOLL_CLOEXEC);
+	if (_epoll < 0 || pipe2(_wake, O_NONBLOCK | O_CLOEXEC) < 0) {
+		return;
+	}
+
+	epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = NULL;
+	if (epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake[0], &event) < 0) {
+		return;
+	}
+
+	_started = pthread_create(&_thread, NULL, loop, this) == 0;
+}
+
+reactor::~reactor()
+{
+	if (_started) {
+		char c = 0;
+		while (write(_wake[1], &c, 1) < 0 && errno == EINTR) {
+		}
+
+		pthread_join(_thread, NULL);
+	}
+
+	for (int i = 0; i < 2; i++) {
+		if (_wake[i] >= 0) {
+			close(_wake[i]);
+		}
+	}
+
+	if (_epoll >= 0) {
+		close(_epoll);
+	}
+}
+
+bool
+reactor::watch(int fd1, bool write1, job* job1)
+{
+	epoll_event event;
+	event.events = (write1 ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+	event.data.ptr = job1;
+	if (epoll_ctl(_epoll, EPOLL_CTL_MOD, fd1, &event) == 0) {
+		return true;
+	}
+
+	if (errno != ENOENT) {
+		return false;
+	}
+
+	return epoll_ctl(_epoll, EPOLL_CTL_ADD, fd1, &event) == 0;
+}
+
+void*
+reactor::loop(void* reactor1)
+{
+	reactor* reactor2 = (reactor*) reactor1;
+	epoll_event events[64];
+
+	for (;;) {
+		int count = epoll_wait(reactor2->_epoll, events, 64, -1);
+		bool woken = false;
+		for (int i = 0; i < count; i++) {
+			if (!events[i].data.ptr) {
+				woken = true;
+				continue;
+			}
+
+			reactor2->_executor->schedule((job*) events[i].data.ptr);
+		}
+
+		if (woken) {
+			return NULL;
+		}
+	}
+
+	return NULL;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
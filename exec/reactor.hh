@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/reactor.hh`
+
+This file consists of class <<reactor>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_REACTOR_HH
+#define HACTAR_REACTOR_HH
+
+#include "executor.hh"
+
+#include <pthread.h>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[reactor]] class `reactor`
+
+Class `reactor` waits for file descriptors to be ready on a thread of its own, 
+and schedules jobs waiting for them on an <<executor>>, so that no worker is 
+blocked by I/O. Method `watch` queues a job once when a file descriptor is 
+ready to be read, or written if `write1` is true. A file descriptor could be 
+watched by one job at a time, and it should be non-blocking.
+
+A reactor is invalid if its thread could not be started. A reactor must be 
+destroyed before its executor, when no job is watching.
+////////////////////////////////////////////////////////////////////////////////
+*/
+class reactor
+{
+executor* _executor;
+int _epoll;
+int _wake[2];
+pthread_t _thread;
+bool _started;
+
+public:
+reactor(executor* executor1);
+
+~reactor();
+
+bool
+valid() const
+{
+	return _started;
+}
+
+executor*
+owner() const
+{
+	return _executor;
+}
+
+bool watch(int fd1, bool write1, job* job1);
+
+private:
+static void* loop(void* reactor1);
+
+reactor(const reactor&);
+
+reactor& operator=(const reactor&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
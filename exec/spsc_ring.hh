@@ -0,0 +1,162 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/spsc_ring.hh`
+
+This file consists of class template <<spsc_ring>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_SPSC_RING_HH
+#define HACTAR_SPSC_RING_HH
+
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[spsc_ring]] class template `spsc_ring`
+
+Class template `spsc_ring` is a bounded lock-free ring buffer between exactly 
+one producer thread and one consumer thread.
+
+Items are pushed and popped in batches, so the indexes shared between threads 
+are published once per batch. The producer index and the consumer index are 
+kept in separate cache lines, together with a cached copy of the other index, 
+so that threads only touch the cache line of each other when the cached index 
+runs out.
+
+`X` in `spsc_ring<X>` must be copy assignable. The capacity is rounded up to a 
+power of 2.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class X>
+class spsc_ring
+{
+alignas(64) std::atomic<size_t> _head;
+size_t _tail_cache;
+
+alignas(64) std::atomic<size_t> _tail;
+size_t _head_cache;
+
+alignas(64) X* _items;
+size_t _mask;
+
+public:
+spsc_ring()
+	: _head(0)
+	, _tail_cache(0)
+	, _tail(0)
+	, _head_cache(0)
+	, _items(NULL)
+	, _mask(0)
+{
+}
+
+~spsc_ring()
+{
+	delete[] _items;
+}
+
+bool
+init(size_t capacity1)
+{
+	size_t capacity = 1;
+	while (capacity < capacity1) {
+		capacity <<= 1;
+	}
+
+	_items = new (std::nothrow) X[capacity];
+	_mask = capacity - 1;
+
+	return _items != NULL;
+}
+
+size_t
+capacity() const
+{
+	return _mask + 1;
+}
+
+size_t
+push(const X* items1, size_t size1)
+{
+	size_t tail = _tail.load(std::memory_order_relaxed);
+	if (_head_cache + capacity() - tail < size1) {
+		_head_cache = _head.load(std::memory_order_acquire);
+	}
+
+	size_t size = _head_cache + capacity() - tail;
+	if (size > size1) {
+		size = size1;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		_items[(tail + i) & _mask] = items1[i];
+	}
+
+	if (size > 0) {
+		_tail.store(tail + size, std::memory_order_release);
+	}
+
+	return size;
+}
+
+size_t
+pop(X* items1, size_t size1)
+{
+	size_t head = _head.load(std::memory_order_relaxed);
+	if (_tail_cache - head < size1) {
+		_tail_cache = _tail.load(std::memory_order_acquire);
+	}
+
+	size_t size = _tail_cache - head;
+	if (size > size1) {
+		size = size1;
+	}
+
+	for (size_t i = 0; i < size; i++) {
+		items1[i] = _items[(head + i) & _mask];
+	}
+
+	if (size > 0) {
+		_head.store(head + size, std::memory_order_release);
+	}
+
+	return size;
+}
+
+private:
+spsc_ring(const spsc_ring<X>&);
+
+spsc_ring<X>& operator=(const spsc_ring<X>&);
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
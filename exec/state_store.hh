@@ -0,0 +1,448 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `exec/state_store.hh`
+
+This file consists of class template <<state_store>> and class template 
+<<state_snapshot>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_STATE_STORE_HH
+#define HACTAR_STATE_STORE_HH
+
+#include "const_map.hh"
+#include "const_ptr.hh"
+#include "mutable_ptr.hh"
+#include "hazard.hh"
+
+#include <sched.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <functional>
+#include <new>
+
+namespace hactar {
+
+template<class K, class T, class H>
+class state_store;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[state_snapshot]] class template `state_snapshot`
+
+Class template `state_snapshot` is a consistent view of all states in a 
+<<state_store>> at one moment, returned by its method `snapshot`. It keeps the 
+persistent maps of all shards, so updates of the store after the snapshot 
+is taken are not seen, and taking it copies no state. Method `size` returns 
+the number of states, method `find` returns the state of a key or NULL, and 
+method `visit` calls `f1(key, state)` for all states. The snapshot is invalid 
+if memory could not be allocated.
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class K, class T, class H = std::hash<K> >
+class state_snapshot
+{
+typedef const_map<K, const_ptr<T>, H> map;
+
+map* _maps;
+unsigned int _shards;
+size_t _size;
+
+public:
+state_snapshot(const state_snapshot<K, T, H>& snapshot1)
+	: _maps(snapshot1._maps ? (map*) malloc(snapshot1._shards * sizeof(map)) :
+		NULL)
+	, _shards(_maps ? snapshot1._shards : 0)
+	, _size(_maps ? snapshot1._size : 0)
+{
+	for (unsigned int i = 0; i < _shards; i++) {
+		new (_maps + i) map(snapshot1._maps[i]);
+	}
+}
+
+~state_snapshot()
+{
+	for (unsigned int i = 0; i < _shards; i++) {
+		_maps[i].~map();
+	}
+
+	free(_maps);
+}
+
+bool
+valid() const
+{
+	return _maps != NULL;
+}
+
+size_t
+size() const
+{
+	return _size;
+}
+
+const const_ptr<T>*
+find(const K& key1) const
+{
+	if (!_maps) {
+		return NULL;
+	}
+
+	return _maps[state_store<K, T, H>::shard_of(H()(key1), _shards)].find(
+		key1);
+}
+
+template<class F>
+void
+visit(const F& f1) const
+{
+	for (unsigned int i = 0; i < _shards; i++) {
+		_maps[i].visit(f1);
+	}
+}
+
+private:
+friend class state_store<K, T, H>;
+
+explicit
+state_snapshot(unsigned int shards1)
+	: _maps(shards1 ? (map*) malloc(shards1 * sizeof(map)) : NULL)
+	, _shards(0)
+	, _size(0)
+{
+}
+
+void
+append(const map& map1)
+{
+	new (_maps + _shards++) map(map1);
+	_size += map1.size();
+}
+
+state_snapshot<K, T, H>&
+operator=(const state_snapshot<K, T, H>&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[state_store]] class template `state_store`
+
+Class template `state_store` keeps immutable states of `T` by keys of `K`, and 
+could be read and updated by many threads at once. Keys are spread over 
+`shards1` shards by their hashes, 1024 by default and rounded up to a power of 
+two, and every shard keeps a persistent <<const_map>> from keys to 
+`const_ptr<T>` states as its current version.
+
+Method `find` returns the state of a key, or an empty `const_ptr` if the key is 
+not found. It takes no lock: the current version of the shard is protected by 
+a <<hazard_guard>> while the state is copied out.
+
+Method `update` evaluates `state & f1` on the state of a key, and installs a 
+new version of the shard with the result by compare-and-swap. If another 
+thread has installed a version in the meantime, the new state is evaluated 
+again from the newer one, so `f1` could be evaluated more than once and must 
+have no side effects. It returns false if the key is not found, if `f1` returns 
+an empty state, or if memory could not be allocated. Methods `set` and `erase` 
+install or remove the state of a key in the same way. Replaced versions are 
+retired, and deleted once no reader holds them.
+
+Method `snapshot` returns a <<state_snapshot>> of all shards at one moment. It 
+stops new updates, waits for updates being installed, and collects the current 
+versions of all shards in O(shards) without copying states, after which 
+updates go on. Lookups are never stopped.
+
+`T` must be reference counted atomically, since states are shared by threads. 
+A store must not be destroyed while it is being used.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+state_store<int, counter> store1;
+store1.set(1, unit<counter>(1.0));
+store1.update(1, wrap(increase, 1.0)); // from many threads
+store1.find(1)->value(); // => 2.0
+
+state_snapshot<int, counter> snapshot1 = store1.snapshot();
+snapshot1.visit([](const int& key, const const_ptr<counter>& state) {
+		// all states at one moment
+	});
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class K, class T, class H = std::hash<K> >
+class state_store
+{
+typedef const_map<K, const_ptr<T>, H> map;
+
+struct version
+{
+map states;
+
+explicit
+version(const map& map1)
+	: states(map1)
+{
+}
+
+};
+
+struct alignas(64) shard
+{
+std::atomic<version*> current;
+std::atomic<unsigned int> writers;
+};
+
+shard* _shards;
+unsigned int _size;
+mutable std::atomic<unsigned int> _frozen;
+
+public:
+explicit
+state_store(unsigned int shards1 = 1024)
+	: _shards(NULL)
+	, _size(1)
+	, _frozen(0)
+{
+	while (_size < shards1) {
+		_size *= 2;
+	}
+
+	_shards = new (std::nothrow) shard[_size];
+	if (!_shards) {
+		return;
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		_shards[i].current.store(new (std::nothrow) version(map()),
+			std::memory_order_relaxed);
+		_shards[i].writers.store(0, std::memory_order_relaxed);
+		if (!_shards[i].current.load(std::memory_order_relaxed)) {
+			clear(i);
+			return;
+		}
+	}
+}
+
+~state_store()
+{
+	if (_shards) {
+		clear(_size);
+	}
+}
+
+bool
+valid() const
+{
+	return _shards != NULL;
+}
+
+unsigned int
+shards() const
+{
+	return _size;
+}
+
+const_ptr<T>
+find(const K& key1) const
+{
+	size_t hash1 = H()(key1);
+	hazard_guard guard1;
+	const version* version1 = guard1.protect(
+		_shards[shard_of(hash1, _size)].current);
+	const const_ptr<T>* state1 = version1 ? version1->states.find(key1) : NULL;
+
+	return state1 ? *state1 : mutable_ptr<T>((T*) NULL).build();
+}
+
+template<class F>
+bool
+update(const K& key1, const F& f1)
+{
+	shard& shard1 = _shards[shard_of(H()(key1), _size)];
+	for (;;) {
+		hazard_guard guard1;
+		version* version1 = guard1.protect(shard1.current);
+		if (!version1) {
+			return false;
+		}
+
+		const const_ptr<T>* state1 = version1->states.find(key1);
+		if (!state1) {
+			return false;
+		}
+
+		const_ptr<T> state2 = *state1 & f1;
+		if (!state2.get()) {
+			return false;
+		}
+
+		int result1 = install(shard1, version1, version1->states.set(key1,
+			state2));
+		if (result1 >= 0) {
+			return result1;
+		}
+	}
+}
+
+bool
+set(const K& key1, const const_ptr<T>& state1)
+{
+	shard& shard1 = _shards[shard_of(H()(key1), _size)];
+	for (;;) {
+		hazard_guard guard1;
+		version* version1 = guard1.protect(shard1.current);
+		if (!version1) {
+			return false;
+		}
+
+		int result1 = install(shard1, version1, version1->states.set(key1,
+			state1));
+		if (result1 >= 0) {
+			return result1;
+		}
+	}
+}
+
+bool
+erase(const K& key1)
+{
+	shard& shard1 = _shards[shard_of(H()(key1), _size)];
+	for (;;) {
+		hazard_guard guard1;
+		version* version1 = guard1.protect(shard1.current);
+		if (!version1 || !version1->states.find(key1)) {
+			return false;
+		}
+
+		int result1 = install(shard1, version1, version1->states.erase(key1));
+		if (result1 >= 0) {
+			return result1;
+		}
+	}
+}
+
+state_snapshot<K, T, H>
+snapshot() const
+{
+	state_snapshot<K, T, H> snapshot1(_size);
+	if (!snapshot1._maps) {
+		return snapshot1;
+	}
+
+	_frozen.fetch_add(1);
+	for (unsigned int i = 0; i < _size; i++) {
+		while (_shards[i].writers.load() != 0) {
+			sched_yield();
+		}
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		hazard_guard guard1;
+		const version* version1 = guard1.protect(_shards[i].current);
+		if (!version1) {
+			break;
+		}
+
+		snapshot1.append(version1->states);
+	}
+
+	_frozen.fetch_sub(1);
+	if (snapshot1._shards != _size) {
+		return state_snapshot<K, T, H>(0);
+	}
+
+	return snapshot1;
+}
+
+private:
+friend class state_snapshot<K, T, H>;
+
+state_store(const state_store<K, T, H>&);
+
+state_store<K, T, H>&
+operator=(const state_store<K, T, H>&);
+
+static unsigned int
+shard_of(size_t hash1, unsigned int shards1)
+{
+	return (uint64_t) hash1 * 0x9E3779B97F4A7C15ULL >> 40 & (shards1 - 1);
+}
+
+int
+install(shard& shard1, version* version1, const map& map1)
+{
+	if (!map1.valid()) {
+		return 0;
+	}
+
+	version* version2 = new (std::nothrow) version(map1);
+	if (!version2) {
+		return 0;
+	}
+
+	for (;;) {
+		shard1.writers.fetch_add(1);
+		if (_frozen.load() == 0) {
+			break;
+		}
+
+		shard1.writers.fetch_sub(1);
+		while (_frozen.load() != 0) {
+			sched_yield();
+		}
+	}
+
+	bool installed1 = shard1.current.compare_exchange_strong(version1,
+		version2);
+	shard1.writers.fetch_sub(1);
+	if (!installed1) {
+		delete version2;
+		return -1;
+	}
+
+	hazard_retire(version1);
+
+	return 1;
+}
+
+void
+clear(unsigned int size1)
+{
+	for (unsigned int i = 0; i < size1; i++) {
+		delete _shards[i].current.load(std::memory_order_relaxed);
+	}
+
+	delete[] _shards;
+	_shards = NULL;
+}
+
+};
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,485 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `trace/capture.hh`
+
+This file consists of class <<capture_file>>, 
+<<action with captured_action_tag>> and function <<replay>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_CAPTURE_HH
+#define HACTAR_CAPTURE_HH
+
+#include "action.hh"
+#include "mapped_file.hh"
+#include "profile_action.hh"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <type_traits>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[capture_file]] class `capture_file`
+
+Class `capture_file` writes inputs, and optionally outputs, of a captured 
+action to a file for <<replay>>. A capture file is a header of 8 bytes 
+`HACINPUT`, the version, the size of an input and the size of an output, which 
+is 0 if outputs are not captured, followed by records of an input and an output 
+in the native byte order.
+
+Method `sample` returns true for 1 in `sampling1` inputs evaluated with the 
+capture file in every thread. Every thread counts down the inputs of the last 
+few capture files it sampled, keyed by an id of the capture file, so that 
+threads never contend on a shared counter and actions captured into different 
+files never bias the sampling of each other. A thread sampling more files at 
+once starts counting again for a file it has dropped. Method `write` 
+appends a record with the buffered stream locked, so records of different 
+threads are never interleaved. Records are written to the file when the capture 
+file is destroyed at the latest. A capture file is invalid if the file could 
+not be opened.
+////////////////////////////////////////////////////////////////////////////////
+*/
+enum
+{
+	capture_cache_size = 4
+};
+
+struct capture_cache
+{
+uint64_t files[capture_cache_size];
+unsigned int countdowns[capture_cache_size];
+unsigned int next;
+};
+
+inline thread_local capture_cache capture_current;
+
+inline std::atomic<uint64_t> capture_files(0);
+
+struct capture_header
+{
+char magic[8];
+uint32_t version;
+uint32_t in_size;
+uint32_t out_size;
+uint32_t reserved;
+};
+
+class capture_file
+{
+FILE* _file;
+size_t _in_size;
+size_t _out_size;
+unsigned int _sampling;
+uint64_t _id;
+std::atomic<uint64_t> _records;
+
+public:
+capture_file(const char* path1, size_t in_size1, size_t out_size1 = 0,
+	unsigned int sampling1 = 1)
+	: _file(fopen(path1, "wb"))
+	, _in_size(in_size1)
+	, _out_size(out_size1)
+	, _sampling(sampling1 ? sampling1 : 1)
+	, _id(capture_files.fetch_add(1, std::memory_order_relaxed) + 1)
+	, _records(0)
+{
+	if (!_file) {
+		return;
+	}
+
+	capture_header header1;
+	memcpy(header1.magic, "HACINPUT", 8);
+	header1.version = 1;
+	header1.in_size = in_size1;
+	header1.out_size = out_size1;
+	header1.reserved = 0;
+	if (fwrite(&header1, sizeof(header1), 1, _file) != 1) {
+		fclose(_file);
+		_file = NULL;
+	}
+}
+
+~capture_file()
+{
+	if (_file) {
+		fclose(_file);
+	}
+}
+
+bool
+valid() const
+{
+	return _file;
+}
+
+size_t
+in_size() const
+{
+	return _in_size;
+}
+
+size_t
+out_size() const
+{
+	return _out_size;
+}
+
+uint64_t
+records() const
+{
+	return _records.load(std::memory_order_relaxed);
+}
+
+bool
+sample() const
+{
+	if (!_file || _sampling == 1) {
+		return _file;
+	}
+
+	capture_cache& cache1 = capture_current;
+	for (unsigned int i = 0; i < capture_cache_size; i++) {
+		if (cache1.files[i] == _id) {
+			if (--cache1.countdowns[i]) {
+				return false;
+			}
+
+			cache1.countdowns[i] = _sampling;
+			return true;
+		}
+	}
+
+	unsigned int i = cache1.next++ % capture_cache_size;
+	cache1.files[i] = _id;
+	cache1.countdowns[i] = _sampling - 1;
+
+	return false;
+}
+
+void
+write(const void* in1, const void* out1)
+{
+	flockfile(_file);
+	if (fwrite_unlocked(in1, _in_size, 1, _file) == 1 && (!_out_size ||
+		fwrite_unlocked(out1, _out_size, 1, _file) == 1)) {
+		_records.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	funlockfile(_file);
+}
+
+private:
+capture_file(const capture_file&);
+
+capture_file&
+operator=(const capture_file&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[action with captured_action_tag]] action with captured_action_tag
+
+A captured action evaluates an action, and writes the input, and the output if 
+the capture file has room for it, of sampled inputs into a capture file. It is 
+constructed by function `captured`, with a capture file opened for the sizes 
+of `IN` and `OUT`, or nothing is captured. `IN` and `OUT` must be trivially 
+copyable. Inputs not sampled cost a lookup and a decrement of a countdown of 
+their thread.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+double add(const double& x, double y) { return x + y; }
+
+capture_file file1("add.capture", sizeof(double), sizeof(double), 100);
+auto f = captured(file1, wrap(add, 10.0)); // 1 in 100 inputs are captured
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+template<class TAG>
+struct captured_action_tag { };
+
+template<class OUT, class IN, class TAG>
+class action<OUT, IN, captured_action_tag<TAG> >
+{
+action<OUT, IN, TAG> _f;
+capture_file* _file;
+
+public:
+action(capture_file& file1, const action<OUT, IN, TAG>& f1)
+	: _f(f1)
+	, _file(file1.in_size() == sizeof(IN) && (file1.out_size() == 0 ||
+		file1.out_size() == sizeof(OUT)) ? &file1 : NULL)
+{
+	typedef char in_must_be_trivially_copyable[
+		std::is_trivially_copyable<IN>::value ? 1 : -1];
+	typedef char out_must_be_trivially_copyable[
+		std::is_trivially_copyable<OUT>::value ? 1 : -1];
+	(void) sizeof(in_must_be_trivially_copyable);
+	(void) sizeof(out_must_be_trivially_copyable);
+}
+
+OUT
+operator()(const IN& in1) const
+{
+	if (!_file || !_file->sample()) {
+		return _f(in1);
+	}
+
+	OUT out1 = _f(in1);
+	_file->write(&in1, &out1);
+
+	return out1;
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+action<OUT, IN, captured_action_tag<TAG> >
+captured(capture_file& file1, const action<OUT, IN, TAG>& f1)
+{
+	return action<OUT, IN, captured_action_tag<TAG> > (file1, f1);
+}
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[replay]] function `replay`
+
+Function `replay` maps a capture file, and evaluates `f1` on every captured 
+input, by `concurrency1` threads taking the next input as soon as they are 
+done, or by the calling thread if `concurrency1` is 1. `f1` may be the 
+captured action or a modified one, as long as it takes the same `IN`. It 
+returns false if the file is not a capture file for `IN`, or threads could not 
+be started.
+
+The report has the number of inputs, the wall time in seconds, the throughput 
+in inputs per second, and the mean, 50th, 90th and 99th percentiles and 
+maximum of latencies in nanoseconds, read from the histogram of 
+<<profile_registry>> and so accurate to 12.5%. If outputs were captured, 
+`mismatches` counts outputs of `f1` whose bytes differ from the captured ones.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+replay_report report1;
+replay("add.capture", wrap(add, 10.0), 4, &report1);
+printf("%.0f/s p99 %llu ns\n", report1.throughput,
+	(unsigned long long) report1.p99);
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct replay_report
+{
+uint64_t inputs;
+uint64_t mismatches;
+double seconds;
+double throughput;
+double mean;
+uint64_t p50;
+uint64_t p90;
+uint64_t p99;
+uint64_t max;
+};
+
+template<class F, class IN, class OUT>
+class replay_worker
+{
+const F* _f;
+const char* _records;
+size_t _record_size;
+size_t _size;
+bool _compare;
+std::atomic<size_t>* _next;
+
+public:
+uint64_t histogram[profile_buckets];
+uint64_t sum;
+uint64_t max;
+uint64_t mismatches;
+
+replay_worker()
+	: _f(NULL)
+	, _records(NULL)
+	, _record_size(0)
+	, _size(0)
+	, _compare(false)
+	, _next(NULL)
+	, sum(0)
+	, max(0)
+	, mismatches(0)
+{
+	memset(histogram, 0, sizeof(histogram));
+}
+
+void
+reset(const F* f1, const char* records1, size_t record_size1, size_t size1,
+	bool compare1, std::atomic<size_t>* next1)
+{
+	_f = f1;
+	_records = records1;
+	_record_size = record_size1;
+	_size = size1;
+	_compare = compare1;
+	_next = next1;
+}
+
+static void*
+run(void* worker1)
+{
+	replay_worker* worker2 = (replay_worker*) worker1;
+	size_t i;
+	while ((i = worker2->_next->fetch_add(1, std::memory_order_relaxed)) <
+		worker2->_size) {
+		worker2->evaluate(worker2->_records + i * worker2->_record_size);
+	}
+
+	return NULL;
+}
+
+private:
+void
+evaluate(const char* record1)
+{
+	IN in1;
+	memcpy(&in1, record1, sizeof(IN));
+	uint64_t time1 = profile_now();
+	OUT out1 = (*_f)(in1);
+	uint64_t time2 = profile_now() - time1;
+	asm volatile("" : : "r"(&out1) : "memory");
+	histogram[profile_bucket(time2)]++;
+	sum += time2;
+	max = max > time2 ? max : time2;
+	if (_compare && memcmp(&out1, record1 + sizeof(IN), sizeof(OUT)) != 0) {
+		mismatches++;
+	}
+}
+
+};
+
+template<class OUT, class IN, class TAG>
+bool
+replay(const char* path1, const action<OUT, IN, TAG>& f1,
+	unsigned int concurrency1, replay_report* report1)
+{
+	typedef replay_worker<action<OUT, IN, TAG>, IN, OUT> worker;
+
+	memset(report1, 0, sizeof(replay_report));
+	mapped_file file1(path1);
+	if (!file1.valid() || file1.size() < sizeof(capture_header)) {
+		return false;
+	}
+
+	const capture_header* header1 = (const capture_header*) file1.data();
+	if (memcmp(header1->magic, "HACINPUT", 8) != 0 || header1->version != 1 ||
+		header1->in_size != sizeof(IN) || (header1->out_size != 0 &&
+		header1->out_size != sizeof(OUT))) {
+		return false;
+	}
+
+	size_t record_size1 = header1->in_size + header1->out_size;
+	size_t size1 = (file1.size() - sizeof(capture_header)) / record_size1;
+	const char* records1 = (const char*) file1.data() +
+		sizeof(capture_header);
+	concurrency1 = concurrency1 ? concurrency1 : 1;
+	worker* workers1 = new (std::nothrow) worker[concurrency1];
+	pthread_t* threads1 = new (std::nothrow) pthread_t[concurrency1];
+	if (!workers1 || !threads1) {
+		delete[] workers1;
+		delete[] threads1;
+		return false;
+	}
+
+	std::atomic<size_t> next1(0);
+	for (unsigned int i = 0; i < concurrency1; i++) {
+		workers1[i].reset(&f1, records1, record_size1, size1,
+			header1->out_size != 0, &next1);
+	}
+
+	bool result = true;
+	unsigned int started1 = 0;
+	uint64_t time1 = profile_now();
+	if (concurrency1 == 1) {
+		worker::run(workers1);
+	}
+	else {
+		while (started1 < concurrency1 && pthread_create(&threads1[started1],
+			NULL, worker::run, &workers1[started1]) == 0) {
+			started1++;
+		}
+
+		result = started1 == concurrency1;
+		for (unsigned int i = 0; i < started1; i++) {
+			pthread_join(threads1[i], NULL);
+		}
+	}
+
+	uint64_t time2 = profile_now() - time1;
+	uint64_t histogram1[profile_buckets];
+	memset(histogram1, 0, sizeof(histogram1));
+	uint64_t sum1 = 0;
+	for (unsigned int i = 0; i < concurrency1; i++) {
+		for (unsigned int j = 0; j < profile_buckets; j++) {
+			histogram1[j] += workers1[i].histogram[j];
+		}
+
+		sum1 += workers1[i].sum;
+		report1->max = report1->max > workers1[i].max ? report1->max :
+			workers1[i].max;
+		report1->mismatches += workers1[i].mismatches;
+	}
+
+	report1->inputs = size1;
+	report1->seconds = time2 / 1e9;
+	report1->throughput = time2 ? size1 * 1e9 / time2 : 0.0;
+	report1->mean = size1 ? (double) sum1 / size1 : 0.0;
+	uint64_t* percentiles[3] = { &report1->p50, &report1->p90, &report1->p99 };
+	static const double ranks[3] = { 0.5, 0.9, 0.99 };
+	for (unsigned int i = 0; i < 3; i++) {
+		uint64_t count = 0;
+		for (unsigned int j = 0; j < profile_buckets; j++) {
+			count += histogram1[j];
+			if (count > ranks[i] * size1) {
+				*percentiles[i] = profile_value(j);
+				break;
+			}
+		}
+	}
+
+	delete[] workers1;
+	delete[] threads1;
+
+	return result;
+}
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
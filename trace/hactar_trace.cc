@@ -0,0 +1,62 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `trace/hactar_trace.cc`
+
+The `hactar_trace` tool decodes a trace file written by a `trace_sink`, or the 
+standard input if no file is given, into lines of text on the standard output.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "trace.hh"
+
+#include <stdio.h>
+
+using namespace hactar;
+
+int
+main(int argc, const char* argv[])
+{
+	FILE* in = stdin;
+	if (argc > 1) {
+		in = fopen(argv[1], "rb");
+		if (!in) {
+			perror(argv[1]);
+			return 1;
+		}
+	}
+
+	int result = trace_decode(in, stdout);
+	if (result) {
+		fprintf(stderr, "%s: not a valid trace file\n",
+			argc > 1 ? argv[1] : "stdin");
+	}
+
+	if (in != stdin) {
+		fclose(in);
+	}
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
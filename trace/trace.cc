@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `trace/trace.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "trace.hh"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace hactar {
+
+thread_local trace_cache trace_current = { { 0 }, { NULL }, 0 };
+
+static const char trace_magic[8] = { 'H', 'A', 'C', 'T', 'R', 'A', 'C', 'E' };
+static const uint32_t trace_version = 1;
+static const uint32_t trace_name = 0x80000000u;
+
+static std::atomic<uint64_t> trace_sinks(0);
+
+trace_sink::trace_sink(const char* path1, unsigned int capacity1)
+	: _id(trace_sinks.fetch_add(1) + 1)
+	, _file(NULL)
+	, _capacity(capacity1)
+	, _rings(NULL)
+	, _size(0)
+	, _events(0)
+	, _dropped(0)
+	, _stopped(false)
+	, _started(false)
+{
+	pthread_mutex_init(&_mutex, NULL);
+
+	_file = fopen(path1, "wb");
+	if (!_file) {
+		return;
+	}
+
+	setvbuf(_file, NULL, _IOFBF, 1 << 16);
+
+	uint32_t header[2] = { trace_version, sizeof(trace_record) };
+	if (fwrite(trace_magic, sizeof(trace_magic), 1, _file) != 1 ||
+		fwrite(header, sizeof(header), 1, _file) != 1) {
+		return;
+	}
+
+	_started = pthread_create(&_thread, NULL, drain, this) == 0;
+}
+
+trace_sink::~trace_sink()
+{
+	_stopped.store(true, std::memory_order_release);
+	if (_started) {
+		pthread_join(_thread, NULL);
+	}
+
+	if (_file) {
+		fclose(_file);
+	}
+
+	for (unsigned int i = 0; i < _size; i++) {
+		delete _rings[i];
+	}
+
+	free(_rings);
+	pthread_mutex_destroy(&_mutex);
+}
+
+uint32_t
+trace_sink::event(const char* name1)
+{
+	uint32_t event1 = _events.fetch_add(1, std::memory_order_relaxed) + 1;
+
+	trace_record record1;
+	memset(&record1, 0, sizeof(record1));
+	record1.event = event1 | trace_name;
+	memcpy(&record1.first, name1, strnlen(name1, 16));
+	if (_file) {
+		fwrite(&record1, sizeof(record1), 1, _file);
+	}
+
+	return event1;
+}
+
+trace_ring*
+trace_sink::attach()
+{
+	if (!_started) {
+		return NULL;
+	}
+
+	trace_ring* ring = owned();
+	if (!ring) {
+		ring = new (std::nothrow) trace_ring();
+		if (!ring || !ring->init(_capacity)) {
+			delete ring;
+			return NULL;
+		}
+
+		ring->owner = pthread_self();
+		pthread_mutex_lock(&_mutex);
+		trace_ring** rings = (trace_ring**) realloc(_rings,
+			(_size + 1) * sizeof(trace_ring*));
+		if (rings) {
+			_rings = rings;
+			ring->thread = _size;
+			_rings[_size++] = ring;
+		}
+		pthread_mutex_unlock(&_mutex);
+
+		if (!rings) {
+			delete ring;
+			return NULL;
+		}
+	}
+
+	unsigned int i = trace_current.next++ % trace_cache_size;
+	trace_current.sinks[i] = _id;
+	trace_current.rings[i] = ring;
+
+	return ring;
+}
+
+trace_ring*
+trace_sink::owned()
+{
+	trace_ring* ring = NULL;
+	pthread_t self = pthread_self();
+
+	pthread_mutex_lock(&_mutex);
+	for (unsigned int i = 0; i < _size && !ring; i++) {
+		if (pthread_equal(_rings[i]->owner, self)) {
+			ring = _rings[i];
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return ring;
+}
+
+size_t
+trace_sink::drain_rings()
+{
+	trace_record records[256];
+	size_t count = 0;
+
+	pthread_mutex_lock(&_mutex);
+	for (unsigned int i = 0; i < _size; i++) {
+		size_t size;
+		while ((size = _rings[i]->pop(records, 256)) > 0) {
+			fwrite(records, sizeof(trace_record), size, _file);
+			count += size;
+		}
+	}
+	pthread_mutex_unlock(&_mutex);
+
+	return count;
+}
+
+void*
+trace_sink::drain(void* sink1)
+{
+	trace_sink* sink2 = (trace_sink*) sink1;
+
+	for (;;) {
+		bool is_stopped = sink2->_stopped.load(std::memory_order_acquire);
+		if (sink2->drain_rings() > 0) {
+			continue;
+		}
+
+		if (is_stopped) {
+			break;
+		}
+
+		timespec time1 = { 0, 1000000 };
+		nanosleep(&time1, NULL);
+	}
+
+	fflush(sink2->_file);
+
+	return NULL;
+}
+
+static bool
+trace_before(const trace_record& record1, const trace_record& record2)
+{
+	return record1.time < record2.time;
+}
+
+int
+trace_decode(FILE* in1, FILE* out1)
+{
+	char magic[sizeof(trace_magic)];
+	uint32_t header[2];
+	if (fread(magic, sizeof(magic), 1, in1) != 1 ||
+		memcmp(magic, trace_magic, sizeof(magic)) != 0 ||
+		fread(header, sizeof(header), 1, in1) != 1 ||
+		header[0] != trace_version || header[1] != sizeof(trace_record)) {
+		return 1;
+	}
+
+	trace_record* records = NULL;
+	size_t size = 0;
+	size_t capacity = 0;
+	char (* names)[17] = NULL;
+	uint32_t name_size = 0;
+
+	trace_record record1;
+	while (fread(&record1, sizeof(record1), 1, in1) == 1) {
+		if (record1.event & trace_name) {
+			uint32_t event1 = record1.event & ~trace_name;
+			if (event1 >= name_size) {
+				char (* names1)[17] = (char (*)[17]) realloc(names,
+					(event1 + 1) * sizeof(*names));
+				if (!names1) {
+					break;
+				}
+
+				memset(names1 + name_size, 0,
+					(event1 + 1 - name_size) * sizeof(*names));
+				names = names1;
+				name_size = event1 + 1;
+			}
+
+			memcpy(names[event1], &record1.first, 16);
+			continue;
+		}
+
+		if (size == capacity) {
+			capacity = capacity ? capacity * 2 : 1024;
+			trace_record* records1 = (trace_record*) realloc(records,
+				capacity * sizeof(trace_record));
+			if (!records1) {
+				break;
+			}
+
+			records = records1;
+		}
+
+		records[size++] = record1;
+	}
+
+	int result = feof(in1) ? 0 : 1;
+	std::stable_sort(records, records + size, trace_before);
+
+	for (size_t i = 0; i < size; i++) {
+		const trace_record& record2 = records[i];
+		if (record2.event < name_size && names[record2.event][0]) {
+			fprintf(out1, "%llu\t%u\t%s\t%g\t%g\n",
+				(unsigned long long) (record2.time - records[0].time),
+				record2.thread, names[record2.event], record2.first,
+				record2.second);
+		}
+		else {
+			fprintf(out1, "%llu\t%u\t%u\t%g\t%g\n",
+				(unsigned long long) (record2.time - records[0].time),
+				record2.thread, record2.event, record2.first, record2.second);
+		}
+	}
+
+	free(names);
+	free(records);
+
+	return result;
+}
+
+}
+
+////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,217 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `trace/trace.hh`
+
+This file consists of struct <<trace_record>>, class <<trace_sink>> and 
+function <<trace_decode>>.
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#ifndef HACTAR_TRACE_HH
+#define HACTAR_TRACE_HH
+
+#include "spsc_ring.hh"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include <atomic>
+
+namespace hactar {
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[trace_record]] struct `trace_record`
+
+Struct `trace_record` is a fixed-size binary record of a traced step, with the 
+time in nanoseconds, the index of the writing thread, the event id and two 
+values. Records with the highest bit of `event` set are names of events, which 
+are kept in the bytes of the two values.
+
+A trace file is a header of 8 bytes `HACTRACE`, the version and the size of a 
+record, followed by records in the native byte order.
+////////////////////////////////////////////////////////////////////////////////
+*/
+struct trace_record
+{
+uint64_t time;
+uint32_t thread;
+uint32_t event;
+double first;
+double second;
+};
+
+class trace_ring
+	: public spsc_ring<trace_record>
+{
+public:
+uint32_t thread;
+pthread_t owner;
+};
+
+enum
+{
+	trace_cache_size = 4
+};
+
+struct trace_cache
+{
+uint64_t sinks[trace_cache_size];
+trace_ring* rings[trace_cache_size];
+unsigned int next;
+};
+
+extern thread_local trace_cache trace_current;
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[trace_sink]] class `trace_sink`
+
+Class `trace_sink` writes trace records to a file without blocking the traced 
+threads. Every thread writes records into a lock-free ring of its own, with 
+`capacity1` records, and a background thread drains all rings to the file. A 
+record is dropped and counted in `dropped` if the ring of its thread is full. 
+Every thread caches its rings of the last few sinks it wrote to, and a thread 
+writing to more sinks finds its ring in the sink again, so alternating sinks 
+never makes a thread a new ring.
+
+Method `event` registers the name of an event, up to 16 characters, and 
+returns its id for method `write`. A trace sink is invalid if the file could 
+not be opened, or the background thread could not be started. Records written 
+before a trace sink is destroyed are drained to the file.
+
+Below is an example:
+
+--------------------------------------------------------------------------------
+trace_sink sink1("steps.trace");
+uint32_t bind = sink1.event("bind");
+
+sink1.write(bind, 1.0, 2.0); // => decoded as "<time> 0 bind 1 2"
+--------------------------------------------------------------------------------
+////////////////////////////////////////////////////////////////////////////////
+*/
+class trace_sink
+{
+uint64_t _id;
+FILE* _file;
+unsigned int _capacity;
+
+pthread_mutex_t _mutex;
+trace_ring** _rings;
+unsigned int _size;
+
+std::atomic<uint32_t> _events;
+std::atomic<uint64_t> _dropped;
+std::atomic<bool> _stopped;
+pthread_t _thread;
+bool _started;
+
+public:
+trace_sink(const char* path1, unsigned int capacity1 = 4096);
+
+~trace_sink();
+
+bool
+valid() const
+{
+	return _started;
+}
+
+uint64_t
+dropped() const
+{
+	return _dropped.load(std::memory_order_relaxed);
+}
+
+uint32_t event(const char* name1);
+
+void
+write(uint32_t event1, double first1, double second1)
+{
+	trace_ring* ring = find();
+	if (!ring) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	timespec time1;
+	clock_gettime(CLOCK_MONOTONIC, &time1);
+
+	trace_record record1;
+	record1.time = time1.tv_sec * 1000000000ull + time1.tv_nsec;
+	record1.thread = ring->thread;
+	record1.event = event1;
+	record1.first = first1;
+	record1.second = second1;
+	if (ring->push(&record1, 1) == 0) {
+		_dropped.fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+private:
+trace_ring*
+find()
+{
+	for (unsigned int i = 0; i < trace_cache_size; i++) {
+		if (trace_current.sinks[i] == _id) {
+			return trace_current.rings[i];
+		}
+	}
+
+	return attach();
+}
+
+trace_ring* attach();
+
+trace_ring* owned();
+
+size_t drain_rings();
+
+static void* drain(void* sink1);
+
+trace_sink(const trace_sink&);
+
+trace_sink& operator=(const trace_sink&);
+
+};
+
+/*
+////////////////////////////////////////////////////////////////////////////////
+== [[trace_decode]] function `trace_decode`
+
+Function `trace_decode` reads a trace file, and renders its records as lines of 
+text ordered by time, with the time in nanoseconds since the first record, the 
+thread, the name of the event and the two values, separated by tabs. It returns 
+0 on success, and 1 if the file is not a valid trace file or memory could not 
+be allocated. The `hactar_trace` tool decodes a trace file to the standard 
+output in this way.
+////////////////////////////////////////////////////////////////////////////////
+*/
+int trace_decode(FILE* in1, FILE* out1);
+
+}
+
+#endif
+////////////////////////////////////////////////////////////////////////////////
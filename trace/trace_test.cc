@@ -0,0 +1,292 @@
+////////////////////////////////////////////////////////////////////////////////
+/*
+
+Copyright (c) 2014 Sam Yuen
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of
+this software and associated documentation files (the "Software"), to deal in
+the Software without restriction, including without limitation the rights to
+use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+the Software, and to permit persons to whom the Software is furnished to do so,
+subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+
+////////////////////////////////////////////////////////////////////////////////
+= `trace/trace_test.cc`
+////////////////////////////////////////////////////////////////////////////////
+*/
+
+#include "trace_test.h"
+
+#include "capture.hh"
+#include "trace.hh"
+#include "wrap_action.hh"
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+
+namespace hactar {
+
+struct writer
+{
+trace_sink* sink;
+uint32_t event;
+double index;
+};
+
+void*
+write_steps(void* writer1)
+{
+	writer* writer2 = (writer*) writer1;
+	for (int i = 0; i < 10000; i++) {
+		writer2->sink->write(writer2->event, writer2->index, i);
+	}
+
+	return NULL;
+}
+
+int
+trace_sink_test()
+{
+	int result = 0;
+	uint64_t dropped = 0;
+
+	{
+		trace_sink sink1("trace_test.trace", 1 << 16);
+		if (!sink1.valid()) {
+			return 1;
+		}
+
+		uint32_t event1 = sink1.event("step");
+		writer writers[4];
+		pthread_t threads[4];
+		for (int i = 0; i < 4; i++) {
+			writers[i].sink = &sink1;
+			writers[i].event = event1;
+			writers[i].index = i;
+			if (pthread_create(&threads[i], NULL, write_steps, &writers[i])) {
+				return 1;
+			}
+		}
+
+		for (int i = 0; i < 4; i++) {
+			pthread_join(threads[i], NULL);
+		}
+
+		sink1.write(sink1.event("done"), -1.0, -1.0);
+		dropped = sink1.dropped();
+	}
+
+	FILE* in = fopen("trace_test.trace", "rb");
+	FILE* out = tmpfile();
+	if (!in || !out || trace_decode(in, out) != 0) {
+		result = 1;
+	}
+
+	unsigned int lines = 0;
+	unsigned long long time = 0;
+	char line[256];
+	char last[256] = "";
+	rewind(out);
+	while (out && fgets(line, sizeof(line), out)) {
+		unsigned long long time1 = strtoull(line, NULL, 10);
+		if (time1 < time) {
+			result = 1;
+		}
+
+		time = time1;
+		strcpy(last, line);
+		lines++;
+	}
+
+	std::cout << lines << "\t" << dropped << "\t" << last;
+	if (lines + dropped != 40001 || strstr(last, "\tdone\t-1\t-1") == NULL) {
+		result = 1;
+	}
+
+	if (in) {
+		fclose(in);
+	}
+
+	if (out) {
+		fclose(out);
+	}
+
+	remove("trace_test.trace");
+
+	return result;
+}
+
+
+int
+trace_switch_test()
+{
+	int result = 0;
+
+	{
+		trace_sink sink1("trace_test1.trace");
+		trace_sink sink2("trace_test2.trace");
+		if (!sink1.valid() || !sink2.valid()) {
+			return 1;
+		}
+
+		uint32_t event1 = sink1.event("first");
+		uint32_t event2 = sink2.event("second");
+		for (int i = 0; i < 1000; i++) {
+			sink1.write(event1, i, 0.0);
+			sink2.write(event2, i, 0.0);
+		}
+	}
+
+	FILE* in = fopen("trace_test2.trace", "rb");
+	FILE* out = tmpfile();
+	if (!in || !out || trace_decode(in, out) != 0) {
+		result = 1;
+	}
+
+	unsigned int threads = 0;
+	char line[256];
+	rewind(out);
+	while (out && fgets(line, sizeof(line), out)) {
+		char* thread = strchr(line, '\t');
+		threads += thread && strtoul(thread + 1, NULL, 10) != 0;
+	}
+
+	std::cout << threads << std::endl;
+	if (threads != 0) {
+		result = 1;
+	}
+
+	if (in) {
+		fclose(in);
+	}
+
+	if (out) {
+		fclose(out);
+	}
+
+	remove("trace_test1.trace");
+	remove("trace_test2.trace");
+
+	return result;
+}
+
+
+double
+shift(const double& x, double y)
+{
+	return x + y;
+}
+
+typedef decltype(captured(*(capture_file*) NULL, wrap(shift, 10.0))) capturing;
+
+void*
+evaluate_inputs(void* f1)
+{
+	double out = 0;
+	for (int i = 0; i < 1000; i++) {
+		out += (*(const capturing*) f1)(i);
+	}
+
+	return out > 0 ? NULL : f1;
+}
+
+int
+capture_test()
+{
+	uint64_t records = 0;
+
+	{
+		capture_file file1("trace_test.capture", sizeof(double),
+			sizeof(double), 2);
+		if (!file1.valid()) {
+			return 1;
+		}
+
+		capturing f = captured(file1, wrap(shift, 10.0));
+		pthread_t threads[4];
+		int started = 0;
+		while (started < 4 && pthread_create(&threads[started], NULL,
+				evaluate_inputs, &f) == 0) {
+			started++;
+		}
+
+		for (int i = 0; i < started; i++) {
+			pthread_join(threads[i], NULL);
+		}
+
+		if (started < 4) {
+			return 1;
+		}
+
+		records = file1.records();
+	}
+
+	{
+		capture_file file1("trace_test1.capture", sizeof(double),
+			sizeof(double), 2);
+		capture_file file2("trace_test2.capture", sizeof(double),
+			sizeof(double), 2);
+		capturing f = captured(file1, wrap(shift, 10.0));
+		capturing g = captured(file2, wrap(shift, 10.0));
+		for (int i = 0; i < 100; i++) {
+			f(i);
+			g(i);
+		}
+
+		std::cout << file1.records() << "\t" << file2.records() << std::endl;
+		remove("trace_test1.capture");
+		remove("trace_test2.capture");
+		if (file1.records() != 50 || file2.records() != 50) {
+			return 1;
+		}
+	}
+
+	replay_report report1;
+	replay_report report2;
+	replay_report report3;
+	if (!replay("trace_test.capture", wrap(shift, 10.0), 1, &report1) ||
+		!replay("trace_test.capture", wrap(shift, 10.0), 4, &report2) ||
+		!replay("trace_test.capture", wrap(shift, 11.0), 2, &report3)) {
+		return 1;
+	}
+
+	remove("trace_test.capture");
+	std::cout << records << "\t" << report1.inputs << "\t" <<
+		report2.mismatches << "\t" << report3.mismatches << "\t" <<
+		report2.p50 << "\t" << report2.p99 << std::endl;
+	if (records != 2000 || report1.inputs != 2000 || report2.inputs != 2000 ||
+		report1.mismatches != 0 || report2.mismatches != 0 ||
+		report3.mismatches != 2000 || report2.p99 > report2.max ||
+		report1.throughput <= 0) {
+		return 1;
+	}
+
+	return 0;
+}
+
+}
+
+int
+hactar::trace_test(int argc, const char* argv[])
+{
+	int result = 0;
+
+	result |= trace_sink_test();
+	result |= trace_switch_test();
+	result |= capture_test();
+
+	return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////